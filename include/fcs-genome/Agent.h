@@ -0,0 +1,96 @@
+#ifndef FCSGENOME_AGENT_H
+#define FCSGENOME_AGENT_H
+
+#include <boost/asio.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <json/json.h>
+#include <map>
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace fcsgenome {
+
+// Daemon on each node of latency_mode that runs the tasks
+// submitted to it over tcp. Every message is one json line:
+//   {"type":"status"}  -> {"cores":..,"memory":..,"tasks":..}
+//   {"type":"submit","cmd":..,"cores":..,"memory":..}
+//                      -> {"task":id}, {"out":..}..., {"exit":ret}
+//   {"type":"kill","task":id,"signal":sig} -> {"ok":true|false}
+// Each request carries the shared "token", otherwise it is refused
+// with {"error":..}. Only tasks started by the agent can be killed.
+// A task is killed as well when its submit connection drops.
+class Agent {
+ public:
+  // port 0 binds to any free port
+  Agent(std::string token, 
+      std::string address = "127.0.0.1", int port = 0);
+  ~Agent();
+
+  int port();
+
+  // serve connections until stop()
+  void run();
+  void stop();
+
+  // cores and memory not taken by running tasks
+  Json::Value status();
+
+  // send one request and return its reply, throws
+  // boost::system::system_error if the agent is unreachable
+  static Json::Value request(std::string host, int port, 
+      std::string token, Json::Value req);
+
+  // run cmd on an agent, copy its output to out and return its
+  // exit code; sock, if given, is set to the connection so that a
+  // signal handler can shut it down to kill the task
+  static int submit(std::string host, int port, std::string token,
+      std::string cmd, int cores, int memory,
+      std::ostream &out, volatile int* sock = NULL);
+
+  // index of the host whose agent has the most free cores, then
+  // memory, -1 if no agent answers; hosts are 'name[:port]'
+  static int findLeastLoaded(std::vector<std::string> hosts,
+      int default_port, std::string token);
+
+  // read the shared token from a file that only its owner may
+  // read, a new random token is written first if create is set
+  // and the file is missing
+  static std::string readToken(std::string path, bool create = false);
+
+  static void parseHost(std::string host, int default_port,
+      std::string &name, int &port);
+
+ private:
+  typedef boost::asio::ip::tcp::socket socket;
+  typedef boost::shared_ptr<socket>    socket_ptr;
+
+  struct Task {
+    pid_t pid;
+    int   cores;
+    int   memory;
+  };
+
+  void serve(socket* sock);
+  void handle(socket_ptr sock);
+  void runTask(socket_ptr sock, Json::Value req);
+  bool kill(int id, int sig);
+
+  std::string                    token_;
+  boost::asio::io_service        ios_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+
+  boost::mutex        mutex_;
+  std::map<int, Task> tasks_;
+  boost::condition_variable cond_;
+  int                 next_id_;
+  int                 num_conns_;
+  int                 cores_;
+  int                 memory_;
+  bool                stopped_;
+};
+
+} // namespace fcsgenome
+#endif
@@ -0,0 +1,43 @@
+#ifndef FCSGENOME_BAMINDEX_H
+#define FCSGENOME_BAMINDEX_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fcsgenome {
+
+// Reads of a coordinate sorted bam per window of its reference,
+// estimated from the bai without reading any alignment. The bytes
+// of a window are the distance between the file offsets of its
+// linear index entry and of the next one, and are turned into
+// reads with the mapped count the bai keeps in the pseudo-bin of
+// each reference. The reference names come from the bam header.
+class BamIndex {
+ public:
+  // bases of a window of the bai linear index
+  static const int window = 16384;
+
+  // throws fileNotFound if the bam or its bai does not exist,
+  // and invalidParam if either cannot be parsed
+  BamIndex(std::string bam_path);
+
+  std::vector<std::string> refs() { return refs_; }
+
+  // estimated reads in each window of a reference, empty if the
+  // reference has no reads or is not in the bam
+  std::vector<double> load(std::string ref);
+
+  // path of the index of a bam, x.bai or x.bam.bai
+  static std::string bai_path(std::string bam_path);
+
+ private:
+  void readHeader(std::string bam_path);
+  void readIndex(std::string bai_path);
+
+  std::vector<std::string> refs_;
+  std::map<std::string, std::vector<double> > load_;
+};
+
+} // namespace fcsgenome
+#endif
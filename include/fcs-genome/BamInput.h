@@ -8,6 +8,7 @@
 #include <iostream>
 #include <map>
 #include <sstream>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,6 +20,15 @@ namespace fcsgenome {
 typedef std::map<int, std::vector<std::string> > BAMset;
 typedef std::vector<std::string> MergedRegionSet;
 
+// a bam of a folder with the reads of one region, as recorded in 
+// the manifest of the folder
+struct BamBucket {
+  std::string bam;
+  std::string region;  // bed or list file, empty if there is none
+  uint64_t    bytes;
+  int64_t     reads;   // mapped reads from its bai, -1 if unknown
+};
+
 struct BamInputInfo {
   std::string bam_name;
   bool bam_isdir;
@@ -38,13 +48,23 @@ class BamInput {
       TUMOR
     } InputType;
     BamInput(std::string dir_path);
-    BamInputInfo merge_region(int);
+    // For a folder, the buckets of the contig-th of gatk.ncontigs 
+    // groups, which are contiguous and of about the same number of
+    // reads (or bytes if a bucket has no index), and the region of 
+    // the group. With a paired folder, e.g. the normal of a tumor, 
+    // both are grouped by their sum so that the regions match.
+    BamInputInfo merge_region(int, BamInput* paired = NULL);
     BamInputInfo getInfo();
+    std::vector<BamBucket> getBuckets();
     std::string get_gatk_args(int, BamInput::InputType = DEFAULT);
  private:
     int files_in_dir(std::string, std::string);
     std::string get_input_type(BamInput::InputType input);    
+    void load_manifest();
     BamInputInfo data_;
+    std::string  region_ext_;
+    std::string  cache_dir_;
+    std::vector<BamBucket> buckets_;
 };
 
 } // namespace fcsgenome
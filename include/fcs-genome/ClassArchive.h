@@ -0,0 +1,31 @@
+#ifndef FCSGENOME_CLASSARCHIVE_H
+#define FCSGENOME_CLASSARCHIVE_H
+
+#include <string>
+
+namespace fcsgenome {
+
+// version printed by `java -version`, such as 1.8.0_292 or 11.0.2,
+// empty if java cannot run
+std::string get_java_version(std::string java);
+
+// 8 for 1.8.0_292, 11 for 11.0.2, 0 if unknown
+int get_java_major(std::string version);
+
+// Class-data-sharing archive of a jar for a java, in gatk.cds_dir
+// and named after the checksum of the jar and the java version so
+// that it is rebuilt when either changes. It is dumped from the
+// classes loaded by the help of the jar, unless it already exists.
+// Returns an empty path if java has no application class-data
+// sharing (before 11) or the dump failed.
+std::string dump_class_archive(std::string java, std::string jar);
+
+// dump the archives of the GATK jars for java_path if gatk.cds is
+// set, called before the tasks of an executor start
+void dump_class_archives();
+
+// archive of a jar dumped by this process, empty if there is none
+std::string get_class_archive(std::string java, std::string jar);
+
+} // namespace fcsgenome
+#endif
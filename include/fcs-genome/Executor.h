@@ -4,14 +4,26 @@
 #include <boost/asio.hpp>
 #include <boost/atomic.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/future.hpp>
 #include <boost/thread/lockable_adapter.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <json/json.h>
+#include <map>
+#include <set>
 #include <string>
-#include <queue>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <vector>
 
 #include "fcs-genome/config.h"
+#include "fcs-genome/NumaTopology.h"
+#include "fcs-genome/SlotBroker.h"
+#include "fcs-genome/TaskLedger.h"
 #include "fcs-genome/Worker.h"
 
 namespace fcsgenome {
@@ -25,19 +37,44 @@ class Stage
 : public boost::basic_lockable_adapter<boost::mutex>
 {
  public:
-  Stage(Executor* executor, std::string label);
+  // failures in a speculative stage are reported without failing
+  // the run, since the task it was split from still runs
+  Stage(Executor* executor, std::string label, 
+        std::string sample_id = "",
+        bool speculative = false);
 
-  void add(Worker_ptr worker);
-  void run();  
+  int  add(Worker_ptr worker, int log_idx);
+  void start();
+  bool finish(int idx, int ret, bool skipped = false);
+  void report();
 
- private:
-  void runTask(int idx);
+  // append output of a task to the stage log, each line 
+  // prefixed by the task index
+  void write(int idx, const std::string &lines);
+
+  // keep the output of a failed task in its own log
+  void saveLog(int idx, const std::string &output);
 
+  Worker_ptr  task(int idx) { return tasks_[idx]; }
+  std::string log(int idx) { return logs_[idx]; }
+  std::string label() { return label_; }
+  std::string sample_id() { return sample_id_; }
+
+ private:
   Executor*                executor_;
   std::vector<Worker_ptr>  tasks_;
   std::vector<std::string> logs_;
   std::string              label_;
+  std::string              sample_id_;
+  std::string              log_fname_;
+  std::ofstream            log_;
+  std::set<int>            saved_logs_;
   std::map<int, int>       status_;
+  std::set<int>            skipped_;
+  int                      num_finished_;
+  bool                     speculative_;
+  bool                     started_;
+  uint64_t                 start_ts_;
 };
 
 class Executor
@@ -47,11 +84,16 @@ class Executor
   Executor(std::string job_name, int num_executors = 1);
   ~Executor();
 
-  virtual int execute(Worker_ptr worker, std::string log);
+  // start the worker's command and return its pid, 0 if it is
+  // skipped by --resume, or -1 if it cannot be set up
+  virtual pid_t execute(Worker_ptr worker, std::string log);
   virtual void run();
   virtual void stop();
   virtual void interrupt();
 
+  // send sig to the process groups of all running tasks
+  void killTasks(int sig);
+
   template <typename CompletionHandler>
   void post(CompletionHandler handler) {
     ios_->post(handler);
@@ -64,21 +106,144 @@ class Executor
   std::string get_log_name(std::string fname, int a = -1);
 
  protected:
-
-  int                   num_executors_;
-  std::string           job_name_;
-  std::queue<Stage_ptr> job_stages_; 
-  std::string           log_dir_;
+  // a node in the task graph, tasks are numbered in the order
+  // they are added so a lower id means an earlier stage
+  struct Task {
+    Stage*           stage;
+    int              idx;       // index of the task in its stage
+    int              num_deps;  // unfinished predecessors
+    bool             skipped;   // a predecessor has failed
+    bool             cached;    // outputs reused from a previous run
+    bool             fatal;     // an error was found in its output
+    int              cores;     // cores taken from the node budget
+    int              memory;    // memory in gb taken from the node budget
+    int              slot;      // executor slot the task runs in
+    int              attempts;  // times the task was started again
+    int              host;      // in conf_host_list in latency_mode, or -1
+    int              grant;     // slots from the node-wide broker, or -1
+    int              request;   // request to the broker pending, or -1
+    bool             checked;   // check() of the worker has passed
+    std::vector<int> children;
+
+    // speculative execution of stragglers
+    bool             speculated;  // split() was tried on the task
+    bool             spec_won;    // outputs were produced by its split
+    std::vector<int> spec_tasks;  // split tasks racing it, merge last
+    int              original;    // task this one was split from, or -1
+
+    // accounting for the run report
+    int              ret;
+    uint64_t         ready_ts;  // in us
+    uint64_t         start_ts;
+    uint64_t         end_ts;
+    struct rusage    usage;     // of the task and its waited-for children
+    uint64_t         read_bytes;
+    uint64_t         write_bytes;
+    // stdout and stderr of the task, streamed to the stage log
+    boost::shared_ptr<boost::asio::posix::stream_descriptor> output_pipe;
+    std::string      output;        // latest output, saved on failure
+    std::string      partial;       // unterminated last line
+
+    std::string      cgroup;        // cgroup v2 leaf of the task if any
+    uint64_t         memory_peak;   // in bytes, from the cgroup
+    uint64_t         throttled_us;  // by the cgroup cpu limit
+  };
+
+  int  newTask(Stage* stage, Worker_ptr worker);
+  void addDeps(int id, Worker_ptr worker, bool new_stage);
+  void dispatch();
+  int  checkTask(boost::unique_lock<Executor> &lock);
+  void runTask(int id);
+  void requestSlots(int id);
+  void cancelRequest(int id);
+  void grantTask(int id, int grant, std::vector<std::string> hosts);
+  void releaseTask(int id);
+  void finishTask(int id, int ret, bool skipped = false);
+  bool retryTask(int id, int ret);
+  void cancelTasks();
+
+  void readOutput(int id, 
+      boost::shared_ptr<boost::asio::posix::stream_descriptor> pipe);
+  void appendOutput(int id, const char* data, size_t size);
+  void closeOutput(int id);
+
+  int  estimateRuntime(Stage* stage);
+  int  findLocalHost(Worker_ptr worker);
+  int  placeTask(Worker_ptr worker, int job_id, bool &use_agent);
+
+  void renewSlots();
+
+  void createCgroup(int id);
+  void removeCgroup(int id);
+
+  void watchStragglers();
+  void speculate();
+  void finishSpeculation(int id, int ret);
+  bool takeSplitOutputs(int id);
+  void cancelSpeculation(int id);
+  void killTask(int id, int sig);
+
+  pid_t spawn(std::string cmd, std::string log);
+  void  waitChildren();
+  void  reapChildren();
+  std::string taskStatus(const Task &task);
+  void  writeReport();
+  void  writeTrace();
+
+  int                    num_executors_;
+  int                    cores_budget_;
+  int                    memory_budget_;
+  std::string            job_name_;
+  std::vector<Stage_ptr> job_stages_; 
+  std::string            log_dir_;
   std::string           log_fname_;
   std::string           temp_dir_;
 
   boost::atomic<int>               job_id_;
   std::map<boost::thread::id, int> pid_table_;
 
+  // task graph, guarded by the executor lock, a deque so that
+  // split tasks added by speculate() do not move the others
+  std::deque<Task>                         tasks_;
+  std::set<int>                            ready_;
+  std::vector<Stage*>                      finished_stages_;
+  std::map<std::string, std::vector<int> > readers_;
+  std::map<std::string, std::vector<int> > writers_;
+  std::vector<int>                         barrier_;
+  std::vector<int>                         fence_;
+  std::vector<int>                         next_fence_;
+  int                                      num_running_;
+  int                                      cores_used_;
+  int                                      memory_used_;
+  int                                      num_finished_;
+  bool                                     fail_fast_;
+  bool                                     cancelled_;
+  std::map<pid_t, int>                     children_;
+  std::set<int>                            free_slots_;
+  Json::Value                              report_;
+  Json::Value                              trace_;
+  boost::shared_ptr<TaskLedger>            ledger_;
+  std::exception_ptr                       error_;
+  // latency_mode placement, the host holding each file produced 
+  // on a remote host and the tasks running on each host
+  std::map<std::string, int>               locations_;
+  std::vector<int>                         host_tasks_;
+  boost::condition_variable_any            cond_;
+
  private:
      
   boost::shared_ptr<boost::asio::io_service> ios_;
   boost::shared_ptr<boost::asio::io_service::work> ios_work_;
+  boost::shared_ptr<boost::asio::signal_set> sigchld_;
+  boost::shared_ptr<boost::asio::deadline_timer> straggler_timer_;
+  std::set<boost::shared_ptr<boost::asio::deadline_timer> > retry_timers_;
+  NumaTopology                               numa_;
+  std::string                                cgroup_dir_;
+  std::map<boost::thread::id, int>           launching_;
+  boost::shared_ptr<SlotClient>              broker_;
+  boost::thread                              broker_renewer_;
+  bool                                       watching_;
+  bool                                       stopping_;
   boost::thread_group executors_;
 };
 } // namespace fcsgenome
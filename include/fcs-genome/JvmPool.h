@@ -0,0 +1,99 @@
+#ifndef FCSGENOME_JVMPOOL_H
+#define FCSGENOME_JVMPOOL_H
+
+#include <boost/asio.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <json/json.h>
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace fcsgenome {
+
+// Long-lived jvms that run the tools of a jar one after another,
+// so that the tasks of a stage skip the jvm startup, class loading
+// and jit warm-up. Each jvm hosts the command runner of
+// scripts/jvm-runner, and tasks are submitted over a unix socket
+// as one json line:
+//   {"jar":..,"memory":..,"opts":..,"args":[..]}
+//                      -> {"out":..}/{"err":..}..., {"exit":ret}
+// A jvm serves tasks with the same jar, heap and jvm options; it
+// is replaced
+// after a failed task or after a number of tasks, and killed when
+// the submitter of its task disconnects.
+class JvmPool {
+ public:
+  // jvms are started with the java command on the runner jar,
+  // at most size of them are kept idle
+  JvmPool(std::string path, std::string java, std::string runner,
+      int size, int reuse);
+  ~JvmPool();
+
+  std::string path() { return path_; }
+
+  // serve connections until stop()
+  void run();
+  void stop();
+
+  // run args of a jar on a jvm of the pool listening on path,
+  // started with opts, copy its output to out and err and return
+  // its exit code; sock, if given, is set to the connection so
+  // that a signal handler can shut it down to kill the task
+  static int submit(std::string path, std::string jar, int memory,
+      std::string opts, std::vector<std::string> args,
+      std::ostream &out, std::ostream &err,
+      volatile int* sock = NULL);
+
+  // pool of this process, started on first use from gatk.jvm_pool,
+  // NULL if it is disabled
+  static JvmPool* get();
+
+  // heap in gb of the idle jvms of the pool of this process, which
+  // no task accounts for, 0 if the pool is not started
+  static int reserved();
+
+ private:
+  typedef boost::asio::local::stream_protocol::socket socket;
+  typedef boost::shared_ptr<socket> socket_ptr;
+
+  struct Jvm {
+    pid_t       pid;
+    int         in;
+    int         out;
+    int         err;
+    std::string key;
+    int         memory;   // heap in gb
+    int         tasks;
+  };
+
+  void serve(socket* sock);
+  void handle(socket_ptr sock);
+  bool take(std::string jar, int memory, std::string opts, Jvm &jvm);
+  bool spawn(std::vector<std::string> &argv, std::string key,
+      int in[2], int out[2], int err[2], Jvm &jvm);
+  void put(Jvm &jvm, bool reuse);
+  void terminate(Jvm &jvm);
+  int  runTask(int fd, Jvm &jvm, std::vector<std::string> &args,
+      bool &connected);
+
+  std::string path_;
+  std::string java_;
+  std::string runner_;
+  int         size_;
+  int         reuse_;
+
+  boost::asio::io_service ios_;
+  boost::asio::local::stream_protocol::acceptor acceptor_;
+
+  boost::mutex              mutex_;
+  std::vector<Jvm>          idle_;
+  int                       num_busy_;
+  boost::condition_variable cond_;
+  int                       num_conns_;
+  bool                      stopped_;
+};
+
+} // namespace fcsgenome
+#endif
@@ -7,5 +7,15 @@ namespace fcsgenome {
   class LogUtils {
     public:
       std::string findError(std::vector<std::string> logs_);
+
+      // classify the failure of a task from its log
+      bool findOutOfMemory(std::string log);
+      bool findTransientError(std::string log);
+
+      // an error after which the task will not produce its outputs
+      bool isFatalError(const std::string &line);
+
+    private:
+      bool findAny(std::string log, const char* patterns[], int num_patterns);
   };
 }
@@ -0,0 +1,43 @@
+#ifndef FCSGENOME_NUMATOPOLOGY_H
+#define FCSGENOME_NUMATOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+namespace fcsgenome {
+
+// NUMA nodes of the host and their cpus, read from sysfs. A host
+// without /sys/devices/system/node is seen as one node with all 
+// online cpus.
+class NumaTopology {
+ public:
+  NumaTopology(std::string sysfs_dir = "/sys/devices/system");
+
+  int num_nodes() { return nodes_.size(); }
+  int num_cpus(int node) { return nodes_[node].cpus.size(); }
+  int num_cores(int node) { return nodes_[node].num_cores; }
+
+  // physical cores on all nodes, without SMT siblings
+  int num_cores();
+
+  // restrict the calling thread, and the processes it starts, to 
+  // the cpus of a node and prefer its memory, return false if 
+  // the kernel refuses
+  bool bind(int node);
+
+  // undo bind() on the calling thread
+  void unbind();
+
+  static std::vector<int> parse_cpulist(std::string cpulist);
+
+ private:
+  struct Node {
+    int              id;
+    std::vector<int> cpus;
+    int              num_cores;
+  };
+  std::vector<Node> nodes_;
+};
+
+} // namespace fcsgenome
+#endif
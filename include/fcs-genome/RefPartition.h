@@ -0,0 +1,52 @@
+#ifndef FCSGENOME_REFPARTITION_H
+#define FCSGENOME_REFPARTITION_H
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fcsgenome {
+
+// contig of a reference and its runs of N, 1-based and inclusive
+struct RefContig {
+  std::string name;
+  uint64_t    length;
+  std::vector<std::pair<uint64_t, uint64_t> > gaps;
+};
+
+// interval with 1-based inclusive bounds and its share of the work
+struct Interval {
+  std::string chr;
+  uint64_t    lbound;
+  uint64_t    ubound;
+  double      weight;
+};
+
+// Split intervals, in order, into nparts of about the same weight,
+// or the same length if none has any. A cut close to its target
+// moves to the nearest boundary between intervals, otherwise it
+// splits an interval in proportion to its weight. Every part has
+// at least one base, the result is empty if there are not enough.
+std::vector<std::vector<Interval> > split_intervals(
+    std::vector<Interval> &intervals, int nparts);
+
+// runs of at least min_gap N in the contigs of a reference, from a
+// scan of the fasta through its .fai, throws fileNotFound if the
+// reference has no .fai
+std::vector<RefContig> scan_ref_gaps(std::string ref_path,
+    uint64_t min_gap);
+
+// Partition of a reference into nparts interval lists of about the
+// same number of callable (not N) bases. A cut close to its target
+// is moved into the nearest gap or contig end, and gaps are left
+// out of the lists. The gaps and the lists are cached next to the
+// reference, or in temp_dir/fcs-genome-intv if its dir is not
+// writable, keyed by the checksum of the .fai and .dict and by
+// nparts, so that only the first run scans the reference. Returns
+// an empty vector if the reference has no .fai.
+std::vector<std::string> get_ref_partitions(std::string ref_path,
+    int nparts);
+
+} // namespace fcsgenome
+#endif
@@ -0,0 +1,170 @@
+#ifndef FCSGENOME_SLOTBROKER_H
+#define FCSGENOME_SLOTBROKER_H
+
+#include <boost/function.hpp>
+#include <boost/interprocess/ipc/message_queue.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fcsgenome {
+
+// message from a client to the broker
+struct SlotRequest {
+  enum Type { ACQUIRE, RELEASE, RENEW, STOP };
+  int type;
+  int pid;
+  int owner;    // process whose exit frees the slots
+  int client;   // SlotClient in the process
+  int id;       // request of the client, or grant to release
+  int slots;    // granted together, possibly on several hosts
+  int cores;    // of each slot
+  int memory;   // in gb, of each slot
+  int runtime;  // estimate in seconds, 0 if unknown
+  int lease;    // in seconds, 0 to keep the slots until the owner exits
+};
+
+// reply of the broker to an ACQUIRE
+struct SlotGrant {
+  int  id;      // of the request
+  int  grant;   // unique in the broker to release it, -1 if refused
+  char hosts[1024];  // comma separated, one per slot
+};
+
+// Broker of the slots of a set of hosts shared by independent
+// processes, over boost interprocess message queues. A slot
+// weighs as much as its cores or its share of the host memory,
+// whichever is larger. A request for several slots is granted
+// at once or not at all. Requests are served in order, except
+// that a later one may start early if that does not delay the
+// first one waiting, judging from the runtime estimates (EASY
+// backfill). A grant is a lease the client renews, so that the
+// slots of a client that crashed are taken back when the lease
+// expires or as soon as its owner is gone.
+class SlotBroker {
+ public:
+  // creates the queue, throws interprocess_exception if a
+  // broker of the same name is running or was not removed
+  SlotBroker(std::string name);
+  ~SlotBroker();
+
+  void addHost(std::string host, int slots, int memory);
+
+  // serve requests until stop()
+  void run();
+  void stop();
+
+  static std::string queue_name(std::string name);
+  static std::string client_queue_name(std::string name,
+      int pid, int client);
+
+  // remove the queue left by a broker that was killed
+  static void remove(std::string name);
+
+ private:
+  struct Host {
+    std::string name;
+    int         slots;
+    int         memory;
+    int         used;
+  };
+  // host and the slots taken on it
+  typedef std::vector<std::pair<int, int> > Allocation;
+
+  struct Lease {
+    int         grant;
+    SlotRequest req;
+    Allocation  alloc;
+    uint64_t    expiry;   // in us
+    uint64_t    end;      // estimated, in us
+  };
+
+  int  weight(Host &host, SlotRequest &req);
+  bool place(SlotRequest &req, std::vector<int> &free, Allocation &alloc);
+  bool reserve(SlotRequest &req, uint64_t &shadow, std::vector<int> &extra);
+  void schedule();
+  void expire();
+  void refuse(SlotRequest &req);
+  bool grant(SlotRequest &req, Allocation &alloc);
+  void release(int idx);
+
+  std::string                  name_;
+  boost::shared_ptr<boost::interprocess::message_queue> queue_;
+  std::vector<Host>            hosts_;
+  std::deque<SlotRequest>      pending_;
+  std::vector<Lease>           leases_;
+  int                          next_grant_;
+};
+
+// Client of a SlotBroker, each process may have several
+class SlotClient {
+ public:
+  // throws interprocess_exception if the broker is not running,
+  // the slots are freed when owner exits, this process if 0
+  SlotClient(std::string name, int lease = 30, int owner = 0);
+  ~SlotClient();
+
+  // block until the slots are granted, return the grant and
+  // the hosts, or -1 if the broker refused or went away; may
+  // be called from several threads at once
+  int  acquire(int slots, int cores, int memory, int runtime,
+      std::vector<std::string> &hosts);
+  int  acquire(int cores, int memory, std::string &host);
+
+  // send a request and return its id without waiting, handler is
+  // called from a thread of the client with the grant and the
+  // hosts, or -1 if the broker refused or went away; it must not 
+  // call back into the client
+  typedef boost::function<void(int, std::vector<std::string>)> Handler;
+  int  acquire_async(int slots, int cores, int memory, int runtime,
+      Handler handler);
+
+  // withdraw a request of acquire_async, its slots are released
+  // when they are granted; returns false if the handler has been
+  // called already
+  bool cancel(int id);
+
+  void release(int grant);
+
+  // extend the leases of all grants of this client, needs to
+  // be called more often than the lease expires
+  void renew();
+
+  int lease() { return lease_; }
+
+ private:
+  void send(SlotRequest req);
+  void request(int id, int slots, int cores, int memory, int runtime);
+  bool receive(boost::unique_lock<boost::mutex> &lock);
+  void receiveGrants();
+
+  std::string  name_;
+  std::string  reply_name_;
+  int          client_;
+  int          lease_;
+  int          owner_;
+  int          next_id_;
+  boost::mutex mutex_;
+  // grants read by one waiting thread for the others, by request
+  std::map<int, SlotGrant>  replies_;
+  bool                      receiving_;
+  boost::condition_variable cond_;
+  // requests of acquire_async, answered by the receiver thread
+  std::map<int, Handler>    handlers_;
+  std::set<int>             cancelled_;
+  boost::thread             receiver_;
+  bool                      stopping_;
+  boost::shared_ptr<boost::interprocess::message_queue> queue_;
+  boost::shared_ptr<boost::interprocess::message_queue> reply_queue_;
+};
+
+} // namespace fcsgenome
+#endif
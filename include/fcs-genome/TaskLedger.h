@@ -0,0 +1,40 @@
+#ifndef FCSGENOME_TASKLEDGER_H
+#define FCSGENOME_TASKLEDGER_H
+
+#include <json/json.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fcsgenome {
+
+// Record of the tasks that finished successfully, kept as one
+// json line per task so that an interrupted run leaves a valid
+// file. A task is identified by its command, and each of its
+// files by a fingerprint of size and mtime. Entries replaced
+// by a later run are dropped when the ledger is loaded.
+class TaskLedger {
+ public:
+  TaskLedger(std::string path);
+
+  // return true if cmd finished before and none of its
+  // inputs and outputs has changed since
+  bool check(std::string cmd,
+      std::vector<std::string> inputs,
+      std::vector<std::string> outputs);
+
+  void record(std::string cmd,
+      std::vector<std::string> inputs,
+      std::vector<std::string> outputs);
+
+  static std::string fingerprint(std::string path);
+
+ private:
+  void compact();
+
+  std::string path_;
+  std::map<std::string, Json::Value> entries_;
+};
+
+} // namespace fcsgenome
+#endif
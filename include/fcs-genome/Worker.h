@@ -8,6 +8,7 @@
 #include <map>
 #include <regex>
 #include <string>
+#include <vector>
 
 #include "fcs-genome/config.h"
 #include "fcs-genome/common.h"
@@ -32,6 +33,7 @@ class Worker {
   ):
          num_process_(num_proc),
          num_thread_(num_t),
+         memory_(0),
          extra_opts_(),
          task_name_(task_name)
   {  
@@ -64,16 +66,54 @@ class Worker {
   std::string getCommand() { return cmd_; }
   std::string getTaskName() { return task_name_;}
 
+  // files read and written by the task, Executor uses them 
+  // to order tasks; a worker that declares neither waits for 
+  // all tasks added before its stage
+  std::vector<std::string> getInputs() { return inputs_; }
+  std::vector<std::string> getOutputs() { return outputs_; }
+
+  // hosts granted by the slot broker, one per process, set 
+  // before setup() is called
+  void setHosts(std::vector<std::string> hosts) { hosts_ = hosts; }
+
+  // split the task into n tasks over parts of its intervals and 
+  // a task that merges their results, whose outputs match the 
+  // outputs of this task one to one; Executor runs them next to 
+  // a straggling task and keeps whichever finishes first, returns
+  // false if the task cannot be split
+  virtual bool split(int n, 
+      std::vector<boost::shared_ptr<Worker> > &parts,
+      boost::shared_ptr<Worker> &merge) { return false; }
+
  protected:
+  // java command running a jar with the heap of the task, up to
+  // the arguments of the tool; through the jvm pool if it is enabled;
+  // key is the tool in the gatk.<key>.* configs
+  std::string java_cmd(std::string jar, std::string key);
+
+  // jvm options sizing the gc and jit threads to the core share
+  // of the task and choosing the gc by its heap, followed by the
+  // options configured for the tool
+  std::string jvm_opts(std::string key);
+
+  // hosts to run the processes of the task on, the ones granted
+  // by the slot broker if any, otherwise conf_host_list
+  std::vector<std::string> hosts();
+
   std::string cmd_;
   std::string log_fname_;
   std::map<std::string, std::vector<std::string> > extra_opts_;
 
+  std::vector<std::string> inputs_;
+  std::vector<std::string> outputs_;
+
   int num_process_;   // num_processes per task
   int num_thread_;    // num_thread per task process
+  int memory_;        // heap memory in gb per task process
 
  private:
   std::string task_name_;
+  std::vector<std::string> hosts_;
 
 };
 
@@ -274,6 +274,9 @@ std::string get_bucket_fname(std::string dir, int contig, std::string stem = "pa
 
 int count_files_in_dir(std::string directory, std::string ext); 
 
+// crc32 of the content of a file, in hex
+std::string get_file_checksum(std::string path);
+
 uint32_t getTid();
 
 class Executor;
@@ -13,6 +13,7 @@ extern std::string conf_project_dir;
 extern std::string conf_bin_dir;
 extern std::string conf_root_dir;
 extern std::string conf_temp_dir;
+extern bool conf_resume;
 extern std::vector<std::string> conf_host_list;
 extern int main_tid;
 
@@ -89,10 +90,39 @@ int init(char** argv, int argc);
 int init_config(boost::program_options::options_description conf_opt);
 
 std::string contig_intv_dir();
-std::vector<std::string> init_contig_intv(std::string ref_path);
+// split the reference into gatk.ncontigs interval lists, of about
+// the same length, or with gatk.<cmd>.partition (falling back to
+// gatk.partition) set to reads, of about the same number of reads
+// of input_path, estimated from its bam index
+std::vector<std::string> init_contig_intv(std::string ref_path,
+    std::string input_path = "", std::string cmd = "");
+// interval lists of the part bams in input_dir, which print reads 
+// writes next to them as part-k.list, so that a folder is processed 
+// with the partitions it was written with; the length partitions 
+// if any part has none, as in folders of older versions
+std::vector<std::string> init_folder_intv(std::string ref_path,
+    std::string input_dir);
 int roundUp(int numToRound, int multiple);
 std::vector<std::string> split_ref_by_nprocs(std::string ref_path);
 std::vector<std::string> split_by_nprocs(std::string intervalFile, std::string filetype);
+
+// sort and merge the intervals of a bed or list file, padded with 
+// gatk.intv.padding, and split them into gatk.ncontigs parts of about 
+// the same length, or with gatk.<cmd>.partition (falling back to 
+// gatk.partition) set to reads, of about the same number of reads of 
+// input_path if it is a bam; each part is written as a .bed and a 
+// .list, the paths with ext are returned
+std::vector<std::string> split_intv_by_nprocs(std::string intv_path,
+    std::string ref_path, std::string ext,
+    std::string input_path = "", std::string cmd = "");
+// intersect the intervals of intv_path with each of the partitions
+// in part_paths, reading the list only once, so that every task gets
+// one exact list instead of intersecting both itself; a partition 
+// without any of the intervals gets an empty path and its task can
+// be skipped, throws invalidParam if none has any
+std::vector<std::string> intersect_intv(std::string intv_path,
+    std::vector<std::string> part_paths, std::string ref_path);
+std::vector<std::string> split_intv_by_length(std::string intv_path, int nparts, std::string prefix);
 void check_vcf_index(std::string inputVCF);
 bool compareFiles(const std::string& p1, const std::string& p2);
 
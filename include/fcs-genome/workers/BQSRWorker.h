@@ -21,8 +21,10 @@ class BQSRWorker : public Worker {
 
   void check();
   void setup();
+  bool split(int n, std::vector<Worker_ptr> &parts, Worker_ptr &merge);
 
  private:
+  bool split_part_;   // checked as part of the task it was split from
   std::vector<std::string> known_sites_;
   std::string ref_path_;
   std::vector<std::string> intv_path_;
@@ -54,7 +56,8 @@ class PRWorker : public Worker {
       std::string input_path,
       std::string output_path,
       std::vector<std::string> extra_opts,
-      int contig, bool &flag_f, bool flag_gatk);
+      int contig, bool &flag_f, bool flag_gatk,
+      bool empty_region = false);
 
   void check();
   void setup();
@@ -67,6 +70,7 @@ class PRWorker : public Worker {
   std::string output_path_;
   int contig_;
   bool flag_gatk_;
+  bool empty_region_;   // none of the reads are in the part
 };
 } // namespace fcsgenome
 #endif
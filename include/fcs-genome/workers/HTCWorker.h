@@ -22,8 +22,10 @@ class HTCWorker : public Worker {
 
   void check();
   void setup();
+  bool split(int n, std::vector<Worker_ptr> &parts, Worker_ptr &merge);
 
  private:
+  bool split_part_;   // checked as part of the task it was split from
   int  contig_;       // which bam parts are we working on in this worker
   bool produce_vcf_;  // whether we produce vcf of gvcf
   bool flag_gatk_;    // whether we use GATK4
@@ -54,7 +54,11 @@ class TabixWorker : public Worker {
 class VCFSortWorker : public Worker {
  public:
   VCFSortWorker(std::string path): 
-    Worker(1, 1), path_(path) {}
+    Worker(1, 1), path_(path) 
+  {
+    inputs_.push_back(path_);
+    outputs_.push_back(path_);
+  }
 
   void check();
   void setup();
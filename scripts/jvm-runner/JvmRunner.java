@@ -0,0 +1,73 @@
+import java.io.BufferedReader;
+import java.io.InputStreamReader;
+import java.lang.reflect.InvocationTargetException;
+import java.lang.reflect.Method;
+import java.security.Permission;
+import java.util.jar.JarFile;
+
+// Command runner hosted by each jvm of the fcs-genome jvm pool.
+// It reads one command line per task from stdin, arguments
+// separated by tabs, runs the main class of the jar on them in
+// this jvm, and ends the output of the task on stdout with
+//   \u0001fcs-exit <code>
+// The jar is given as the only argument and must be on the
+// classpath as well.
+public class JvmRunner {
+
+  static class ExitException extends SecurityException {
+    final int status;
+    ExitException(int status) {
+      this.status = status;
+    }
+  }
+
+  // the tools end with System.exit(), which would end the jvm
+  static class ExitTrap extends SecurityManager {
+    @Override
+    public void checkPermission(Permission perm) { }
+
+    @Override
+    public void checkPermission(Permission perm, Object context) { }
+
+    @Override
+    public void checkExit(int status) {
+      throw new ExitException(status);
+    }
+  }
+
+  public static void main(String[] argv) throws Exception {
+    String mainClass;
+    try (JarFile jar = new JarFile(argv[0])) {
+      mainClass = jar.getManifest().getMainAttributes().getValue("Main-Class");
+    }
+    Method main = Class.forName(mainClass).getMethod("main", String[].class);
+    System.setSecurityManager(new ExitTrap());
+
+    BufferedReader in = new BufferedReader(new InputStreamReader(System.in));
+    String line;
+    while ((line = in.readLine()) != null) {
+      String[] args = line.isEmpty() ? new String[0] : line.split("\t", -1);
+      int ret = 0;
+      try {
+        main.invoke(null, (Object) args);
+      }
+      catch (InvocationTargetException e) {
+        Throwable cause = e.getCause();
+        while (cause != null && !(cause instanceof ExitException)) {
+          cause = cause.getCause();
+        }
+        if (cause != null) {
+          ret = ((ExitException) cause).status;
+        }
+        else {
+          e.getCause().printStackTrace();
+          ret = 1;
+        }
+      }
+      System.err.flush();
+      System.out.flush();
+      System.out.print("\u0001fcs-exit " + ret + "\n");
+      System.out.flush();
+    }
+  }
+}
@@ -0,0 +1,504 @@
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <glog/logging.h>
+#include <iomanip>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "fcs-genome/Agent.h"
+#include "fcs-genome/common.h"
+#include "fcs-genome/config.h"
+
+extern char **environ;
+
+namespace fcsgenome {
+
+using boost::asio::ip::tcp;
+
+// write one message, without SIGPIPE if the peer is gone
+static bool send_line(int fd, Json::Value msg) {
+  Json::FastWriter writer;
+  std::string line = writer.write(msg);
+  const char* ptr = line.c_str();
+  size_t left = line.size();
+  while (left > 0) {
+    ssize_t n = ::send(fd, ptr, left, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    ptr += n;
+    left -= n;
+  }
+  return true;
+}
+
+static bool read_line(tcp::socket &sock,
+    boost::asio::streambuf &buf, Json::Value &msg)
+{
+  boost::system::error_code err;
+  boost::asio::read_until(sock, buf, '\n', err);
+  if (err && !buf.size()) {
+    return false;
+  }
+  std::istream is(&buf);
+  std::string line;
+  std::getline(is, line);
+  Json::Reader reader;
+  return reader.parse(line, msg);
+}
+
+Agent::Agent(std::string token, std::string address, int port):
+  token_(token),
+  acceptor_(ios_, tcp::endpoint(
+        boost::asio::ip::address::from_string(address), port)),
+  next_id_(1),
+  num_conns_(0),
+  cores_(boost::thread::hardware_concurrency()),
+  memory_(get_sys_memory()),
+  stopped_(false)
+{
+  // keep the sockets out of the tasks
+  ::fcntl(acceptor_.native_handle(), F_SETFD, FD_CLOEXEC);
+}
+
+Agent::~Agent() {
+  stop();
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  for (std::map<int, Task>::iterator it = tasks_.begin();
+       it != tasks_.end(); it++)
+  {
+    ::kill(-it->second.pid, SIGTERM);
+  }
+  // connections still being served refer to this object
+  while (num_conns_ > 0) {
+    cond_.wait(lock);
+  }
+}
+
+int Agent::port() {
+  return acceptor_.local_endpoint().port();
+}
+
+void Agent::run() {
+  LOG(INFO) << "Agent listening on " 
+            << acceptor_.local_endpoint().address().to_string() 
+            << ":" << port() << " with "
+            << cores_ << " cores and " << memory_ << "GB memory";
+  while (true) {
+    socket* sock = new socket(ios_);
+    boost::system::error_code err;
+    acceptor_.accept(*sock, err);
+    if (stopped_) {
+      delete sock;
+      break;
+    }
+    if (err) {
+      LOG(WARNING) << "Failed to accept connection: " << err.message();
+      delete sock;
+      continue;
+    }
+    ::fcntl(sock->native_handle(), F_SETFD, FD_CLOEXEC);
+    {
+      boost::lock_guard<boost::mutex> guard(mutex_);
+      num_conns_++;
+    }
+    boost::thread(boost::bind(&Agent::serve, this, sock)).detach();
+  }
+}
+
+void Agent::stop() {
+  if (stopped_) {
+    return;
+  }
+  stopped_ = true;
+  // shutdown wakes up a thread blocked in accept()
+  ::shutdown(acceptor_.native_handle(), SHUT_RDWR);
+  boost::system::error_code err;
+  acceptor_.close(err);
+}
+
+Json::Value Agent::status() {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  Json::Value reply;
+  int cores  = cores_;
+  int memory = memory_;
+  for (std::map<int, Task>::iterator it = tasks_.begin();
+       it != tasks_.end(); it++)
+  {
+    cores  -= it->second.cores;
+    memory -= it->second.memory;
+  }
+  reply["cores"]  = cores;
+  reply["memory"] = memory;
+  reply["tasks"]  = (int)tasks_.size();
+  return reply;
+}
+
+// only the process groups of tasks started here can be signaled
+bool Agent::kill(int id, int sig) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  if (!tasks_.count(id) || sig <= 0 || sig >= NSIG) {
+    return false;
+  }
+  return ::kill(-tasks_[id].pid, sig) == 0;
+}
+
+// compare without returning early, so that the time taken does
+// not tell how much of the token was right
+static bool same_token(const std::string &a, const std::string &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  unsigned char diff = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    diff |= a[i] ^ b[i];
+  }
+  return diff == 0;
+}
+
+// the socket is owned here rather than by the thread, so that
+// it is closed before the agent can be destroyed
+void Agent::serve(socket* raw) {
+  {
+    socket_ptr sock(raw);
+    handle(sock);
+  }
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  num_conns_--;
+  cond_.notify_all();
+}
+
+void Agent::handle(socket_ptr sock) {
+  boost::asio::streambuf buf;
+  Json::Value req;
+  if (!read_line(*sock, buf, req)) {
+    return;
+  }
+  int fd = sock->native_handle();
+  if (!same_token(req["token"].asString(), token_)) {
+    boost::system::error_code err;
+    LOG(WARNING) << "Refused a request without the agent token from "
+                 << sock->remote_endpoint(err).address().to_string();
+    Json::Value reply;
+    reply["error"] = "invalid token";
+    send_line(fd, reply);
+    return;
+  }
+  std::string type = req["type"].asString();
+  if (type == "status") {
+    send_line(fd, status());
+  }
+  else if (type == "kill") {
+    Json::Value reply;
+    reply["ok"] = kill(req["task"].asInt(),
+        req.get("signal", SIGTERM).asInt());
+    send_line(fd, reply);
+  }
+  else if (type == "submit") {
+    runTask(sock, req);
+  }
+  else {
+    Json::Value reply;
+    reply["error"] = "unknown request '" + type + "'";
+    send_line(fd, reply);
+  }
+}
+
+void Agent::runTask(socket_ptr sock, Json::Value req) {
+  int fd = sock->native_handle();
+  std::string cmd = req["cmd"].asString();
+
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC)) {
+    Json::Value reply;
+    reply["error"] = "cannot create pipe";
+    send_line(fd, reply);
+    return;
+  }
+
+  // same as a local task: bash in its own process group, with
+  // stdout and stderr into the pipe
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], 2);
+
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+  posix_spawnattr_setpgroup(&attr, 0);
+
+  const char* argv[] = {"/bin/bash", "-c", cmd.c_str(), NULL};
+  pid_t pid;
+  int ret = posix_spawn(&pid, "/bin/bash", &actions, &attr,
+      const_cast<char**>(argv), environ);
+
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  ::close(fds[1]);
+
+  if (ret) {
+    ::close(fds[0]);
+    Json::Value reply;
+    reply["error"] = "cannot start task";
+    send_line(fd, reply);
+    return;
+  }
+
+  int id;
+  {
+    boost::lock_guard<boost::mutex> guard(mutex_);
+    id = next_id_++;
+    Task task;
+    task.pid    = pid;
+    task.cores  = req.get("cores", 1).asInt();
+    task.memory = req.get("memory", 0).asInt();
+    tasks_[id] = task;
+  }
+  DLOG(INFO) << "Started task " << id << ": " << cmd;
+
+  Json::Value reply;
+  reply["task"] = id;
+  bool connected = send_line(fd, reply);
+
+  // forward the output until the task closes the pipe, and
+  // kill it if the submitter goes away
+  char data[4096];
+  while (true) {
+    struct pollfd pfds[2];
+    pfds[0].fd = fds[0];
+    pfds[0].events = POLLIN;
+    pfds[1].fd = connected ? fd : -1;
+    pfds[1].events = POLLIN;
+    if (::poll(pfds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (pfds[1].revents) {
+      if (::recv(fd, data, sizeof(data), MSG_DONTWAIT) <= 0) {
+        connected = false;
+      }
+    }
+    if (pfds[0].revents) {
+      ssize_t n = ::read(fds[0], data, sizeof(data));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      if (connected) {
+        Json::Value out;
+        out["out"] = std::string(data, n);
+        connected = send_line(fd, out);
+      }
+    }
+    if (!connected && pfds[1].fd >= 0) {
+      LOG(WARNING) << "Submitter of task " << id << " is gone, killing it";
+      ::kill(-pid, SIGTERM);
+    }
+  }
+  ::close(fds[0]);
+
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) ;
+  ret = WIFEXITED(status) ? WEXITSTATUS(status) :
+        128 + WTERMSIG(status);
+  {
+    boost::lock_guard<boost::mutex> guard(mutex_);
+    tasks_.erase(id);
+  }
+  DLOG(INFO) << "Task " << id << " finished with " << ret;
+
+  if (connected) {
+    Json::Value exit;
+    exit["exit"] = ret;
+    send_line(fd, exit);
+  }
+}
+
+void Agent::parseHost(std::string host, int default_port,
+    std::string &name, int &port)
+{
+  size_t pos = host.rfind(':');
+  if (pos == std::string::npos) {
+    name = host;
+    port = default_port;
+  }
+  else {
+    name = host.substr(0, pos);
+    port = boost::lexical_cast<int>(host.substr(pos + 1));
+  }
+}
+
+static void connect(boost::asio::io_service &ios, tcp::socket &sock,
+    std::string host, int port)
+{
+  tcp::resolver resolver(ios);
+  tcp::resolver::query query(host, std::to_string((long long)port));
+  boost::asio::connect(sock, resolver.resolve(query));
+}
+
+Json::Value Agent::request(std::string host, int port, 
+    std::string token, Json::Value req) 
+{
+  boost::asio::io_service ios;
+  tcp::socket sock(ios);
+  connect(ios, sock, host, port);
+
+  req["token"] = token;
+  if (!send_line(sock.native_handle(), req)) {
+    throw boost::system::system_error(
+        boost::asio::error::connection_reset);
+  }
+  boost::asio::streambuf buf;
+  Json::Value reply;
+  if (!read_line(sock, buf, reply)) {
+    throw boost::system::system_error(boost::asio::error::eof);
+  }
+  return reply;
+}
+
+int Agent::submit(std::string host, int port, std::string token,
+    std::string cmd, int cores, int memory,
+    std::ostream &out, volatile int* sock_fd)
+{
+  boost::asio::io_service ios;
+  tcp::socket sock(ios);
+  try {
+    connect(ios, sock, host, port);
+  }
+  catch (boost::system::system_error &e) {
+    LOG(ERROR) << "Cannot reach agent on " << host << ":" << port
+               << ": " << e.what();
+    return 255;
+  }
+  if (sock_fd) {
+    *sock_fd = sock.native_handle();
+  }
+
+  Json::Value req;
+  req["type"]   = "submit";
+  req["token"]  = token;
+  req["cmd"]    = cmd;
+  req["cores"]  = cores;
+  req["memory"] = memory;
+
+  // 255 as ssh does when the connection is lost
+  int ret = 255;
+  boost::asio::streambuf buf;
+  Json::Value msg;
+  if (send_line(sock.native_handle(), req)) {
+    while (read_line(sock, buf, msg)) {
+      if (msg.isMember("out")) {
+        out << msg["out"].asString();
+        out.flush();
+      }
+      else if (msg.isMember("exit")) {
+        ret = msg["exit"].asInt();
+        break;
+      }
+      else if (msg.isMember("error")) {
+        LOG(ERROR) << "Agent on " << host << ":" << port
+                   << " refused the task: " << msg["error"].asString();
+        break;
+      }
+    }
+  }
+  if (sock_fd) {
+    *sock_fd = -1;
+  }
+  return ret;
+}
+
+int Agent::findLeastLoaded(std::vector<std::string> hosts,
+    int default_port, std::string token)
+{
+  int best = -1;
+  int best_cores = 0;
+  int best_memory = 0;
+  Json::Value req;
+  req["type"] = "status";
+  for (int i = 0; i < hosts.size(); i++) {
+    std::string name;
+    int port;
+    parseHost(hosts[i], default_port, name, port);
+    Json::Value reply;
+    try {
+      reply = request(name, port, token, req);
+    }
+    catch (boost::system::system_error &e) {
+      DLOG(WARNING) << "Agent on " << hosts[i] << " is not reachable: "
+                    << e.what();
+      continue;
+    }
+    if (reply.isMember("error")) {
+      LOG(WARNING) << "Agent on " << hosts[i] << " refused the request: "
+                   << reply["error"].asString();
+      continue;
+    }
+    int cores  = reply["cores"].asInt();
+    int memory = reply["memory"].asInt();
+    if (best < 0 || cores > best_cores ||
+        (cores == best_cores && memory > best_memory))
+    {
+      best = i;
+      best_cores  = cores;
+      best_memory = memory;
+    }
+  }
+  return best;
+}
+
+std::string Agent::readToken(std::string path, bool create) {
+  struct stat st;
+  if (create && ::stat(path.c_str(), &st) && errno == ENOENT) {
+    create_dir(boost::filesystem::path(path).parent_path().string());
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+      unsigned char bytes[16];
+      std::ifstream urandom("/dev/urandom", std::ios::binary);
+      urandom.read((char*)bytes, sizeof(bytes));
+      if (!urandom) {
+        ::close(fd);
+        ::unlink(path.c_str());
+        throw internalError("cannot read /dev/urandom");
+      }
+      std::stringstream ss;
+      for (int i = 0; i < sizeof(bytes); i++) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << (int)bytes[i];
+      }
+      std::string token = ss.str() + "\n";
+      bool written = ::write(fd, token.c_str(), token.size()) == token.size();
+      ::close(fd);
+      if (!written) {
+        ::unlink(path.c_str());
+        throw internalError("cannot write agent token to " + path);
+      }
+      LOG(INFO) << "Created agent token in " << path 
+                << ", copy it to every node unless the dir is shared";
+    }
+  }
+  if (::stat(path.c_str(), &st)) {
+    throw fileNotFound("cannot find agent token in " + path);
+  }
+  if (st.st_mode & (S_IRWXG | S_IRWXO)) {
+    throw invalidParam("agent token in " + path + 
+        " must only be accessible by its owner, run chmod 600 on it");
+  }
+  std::ifstream fin(path);
+  std::string token;
+  fin >> token;
+  if (token.empty()) {
+    throw invalidParam("agent token in " + path + " is empty");
+  }
+  return token;
+}
+
+} // namespace fcsgenome
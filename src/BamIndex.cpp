@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <glog/logging.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "fcs-genome/BamIndex.h"
+#include "fcs-genome/common.h"
+
+namespace fcsgenome {
+
+// bin of the bai holding the offsets and read counts of a reference
+static const uint32_t bai_pseudo_bin = 37450;
+
+template <typename T>
+static inline bool read_value(std::ifstream &fin, T &value) {
+  return (bool)fin.read((char*)&value, sizeof(T));
+}
+
+template <typename T>
+static inline bool read_value(gzFile fin, T &value) {
+  return gzread(fin, &value, sizeof(T)) == sizeof(T);
+}
+
+BamIndex::BamIndex(std::string bam_path) {
+  std::string bai = bai_path(bam_path);
+  if (!boost::filesystem::exists(bam_path)) {
+    throw fileNotFound("Cannot find " + bam_path);
+  }
+  if (bai.empty()) {
+    throw fileNotFound("Cannot find the index of " + bam_path);
+  }
+  readHeader(bam_path);
+  readIndex(bai);
+}
+
+std::string BamIndex::bai_path(std::string bam_path) {
+  if (boost::filesystem::exists(bam_path + ".bai")) {
+    return bam_path + ".bai";
+  }
+  std::string path = get_fname_by_ext(bam_path, "bai");
+  if (boost::filesystem::exists(path)) {
+    return path;
+  }
+  return std::string();
+}
+
+std::vector<double> BamIndex::load(std::string ref) {
+  if (!load_.count(ref)) {
+    return std::vector<double>();
+  }
+  return load_[ref];
+}
+
+// bgzf is a series of gzip members, so zlib reads it as a whole
+void BamIndex::readHeader(std::string bam_path) {
+  gzFile fin = gzopen(bam_path.c_str(), "rb");
+  if (!fin) {
+    throw fileNotFound("Cannot open " + bam_path);
+  }
+  char    magic[4];
+  int32_t l_text = 0;
+  int32_t n_ref = 0;
+  bool    good = gzread(fin, magic, 4) == 4 &&
+                 !memcmp(magic, "BAM\1", 4) &&
+                 read_value(fin, l_text) && l_text >= 0 &&
+                 gzseek(fin, l_text, SEEK_CUR) >= 0 &&
+                 read_value(fin, n_ref) && n_ref >= 0;
+
+  for (int i = 0; good && i < n_ref; i++) {
+    int32_t l_name = 0;
+    int32_t l_ref = 0;
+    good = read_value(fin, l_name) && l_name > 0;
+    if (good) {
+      std::vector<char> name(l_name);
+      good = gzread(fin, &name[0], l_name) == l_name &&
+             read_value(fin, l_ref);
+      refs_.push_back(std::string(&name[0], strnlen(&name[0], l_name)));
+    }
+  }
+  gzclose(fin);
+
+  if (!good) {
+    throw invalidParam("Cannot parse the header of " + bam_path);
+  }
+}
+
+void BamIndex::readIndex(std::string bai_path) {
+  std::ifstream fin(bai_path, std::ios::binary);
+  char    magic[4];
+  int32_t n_ref = 0;
+  if (!fin.read(magic, 4) || memcmp(magic, "BAI\1", 4) ||
+      !read_value(fin, n_ref) || n_ref != (int)refs_.size()) {
+    throw invalidParam("Cannot parse " + bai_path);
+  }
+
+  // bytes per window of each reference, and their mapped reads
+  std::vector<std::vector<double> > bytes(n_ref);
+  std::vector<int64_t> mapped(n_ref, -1);
+  double total_mapped = 0;
+  double total_bytes = 0;
+
+  for (int r = 0; r < n_ref; r++) {
+    int32_t  n_bin = 0;
+    uint64_t ref_beg = UINT64_MAX;
+    uint64_t ref_end = 0;
+    if (!read_value(fin, n_bin)) {
+      throw invalidParam("Cannot parse " + bai_path);
+    }
+    for (int b = 0; b < n_bin; b++) {
+      uint32_t bin;
+      int32_t  n_chunk;
+      if (!read_value(fin, bin) || !read_value(fin, n_chunk)) {
+        throw invalidParam("Cannot parse " + bai_path);
+      }
+      for (int c = 0; c < n_chunk; c++) {
+        uint64_t beg, end;
+        if (!read_value(fin, beg) || !read_value(fin, end)) {
+          throw invalidParam("Cannot parse " + bai_path);
+        }
+        if (bin == bai_pseudo_bin) {
+          // (ref_beg, ref_end), then (n_mapped, n_unmapped)
+          if (c == 1) mapped[r] = beg;
+          continue;
+        }
+        ref_beg = std::min(ref_beg, beg);
+        ref_end = std::max(ref_end, end);
+      }
+    }
+    int32_t n_intv = 0;
+    if (!read_value(fin, n_intv) || n_intv < 0) {
+      throw invalidParam("Cannot parse " + bai_path);
+    }
+    std::vector<uint64_t> offsets(n_intv);
+    for (int w = 0; w < n_intv; w++) {
+      if (!read_value(fin, offsets[w])) {
+        throw invalidParam("Cannot parse " + bai_path);
+      }
+      // windows without reads may be left as 0, and only the
+      // offset of the compressed block is comparable
+      offsets[w] = std::max(offsets[w], ref_beg == UINT64_MAX ? 0 : ref_beg) >> 16;
+      if (w > 0) offsets[w] = std::max(offsets[w], offsets[w-1]);
+    }
+    if (n_intv == 0 || ref_end == 0) {
+      continue;
+    }
+    bytes[r].resize(n_intv);
+    double ref_bytes = 0;
+    for (int w = 0; w < n_intv; w++) {
+      uint64_t next = w + 1 < n_intv ? offsets[w+1] : ref_end >> 16;
+      bytes[r][w] = next > offsets[w] ? next - offsets[w] : 0;
+      ref_bytes += bytes[r][w];
+    }
+    if (ref_bytes == 0) {
+      // all reads are in one block
+      std::fill(bytes[r].begin(), bytes[r].end(), 1);
+      ref_bytes = n_intv;
+    }
+    if (mapped[r] >= 0) {
+      total_mapped += mapped[r];
+      total_bytes  += ref_bytes;
+    }
+  }
+
+  // references without counts use the average reads per byte
+  double reads_per_byte = total_bytes > 0 ? total_mapped / total_bytes : 1;
+  for (int r = 0; r < n_ref; r++) {
+    if (bytes[r].empty()) continue;
+
+    double ratio = reads_per_byte;
+    if (mapped[r] >= 0) {
+      double ref_bytes = 0;
+      for (int w = 0; w < bytes[r].size(); w++) ref_bytes += bytes[r][w];
+      ratio = ref_bytes > 0 ? mapped[r] / ref_bytes : 0;
+    }
+    std::vector<double> &load = load_[refs_[r]];
+    load.resize(bytes[r].size());
+    for (int w = 0; w < bytes[r].size(); w++) {
+      load[w] = bytes[r][w] * ratio;
+    }
+  }
+  DLOG(INFO) << "Read the index of " << n_ref << " references from "
+             << bai_path;
+}
+
+} // namespace fcsgenome
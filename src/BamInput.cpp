@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -19,7 +20,9 @@
 #endif
 #include <glog/logging.h>
 
+#include "fcs-genome/common.h"
 #include "fcs-genome/config.h"
+#include "fcs-genome/BamIndex.h"
 #include "fcs-genome/BamInput.h"
 
 namespace fcsgenome {
@@ -70,11 +73,153 @@ int BamInput::files_in_dir(std::string dir_path, std::string ext){
   return files_with_ext;
 }
 
-BamInputInfo BamInput::merge_region(int contig){
+// buckets of the folder from its manifest, which is written on the
+// first call for the current bams of the folder and read afterwards
+void BamInput::load_manifest() {
+  namespace fs = boost::filesystem;
+  if (!buckets_.empty()) return;
+
+  std::vector<std::string> bams;
+  fs::directory_iterator end_iter;
+  for (fs::directory_iterator iter(data_.bam_name); iter != end_iter; ++iter) {
+    if (iter->path().extension() == ".bam") {
+      bams.push_back(iter->path().filename().string());
+    }
+  }
+  std::sort(bams.begin(), bams.end());
+
+  // keyed by the name, size and time of the bams, so that a folder
+  // written again at the same path gets a new manifest
+  std::stringstream key;
+  key << get_absolute_path(data_.bam_name);
+  for (auto bam : bams) {
+    fs::path path = fs::path(data_.bam_name) / bam;
+    key << ":" << bam << ":" << fs::file_size(path) << ":" 
+        << fs::last_write_time(path);
+  }
+  // the manifests of a folder share a parent, so that the ones of
+  // its earlier contents can be found and removed
+  std::stringstream ss;
+  ss << std::hex << std::hash<std::string>()(key.str());
+  if (is_folder_writable(data_.bam_name.c_str())) {
+    cache_dir_ = data_.bam_name + "/.fcs-buckets/" + ss.str();
+  }
+  else {
+    std::stringstream folder;
+    folder << std::hex 
+           << std::hash<std::string>()(get_absolute_path(data_.bam_name));
+    cache_dir_ = get_config<std::string>("temp_dir") + "/fcs-genome-buckets/" +
+        get_basename(get_absolute_path(data_.bam_name)) + "-" + 
+        folder.str() + "/" + ss.str();
+  }
+
+  std::string manifest = cache_dir_ + "/manifest";
+  std::ifstream fin(manifest);
+  std::string line;
+  while (std::getline(fin, line)) {
+    // bam, region, bytes and reads of a bucket
+    std::vector<std::string> fields;
+    boost::split(fields, line, boost::is_any_of("\t"));
+    if (line.empty() || line[0] == '#' || fields.size() < 4) continue;
+
+    BamBucket bucket;
+    bucket.bam    = data_.bam_name + "/" + fields[0];
+    bucket.region = fields[1] == "-" ? "" : data_.bam_name + "/" + fields[1];
+    bucket.bytes  = strtoull(fields[2].c_str(), NULL, 10);
+    bucket.reads  = strtoll(fields[3].c_str(), NULL, 10);
+    buckets_.push_back(bucket);
+  }
+  if (buckets_.size() == bams.size()) {
+    DLOG(INFO) << "Read the manifest of " << data_.bam_name 
+               << " from " << manifest;
+    return;
+  }
+  buckets_.clear();
+
+  for (auto bam : bams) {
+    BamBucket bucket;
+    bucket.bam = data_.bam_name + "/" + bam;
+    bucket.region = get_fname_by_ext(bucket.bam, region_ext_);
+    if (!boost::filesystem::exists(bucket.region)) bucket.region.clear();
+    bucket.bytes = fs::file_size(bucket.bam);
+    bucket.reads = -1;
+    try {
+      BamIndex index(bucket.bam);
+      double reads = 0;
+      for (auto ref : index.refs()) {
+        std::vector<double> load = index.load(ref);
+        for (int w = 0; w < load.size(); w++) reads += load[w];
+      }
+      bucket.reads = (int64_t)(reads + 0.5);
+    }
+    catch (std::runtime_error &e) {
+      DLOG(INFO) << e.what();
+    }
+    buckets_.push_back(bucket);
+  }
+
+  // written to a file of this thread and renamed, so that other 
+  // workers never read a partial one
+  create_dir(cache_dir_);
+  std::string tmp = manifest + "." + std::to_string((long long)getTid());
+  std::ofstream fout(tmp);
+  fout << "#bam\tregion\tbytes\treads" << std::endl;
+  for (auto bucket : buckets_) {
+    fout << get_basename(bucket.bam) << "\t" 
+         << (bucket.region.empty() ? "-" : get_basename(bucket.region)) << "\t"
+         << bucket.bytes << "\t" << bucket.reads << std::endl;
+  }
+  fout.close();
+  boost::filesystem::rename(tmp, manifest);
+  DLOG(INFO) << "Wrote the manifest of " << data_.bam_name 
+             << " to " << manifest;
+
+  // the bams the other manifests are for are gone
+  fs::path cache_path(cache_dir_);
+  std::vector<fs::path> stale;
+  for (fs::directory_iterator iter(cache_path.parent_path()); 
+       iter != end_iter; ++iter) {
+    if (iter->path().filename() != cache_path.filename()) {
+      stale.push_back(iter->path());
+    }
+  }
+  for (auto path : stale) {
+    boost::system::error_code ec;
+    fs::remove_all(path, ec);
+    DLOG(INFO) << "Removed the stale manifest in " << path.string();
+  }
+}
+
+// first bucket of each of ngroups groups of consecutive buckets of
+// about the same weight, each with at least one bucket, then the 
+// number of buckets
+static std::vector<int> pack_buckets(std::vector<double> &weights, 
+    int ngroups) 
+{
+  std::vector<double> cum(1, 0);
+  for (int i = 0; i < weights.size(); i++) {
+    cum.push_back(cum.back() + weights[i]);
+  }
+  int nbuckets = weights.size();
+
+  std::vector<int> first(ngroups + 1, 0);
+  first[ngroups] = nbuckets;
+  for (int k = 1; k < ngroups; k++) {
+    double target = cum.back() * k / ngroups;
+    // the boundary nearest to the target
+    int b = std::lower_bound(cum.begin(), cum.end(), target) - cum.begin();
+    if (b > 0 && target - cum[b-1] <= cum[b] - target) b--;
+
+    b = std::max(b, first[k-1] + 1);
+    b = std::min(b, nbuckets - (ngroups - k));
+    first[k] = b;
+  }
+  return first;
+}
+
+BamInputInfo BamInput::merge_region(int contig, BamInput* paired){
   if (data_.bam_isdir) {
     // Check the existence of BED or list files:
-    int region_file_number;
-    std::string ext;
     if (data_.bedfiles_number==0) {
       if (data_.listfiles_number==0) {
         throw std::runtime_error("No BED or list files in " + data_.bam_name);
@@ -83,62 +228,86 @@ BamInputInfo BamInput::merge_region(int contig){
         if (data_.listfiles_number<get_config<int>("gatk.ncontigs")) {
 	  throw std::runtime_error("Number of List Files less than ncontig");
 	}
-        region_file_number=data_.listfiles_number;
-        ext = "list";
+        region_ext_ = "list";
       }
     }
     else {
       if (data_.bedfiles_number<get_config<int>("gatk.ncontigs")) {
         throw std::runtime_error("Number of BED Files less than ncontig");
       }
-      region_file_number=data_.bedfiles_number;
-      ext = "bed";
+      region_ext_ = "bed";
     }
+    load_manifest();
 
-    int my_num = (int) region_file_number/get_config<int>("gatk.ncontigs");
+    int ngroups = get_config<int>("gatk.ncontigs");
+    if (buckets_.size() < ngroups) {
+      throw std::runtime_error("Number of BAM Files less than ncontig");
+    }
 
-    int first,last;
-    first=contig*my_num;
-    last=(contig+1)*my_num;
-    std::vector<std::string> BAMvector;   
-    if (last>data_.bamfiles_number) {
-      if (data_.bamfiles_number%2==0){
-        last=data_.bamfiles_number;
-      } 
-      else {
-        last=data_.bamfiles_number-1;
+    // by reads if every bucket has an index, otherwise by bytes
+    std::vector<BamBucket> buckets = buckets_;
+    std::string group_dir = cache_dir_ + "/groups_" + std::to_string((long long)ngroups);
+    if (paired && paired->data_.bam_isdir) {
+      paired->region_ext_ = region_ext_;
+      paired->load_manifest();
+      if (paired->buckets_.size() != buckets.size()) {
+        throw std::runtime_error("Number of BAM Files differs in " + 
+            data_.bam_name + " and " + paired->data_.bam_name);
+      }
+      for (int i = 0; i < buckets.size(); i++) {
+        buckets[i].bytes += paired->buckets_[i].bytes;
+        buckets[i].reads = (buckets[i].reads < 0 || paired->buckets_[i].reads < 0) ?
+            -1 : buckets[i].reads + paired->buckets_[i].reads;
       }
+      group_dir += "-" + get_basename(paired->cache_dir_);
+    }
+    bool by_reads = true;
+    for (auto bucket : buckets) {
+      if (bucket.reads < 0) by_reads = false;
     }
+    std::vector<double> weights;
+    for (auto bucket : buckets) {
+      weights.push_back(by_reads ? bucket.reads : bucket.bytes);
+    }
+    std::vector<int> first = pack_buckets(weights, ngroups);
 
-    std::string my_name = conf_temp_dir + "/part-" + std::to_string(first) + "_" + std::to_string(last-1) + ".bed" ;   
-
-    // If more than 1 pair (BAM, BED) goes to 1 gatk process, the BED files need to be merged.
-    // Otherwise the process will fail due to no overlapping regions.
-    std::ofstream merge_region;
-    merge_region.open(my_name,std::ofstream::out | std::ofstream::app);
-    for (int i=first; i<last;++i) {
-       std::string input = get_bucket_fname(data_.bam_name, i);
-       std::string input_region = get_fname_by_ext(input, ext);
-       if (boost::filesystem::exists(input_region)) {
-         if (abs(first-last)==1) {
-    	    // for 1 pair of (BAM, REGION) per GATK process:
-    	    data_.mergedREGION.push_back(input_region);
-         }
-         else {
-    	    // for multiple pairs of (BAM, REGION) per GATK process:
-    	    std::ifstream single_region(input_region);
-    	    merge_region << single_region.rdbuf();
-         }
-       }
-       // Pushing BAM files
-       BAMvector.push_back(input);
+    std::vector<std::string> BAMvector;   
+    std::vector<std::string> regions;
+    for (int i = first[contig]; i < first[contig+1]; i++) {
+      // Pushing BAM files
+      BAMvector.push_back(buckets_[i].bam);
+      if (!buckets_[i].region.empty()) {
+        regions.push_back(buckets_[i].region);
+      }
     }
-    merge_region.close();
     data_.partsBAM.insert(std::pair<int, std::vector<std::string> >(contig,BAMvector));  
-   
-    // Pushing the merged REGION File:
-    if (abs(first-last)>1) data_.mergedREGION.push_back(my_name);
 
+    if (regions.size() == 1) {
+      // for 1 pair of (BAM, REGION) per GATK process:
+      data_.mergedREGION.push_back(regions[0]);
+    }
+    else if (regions.size() > 1) {
+      // If more than 1 pair (BAM, BED) goes to 1 gatk process, the BED files need to be merged.
+      // Otherwise the process will fail due to no overlapping regions.
+      // The merged file is kept with the manifest so that the other steps on the same
+      // folder reuse it.
+      std::string merged = get_contig_fname(group_dir, contig, region_ext_, "part-");
+      if (!boost::filesystem::exists(merged)) {
+        create_dir(group_dir);
+        std::string tmp = merged + "." + std::to_string((long long)getTid());
+        std::ofstream merge_region(tmp);
+        for (auto region : regions) {
+          std::ifstream single_region(region);
+          merge_region << single_region.rdbuf();
+        }
+        merge_region.close();
+        boost::filesystem::rename(tmp, merged);
+      }
+      data_.mergedREGION.push_back(merged);
+    }
+    DLOG(INFO) << "Group " << contig << " of " << data_.bam_name << " has buckets "
+               << first[contig] << " to " << first[contig+1] - 1 << " by "
+               << (by_reads ? "reads" : "bytes");
   }
   else {
     std::vector<std::string> singleBAM;
@@ -152,6 +321,10 @@ BamInputInfo BamInput::getInfo(){
   return data_;
 };
 
+std::vector<BamBucket> BamInput::getBuckets(){
+  return buckets_;
+};
+
 std::string BamInput::get_gatk_args(int index, BamInput::InputType input){
   std::string gatk_command_;
 
@@ -0,0 +1,163 @@
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstdio>
+#include <fstream>
+#include <glog/logging.h>
+#include <map>
+#include <sstream>
+#include <unistd.h>
+
+#include "fcs-genome/ClassArchive.h"
+#include "fcs-genome/common.h"
+#include "fcs-genome/config.h"
+
+namespace fcsgenome {
+
+std::string get_java_version(std::string java) {
+  static boost::mutex mutex;
+  static std::map<std::string, std::string> versions;
+
+  boost::lock_guard<boost::mutex> guard(mutex);
+  if (versions.count(java)) {
+    return versions[java];
+  }
+  // e.g. openjdk version "11.0.2" 2019-01-15
+  std::string output;
+  FILE* pipe = popen((java + " -version 2>&1").c_str(), "r");
+  if (pipe) {
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) {
+      output.append(buf, n);
+    }
+    pclose(pipe);
+  }
+  std::string version;
+  size_t begin = output.find(" version \"");
+  if (begin != std::string::npos) {
+    begin += 10;
+    size_t end = output.find('"', begin);
+    if (end != std::string::npos) {
+      version = output.substr(begin, end - begin);
+    }
+  }
+  versions[java] = version;
+  return version;
+}
+
+int get_java_major(std::string version) {
+  // releases before 9 are numbered 1.x
+  if (version.compare(0, 2, "1.") == 0) {
+    version = version.substr(2);
+  }
+  return std::atoi(version.c_str());
+}
+
+// archives dumped by this process, empty for the jars without one
+static boost::mutex archives_mutex;
+static std::map<std::string, std::string> archives;
+
+std::string dump_class_archive(std::string java, std::string jar) {
+  namespace fs = boost::filesystem;
+
+  boost::lock_guard<boost::mutex> guard(archives_mutex);
+  std::string key = java + " " + jar;
+  if (archives.count(key)) {
+    return archives[key];
+  }
+  archives[key] = "";
+
+  std::string version = get_java_version(java);
+  if (get_java_major(version) < 11) {
+    DLOG(INFO) << "Java " << version << " cannot share the classes of " 
+               << jar;
+    return "";
+  }
+  if (!fs::exists(jar)) {
+    return "";
+  }
+
+  std::string dir = get_config<std::string>("gatk.cds_dir");
+  if (dir.empty()) {
+    dir = get_config<std::string>("temp_dir") + "/fcs-genome-cds";
+  }
+  try {
+    create_dir(dir);
+  }
+  catch (silentExit &e) {
+    return "";
+  }
+
+  std::string java_tag = version;
+  for (int i = 0; i < java_tag.size(); i++) {
+    if (!isalnum(java_tag[i])) java_tag[i] = '_';
+  }
+  std::string archive = dir + "/" + fs::path(jar).stem().string() + "-" + 
+      get_file_checksum(jar) + "-java" + java_tag + ".jsa";
+  if (fs::exists(archive)) {
+    archives[key] = archive;
+    return archive;
+  }
+
+  // dump to a file of this process and rename it, so that
+  // processes dumping the same archive do not see each other's
+  uint64_t start_ts = getTs();
+  std::string tmp = archive + "." + std::to_string((long long)getpid());
+  std::string class_list = tmp + ".classlist";
+  std::string log = tmp + ".log";
+
+  std::stringstream cmd;
+  cmd << java << " -Xshare:off -XX:DumpLoadedClassList=" << class_list
+      << " -jar " << jar << " --help > " << log << " 2>&1";
+  system(cmd.str().c_str());
+
+  cmd.str("");
+  cmd << java << " -Xshare:dump -XX:SharedClassListFile=" << class_list
+      << " -XX:SharedArchiveFile=" << tmp
+      << " -cp " << jar << " >> " << log << " 2>&1";
+  if (system(cmd.str().c_str()) == 0 && fs::exists(tmp)) {
+    boost::system::error_code err;
+    fs::rename(tmp, archive, err);
+    if (!err) {
+      archives[key] = archive;
+      LOG(INFO) << "Dumped class-data-sharing archive " << archive
+                << " in " << (getTs() - start_ts) << " seconds";
+    }
+  }
+  else {
+    LOG(WARNING) << "Failed to dump class-data-sharing archive of " << jar
+                 << ", running without it, see " << log;
+    log.clear();
+  }
+  remove_path(tmp);
+  remove_path(class_list);
+  if (!log.empty()) {
+    remove_path(log);
+  }
+
+  return archives[key];
+}
+
+void dump_class_archives() {
+  if (!get_config<bool>("gatk.cds") || get_config<bool>("latency_mode")) {
+    return;
+  }
+  std::string java = get_config<std::string>("java_path");
+  std::string jars[2] = {
+    get_config<std::string>("gatk_path"),
+    get_config<std::string>("gatk4_path")};
+  for (int i = 0; i < 2; i++) {
+    dump_class_archive(java, jars[i]);
+  }
+}
+
+std::string get_class_archive(std::string java, std::string jar) {
+  boost::lock_guard<boost::mutex> guard(archives_mutex);
+  std::string key = java + " " + jar;
+  if (archives.count(key)) {
+    return archives[key];
+  }
+  return "";
+}
+
+} // namespace fcsgenome
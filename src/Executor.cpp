@@ -1,25 +1,72 @@
 #include <algorithm>
+#include <atomic>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/thread/future.hpp>
 #include <boost/thread/lockable_adapter.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
 #include <string>
+#include <sys/stat.h>
 #include <sys/wait.h>
 
+#include "fcs-genome/Agent.h"
+#include "fcs-genome/ClassArchive.h"
 #include "fcs-genome/common.h"
 #include "fcs-genome/Executor.h"
+#include "fcs-genome/JvmPool.h"
 #include "fcs-genome/LogUtils.h"
 
+extern char** environ;
+
 namespace fcsgenome {
 
 boost::mutex mutex_sig;
 
+// tasks run in their own process groups and do not see the 
+// terminal's SIGINT, so the handler needs to find them here; 
+// it can interrupt a thread holding the lock of an executor, 
+// so the groups are kept in slots it reads without any lock
+static const int max_task_groups = 4096;
+static std::atomic<pid_t> task_groups[max_task_groups];
+
+static void add_task_group(pid_t pgid) {
+  for (int i = 0; i < max_task_groups; i++) {
+    pid_t empty = 0;
+    if (task_groups[i].compare_exchange_strong(empty, pgid)) {
+      return;
+    }
+  }
+  LOG(WARNING) << "Too many running tasks, process group " << pgid
+               << " will not be interrupted";
+}
+
+static void remove_task_group(pid_t pgid) {
+  for (int i = 0; i < max_task_groups; i++) {
+    pid_t expected = pgid;
+    if (task_groups[i].compare_exchange_strong(expected, 0)) {
+      return;
+    }
+  }
+}
+
 // put signal handler here because it will be the worker thread 
 // that catches the signal
 void sigint_handler(int s) {
+  for (int i = 0; i < max_task_groups; i++) {
+    pid_t pgid = task_groups[i].load();
+    if (pgid > 0) {
+      kill(-pgid, SIGINT);
+    }
+  }
   boost::lock_guard<boost::mutex> guard(mutex_sig);
   //DLOG(INFO) << "Caught interrupt in worker";
   LOG(INFO) << "Caught interrupt, cleaning up...";
@@ -36,59 +83,79 @@ void sigint_handler(int s) {
   exit(1);
 }
 
-Stage::Stage(Executor* executor, std::string label): 
+Stage::Stage(Executor* executor, std::string label,
+    std::string sample_id, bool speculative): 
   executor_(executor),
-  label_(label)
-{;}
+  label_(label),
+  sample_id_(sample_id),
+  num_finished_(0),
+  speculative_(speculative),
+  started_(false),
+  start_ts_(0)
+{
+  log_fname_ = executor_->get_log_name(label_);
+}
 
-void Stage::add(Worker_ptr worker) {
-  logs_.push_back(executor_->get_log_name(label_, logs_.size()));
+int Stage::add(Worker_ptr worker, int log_idx) {
+  logs_.push_back(executor_->get_log_name(label_, log_idx));
   tasks_.push_back(worker);  
+  return tasks_.size() - 1;
 }
 
-//void Stage::run(std::string sample_id) {
-void Stage::run() {
-  uint64_t start_ts = getTs();
-
-  typedef boost::packaged_task<void> task_t;
-  std::vector<boost::unique_future<void> > pending_tasks_;
-
-  // post all tasks
+void Stage::start() {
+  if (started_) return;
+  started_ = true;
+  start_ts_ = getTs();
   LOG(INFO) << "Start doing " << label_;
+}
 
-  for (int i = 0; i < tasks_.size(); i++) {
-    tasks_[i]->check();
-
-    boost::shared_ptr<task_t> task = boost::make_shared<task_t>(
-        boost::bind(&Stage::runTask, this, i));
-
-    boost::unique_future<void> fut = task->get_future();
-    pending_tasks_.push_back(std::move(fut));
-
-    executor_->post(boost::bind(&task_t::operator(), task));      
+// record the result of one task, return true if this 
+// is the last task of the stage
+bool Stage::finish(int idx, int ret, bool skipped) {
+  if (skipped) {
+    skipped_.insert(idx);
   }
+  else if (ret) {
+    DLOG(ERROR) << "Task " << idx << " in stage"
+                << " failed with error code " << ret;
+    status_[idx] = ret;
+  }
+  num_finished_++;
+  return num_finished_ == tasks_.size();
+}
 
-  // wait for tasks to finish
-  boost::wait_for_all(pending_tasks_.begin(), pending_tasks_.end()); 
+void Stage::report() {
+  if (speculative_ && !skipped_.empty() && status_.empty()) {
+    LOG(INFO) << "Cancelled " << label_ 
+              << " because the original task finished first";
+    return;
+  }
+  if (skipped_.size() == tasks_.size()) {
+    LOG(WARNING) << "Skipped " << label_ 
+                 << " because a previous task failed";
+    return;
+  }
 
-  // concat all logs
-  std::string output_log = executor_->get_log_name(label_);
-  
-  std::ofstream fout(output_log, std::ios::out|std::ios::app); 
-  for (int i = 0; i < logs_.size(); i++) {
-    std::ifstream fin(logs_[i], std::ios::in);   
-    if (fin) {
-      fout << fin.rdbuf();
-    }
-    fin.close();
+  // the output of the tasks is already in the stage log
+  std::string output_log = log_fname_;
+  if (!log_.is_open()) {
+    log_.open(output_log, std::ios::out|std::ios::app); 
   }
-  fout.flush();
-  fout.close();
+  log_.close();
 
   // check if any error message in log files
-  if (!status_.empty()) {
+  if (!status_.empty() && speculative_) {
+    LOG(WARNING) << label_ << " failed, kept the output of the original "
+                 << "task, please check log: " << output_log;
+  }
+  else if (!status_.empty()) {
+    std::vector<std::string> failed_logs;
+    for (std::map<int, int>::iterator it = status_.begin(); 
+         it != status_.end(); it++) {
+      failed_logs.push_back(logs_[it->first]);
+    }
     fcsgenome::LogUtils logUtils;
-    std::string match = logUtils.findError(logs_);
+    std::string match = logUtils.findError(failed_logs);
     LOG(ERROR) << label_ << " failed, please check log: " 
                << output_log  << " for details.";
     if (!match.empty()) {
@@ -97,31 +164,99 @@ void Stage::run() {
     }
     throw failedCommand("");
   }
+  else if (!skipped_.empty()) {
+    LOG(WARNING) << label_ << " is incomplete, skipped " 
+                 << skipped_.size() << " tasks because a previous task failed";
+  }
   else {
-    log_time(label_ , start_ts);
+    log_time(label_ , start_ts_);
   }
 
-  for (int i = 0; i < logs_.size(); i++) {
-    // remove task log
-    remove_path(logs_[i]);
+  // remove logs of failed attempts that were started again
+  for (std::set<int>::iterator it = saved_logs_.begin(); 
+       it != saved_logs_.end(); it++) {
+    remove_path(logs_[*it]);
   }
 }
 
-void Stage::runTask(int idx) {
-  int ret = executor_->execute(tasks_[idx], logs_[idx]);
-  if (ret) {
-    DLOG(ERROR) << "Task " << idx << " in stage"
-                << " failed with error code " << ret;
-    boost::lock_guard<Stage> guard(*this);
-    status_[idx] = ret;
+void Stage::write(int idx, const std::string &lines) {
+  if (!log_.is_open()) {
+    log_.open(log_fname_, std::ios::out|std::ios::app); 
+  }
+  std::string prefix = "[task " + std::to_string((long long)idx) + "] ";
+  size_t start = 0;
+  while (start < lines.size()) {
+    size_t end = lines.find('\n', start);
+    if (end == std::string::npos) end = lines.size() - 1;
+    log_ << prefix;
+    log_.write(lines.data() + start, end - start + 1);
+    start = end + 1;
+  }
+  log_.flush();
+}
+
+void Stage::saveLog(int idx, const std::string &output) {
+  std::ofstream fout(logs_[idx], std::ios::out|std::ios::trunc);
+  fout << output;
+  fout.close();
+  saved_logs_.insert(idx);
+}
+
+static bool write_cgroup(std::string dir, std::string key, std::string value) {
+  std::ofstream fout(dir + "/" + key);
+  fout << value << std::endl;
+  fout.close();
+  if (!fout) {
+    DLOG(WARNING) << "Cannot write '" << value << "' to " << dir << "/" << key;
+    return false;
+  }
+  return true;
+}
+
+// read a value of a flat keyed cgroup file, or the first 
+// value of a single value file if key is empty
+static uint64_t read_cgroup(std::string dir, std::string fname, 
+    std::string key = "") 
+{
+  std::ifstream fin(dir + "/" + fname);
+  std::string name;
+  uint64_t value;
+  if (key.empty()) {
+    return fin >> value ? value : 0;
+  }
+  while (fin >> name >> value) {
+    if (name == key) return value;
   }
+  return 0;
 }
 
 Executor::Executor(std::string job_name, int num_executors):
   job_name_(job_name),
   num_executors_(num_executors),
-  job_id_(0)
+  job_id_(0),
+  num_running_(0),
+  cores_used_(0),
+  memory_used_(0),
+  num_finished_(0),
+  cancelled_(false),
+  watching_(false),
+  stopping_(false)
 {
+  cores_budget_  = get_config<int>("executor.ncores");
+  memory_budget_ = get_config<int>("executor.memory");
+
+  // finished tasks are only recorded for runs that may be resumed
+  if (conf_resume) {
+    ledger_.reset(new TaskLedger(conf_project_dir + "/ledger.json"));
+  }
+
+  std::string policy = get_config<std::string>("executor.failure_policy");
+  if (policy != "fail-fast" && policy != "best-effort") {
+    LOG(WARNING) << "Unknown executor.failure_policy '" << policy 
+                 << "', using best-effort";
+  }
+  fail_fast_ = policy == "fail-fast";
+
   // create thread group
   boost::shared_ptr<boost::asio::io_service> ios(new boost::asio::io_service);
   ios_ = ios;
@@ -131,6 +266,56 @@ Executor::Executor(std::string job_name, int num_executors):
       new boost::asio::io_service::work(*ios));
   ios_work_ = work;
 
+  for (int t = 0; t < num_executors; t++) {
+    free_slots_.insert(t);
+  }
+
+  // reap finished tasks when SIGCHLD arrives
+  sigchld_.reset(new boost::asio::signal_set(*ios, SIGCHLD));
+  waitChildren();
+
+  straggler_timer_.reset(new boost::asio::deadline_timer(*ios));
+
+  // node-wide admission shared with other fcs-genome processes, 
+  // leases are renewed from their own thread since the executor 
+  // threads may all be waiting for slots
+  std::string broker = get_config<std::string>("executor.broker");
+  if (!broker.empty()) {
+    try {
+      broker_.reset(new SlotClient(broker, 
+            get_config<int>("executor.broker_lease")));
+      broker_renewer_ = boost::thread(
+          boost::bind(&Executor::renewSlots, this));
+    }
+    catch (boost::interprocess::interprocess_exception &e) {
+      LOG(WARNING) << "Cannot reach slot broker '" << broker << "': "
+                   << e.what() << ", running without it";
+      broker_.reset();
+    }
+  }
+
+  // tasks run in leaves of a cgroup of this executor, which needs 
+  // the memory and cpu controllers delegated from the parent
+  std::string cgroup_root = get_config<std::string>("executor.cgroup");
+  if (!cgroup_root.empty()) {
+    static boost::atomic<int> num_cgroups(0);
+    cgroup_dir_ = cgroup_root + "/fcs-genome-" + 
+        std::to_string((long long)getpid()) + "." +
+        std::to_string((long long)num_cgroups.fetch_add(1));
+    if (mkdir(cgroup_dir_.c_str(), 0755) && errno != EEXIST) {
+      LOG(WARNING) << "Cannot create cgroup " << cgroup_dir_ 
+                   << ": " << strerror(errno) << ", tasks will run without limits";
+      cgroup_dir_.clear();
+    }
+    else {
+      const char* controllers[] = {"+memory", "+cpu"};
+      for (int i = 0; i < 2; i++) {
+        write_cgroup(cgroup_root, "cgroup.subtree_control", controllers[i]);
+        write_cgroup(cgroup_dir_, "cgroup.subtree_control", controllers[i]);
+      }
+    }
+  }
+
   for (int t = 0; t < num_executors; t++) {
     executors_.create_thread(
         boost::bind(&boost::asio::io_service::run, ios.get()));
@@ -159,6 +344,7 @@ Executor::Executor(std::string job_name, int num_executors):
 Executor::~Executor() {
 
   DLOG(INFO) << "Killing executor";
+  killTasks(SIGHUP);
 
   // kill all forked processes
   for (int i = 0; i < job_id_.load(); i++) {
@@ -180,36 +366,1438 @@ Executor::~Executor() {
   }
 
   // wait for worker threads to finish
-  ios_work_.reset();
-  executors_.join_all();
+  stop();
+
+  if (!cgroup_dir_.empty()) {
+    namespace fs = boost::filesystem;
+    boost::system::error_code err;
+    for (fs::directory_iterator it(cgroup_dir_, err), end;
+         !err && it != end; it.increment(err)) {
+      if (fs::is_directory(it->path(), err)) {
+        rmdir(it->path().c_str());
+      }
+    }
+    rmdir(cgroup_dir_.c_str());
+  }
+}
+
+void Executor::killTasks(int sig) {
+  for (std::map<pid_t, int>::iterator it = children_.begin();
+       it != children_.end(); it++) {
+    DLOG(INFO) << "Killing process group " << it->first;
+    kill(-it->first, sig);
+  }
+}
+
+// turn a path into an absolute path without '.' and '..' so 
+// that different spellings of the same file match
+static std::string normalize_path(std::string path) {
+  namespace fs = boost::filesystem;
+  fs::path abs_path = fs::absolute(fs::path(path));
+  fs::path ret;
+  for (fs::path::iterator it = abs_path.begin(); it != abs_path.end(); it++) {
+    if (it->string() == ".") {
+      continue;
+    }
+    else if (it->string() == "..") {
+      ret = ret.parent_path();
+    }
+    else {
+      ret /= *it;
+    }
+  }
+  return ret.string();
+}
+
+// collect tasks in table that access path, a parent directory 
+// of path, or a file inside path
+static void find_tasks(
+    std::map<std::string, std::vector<int> > &table,
+    std::string path,
+    std::set<int> &tasks) 
+{
+  typedef std::map<std::string, std::vector<int> >::iterator iter_t;
+  boost::filesystem::path p(path);
+  while (!p.empty()) {
+    iter_t it = table.find(p.string());
+    if (it != table.end()) {
+      tasks.insert(it->second.begin(), it->second.end());
+    }
+    if (p == p.root_path()) break;
+    p = p.parent_path();
+  }
+  std::string prefix = path + "/";
+  for (iter_t it = table.lower_bound(prefix); 
+       it != table.end() && boost::starts_with(it->first, prefix); 
+       it++) {
+    tasks.insert(it->second.begin(), it->second.end());
+  }
+}
+
+void Executor::addDeps(int id, Worker_ptr worker, bool new_stage) {
+  Stage* stage = tasks_[id].stage;
+
+  if (new_stage) {
+    // tasks without declared files wait for all tasks 
+    // of previous stages, it is enough to wait for the sinks
+    barrier_.clear();
+    for (int i = 0; i < id; i++) {
+      if (tasks_[i].children.empty()) barrier_.push_back(i);
+    }
+    if (!next_fence_.empty()) {
+      fence_.swap(next_fence_);
+      next_fence_.clear();
+    }
+  }
+
+  std::vector<std::string> inputs  = worker->getInputs();
+  std::vector<std::string> outputs = worker->getOutputs();
+
+  std::set<int> deps;
+  if (inputs.empty() && outputs.empty()) {
+    deps.insert(barrier_.begin(), barrier_.end());
+    next_fence_.push_back(id);
+  }
+  else {
+    // outputs of tasks without declared files are unknown, 
+    // so wait for them as well
+    deps.insert(fence_.begin(), fence_.end());
+
+    for (int i = 0; i < inputs.size(); i++) {
+      inputs[i] = normalize_path(inputs[i]);
+      find_tasks(writers_, inputs[i], deps);
+    }
+    for (int i = 0; i < outputs.size(); i++) {
+      outputs[i] = normalize_path(outputs[i]);
+      find_tasks(writers_, outputs[i], deps);
+      find_tasks(readers_, outputs[i], deps);
+    }
+    for (int i = 0; i < inputs.size(); i++) {
+      readers_[inputs[i]].push_back(id);
+    }
+    for (int i = 0; i < outputs.size(); i++) {
+      writers_[outputs[i]].push_back(id);
+    }
+  }
+
+  for (std::set<int>::iterator it = deps.begin(); it != deps.end(); it++) {
+    // tasks in the same stage are independent
+    if (*it == id || tasks_[*it].stage == stage) continue;
+    tasks_[*it].children.push_back(id);
+    tasks_[id].num_deps++;
+  }
 }
 
 //void Executor::addTask(Worker_ptr worker, std::string job_label, bool wait_for_prev) {
 void Executor::addTask(Worker_ptr worker, std::string sample_id,  bool wait_for_prev) {
-  if (job_stages_.empty() || wait_for_prev) {
+  boost::lock_guard<Executor> guard(*this);
+
+  bool new_stage = job_stages_.empty() || wait_for_prev;
+  if (new_stage) {
     std::string stage_label = worker->getTaskName();
     if (!sample_id.empty()) stage_label += " " + sample_id;
 
-    Stage_ptr stage(new Stage(this, stage_label));
-    job_stages_.push(stage);
+    Stage_ptr stage(new Stage(this, stage_label, sample_id));
+    job_stages_.push_back(stage);
+  }
+  int id = newTask(job_stages_.back().get(), worker);
+
+  addDeps(id, worker, new_stage);
+}
+
+// add a task without dependencies to the graph and return its id
+int Executor::newTask(Stage* stage, Worker_ptr worker) {
+  Task task;
+  task.stage = stage;
+  // number task logs by task id so that stages with the same 
+  // label running at the same time do not share log files
+  task.idx = task.stage->add(worker, tasks_.size());
+  task.num_deps = 0;
+  task.skipped = false;
+  task.cached  = false;
+  task.fatal   = false;
+  task.speculated = false;
+  task.spec_won = false;
+  task.original = -1;
+  task.slot = -1;
+  task.attempts = 0;
+  task.host = -1;
+  task.grant = -1;
+  task.request = -1;
+  task.checked = false;
+  task.ret = 0;
+  task.ready_ts = 0;
+  task.start_ts = 0;
+  task.end_ts = 0;
+  task.read_bytes = 0;
+  task.write_bytes = 0;
+  task.memory_peak = 0;
+  task.throttled_us = 0;
+  memset(&task.usage, 0, sizeof(task.usage));
+
+  // tasks sent to other hosts do not use local resources
+  if (get_config<bool>("latency_mode") && 
+      worker->num_process_ == 1 &&
+      conf_host_list.size() > 1) 
+  {
+    task.cores  = 0;
+    task.memory = 0;
+  }
+  else {
+    task.cores  = worker->num_process_ * worker->num_thread_;
+    task.memory = worker->num_process_ * worker->memory_;
+  }
+  tasks_.push_back(task);
+
+  return tasks_.size() - 1;
+}
+
+// post ready tasks to the executor threads, lower ids first, 
+// as long as their cores and memory fit in the node budget,
+// must be called with the lock held
+void Executor::dispatch() {
+  // tasks that became ready after a failure in fail-fast mode
+  while (cancelled_ && !ready_.empty()) {
+    int id = *ready_.begin();
+    ready_.erase(ready_.begin());
+    tasks_[id].skipped = true;
+    finishTask(id, 0, true);
+  }
+
+  int cores  = cores_budget_ - cores_used_;
+  // the heap of idle pooled jvms is held outside of any task
+  int memory = memory_budget_ - memory_used_ - JvmPool::reserved();
+
+  bool unchecked = false;
+  std::set<int>::iterator it = ready_.begin();
+  while (it != ready_.end() && num_running_ < num_executors_) {
+    int id = *it;
+    Task &task = tasks_[id];
+
+    // run() checks the task first
+    if (!task.checked) {
+      unchecked = true;
+      it++;
+      continue;
+    }
+
+    // a task larger than the whole budget runs when the node is idle
+    if (num_running_ > 0 && 
+        (task.cores > cores || task.memory > memory)) 
+    {
+      // keep the resources for this task so that it 
+      // is not starved by smaller tasks behind it
+      cores  -= task.cores;
+      memory -= task.memory;
+      it++;
+      continue;
+    }
+    cores  -= task.cores;
+    memory -= task.memory;
+    cores_used_  += task.cores;
+    memory_used_ += task.memory;
+
+    ready_.erase(it++);
+    task.slot = *free_slots_.begin();
+    free_slots_.erase(free_slots_.begin());
+    task.start_ts = getUs();
+    num_running_++;
+    task.stage->start();
+    post(boost::bind(&Executor::runTask, this, id));
+  }
+  if (unchecked) {
+    cond_.notify_all();
+  }
+
+  // look for stragglers while slots are idle
+  if (!watching_ && !stopping_ && 
+      ready_.empty() && num_running_ > 0 &&
+      num_executors_ - num_running_ >= 2 &&
+      get_config<int>("executor.speculation") > 0) 
+  {
+    watching_ = true;
+    watchStragglers();
+  }
+}
+
+void Executor::runTask(int id) {
+  Stage* stage;
+  int    idx;
+  int    slot;
+  int    cores;
+  int    original;
+  {
+    // the timer thread adds split tasks to the graph meanwhile,
+    // so only read the task with the lock held
+    boost::lock_guard<Executor> guard(*this);
+    stage    = tasks_[id].stage;
+    idx      = tasks_[id].idx;
+    slot     = tasks_[id].slot;
+    cores    = tasks_[id].cores;
+    original = tasks_[id].original;
+
+    // wait for slots shared with other processes on the node 
+    // without holding the thread, grantTask() starts the task
+    if (broker_ && cores > 0 && tasks_[id].grant < 0) {
+      requestSlots(id);
+      return;
+    }
+
+    // spawn() finds the task of the calling thread here
+    launching_[boost::this_thread::get_id()] = id;
+  }
+
+  // run the task on the numa node of its slot, the processes 
+  // started from this thread inherit the placement
+  int  node  = slot % numa_.num_nodes();
+  bool bound = false;
+  if (get_config<bool>("executor.numa") && numa_.num_nodes() > 1 &&
+      cores > 0 && cores <= numa_.num_cpus(node)) 
+  {
+    bound = numa_.bind(node);
+  }
+
+  if (!cgroup_dir_.empty()) {
+    createCgroup(id);
+  }
+
+  pid_t pid = -1;
+  try {
+    pid = execute(stage->task(idx), stage->log(idx));
+  }
+  catch (...) {
+    boost::lock_guard<Executor> guard(*this);
+    // the original task still runs if a split task fails
+    if (!error_ && original < 0) {
+      error_ = std::current_exception();
+    }
+  }
+  if (bound) {
+    numa_.unbind();
+  }
+
+  boost::lock_guard<Executor> guard(*this);
+  launching_.erase(boost::this_thread::get_id());
+  if (pid <= 0) {
+    removeCgroup(id);
+  }
+  if (pid == 0) {
+    // finished in a previous run
+    tasks_[id].cached = true;
+    tasks_[id].end_ts = getUs();
+    releaseTask(id);
+    finishTask(id, 0);
+    dispatch();
+    cond_.notify_all();
+    return;
+  }
+  if (pid > 0) {
+    // the task finishes in reapChildren(), check once here in 
+    // case the child exited before it was recorded
+    children_[pid] = id;
+    add_task_group(pid);
+    if (tasks_[id].skipped) {
+      // a task cancelled while it was starting
+      kill(-pid, SIGTERM);
+    }
+    reapChildren();
+    return;
+  }
+  tasks_[id].end_ts = getUs();
+  releaseTask(id);
+  finishTask(id, 1);
+  dispatch();
+  cond_.notify_all();
+}
+
+// ask the broker for the slots of a task, the processes of a task
+// are granted together and run on the hosts of the grant, must be
+// called with the lock held
+void Executor::requestSlots(int id) {
+  Task &task = tasks_[id];
+  Worker_ptr worker = task.stage->task(task.idx);
+  task.request = broker_->acquire_async(worker->num_process_,
+      worker->num_thread_, worker->memory_, estimateRuntime(task.stage),
+      [this, id](int grant, std::vector<std::string> hosts) {
+        post(boost::bind(&Executor::grantTask, this, id, grant, hosts));
+      });
+}
+
+// withdraw the request of a task waiting for its slots, the task
+// finishes as cancelled in grantTask(), must be called with the
+// lock held
+void Executor::cancelRequest(int id) {
+  if (tasks_[id].request >= 0 && broker_->cancel(tasks_[id].request)) {
+    post(boost::bind(&Executor::grantTask, this, id, -1, 
+          std::vector<std::string>()));
+  }
+}
+
+// start a task with the slots granted by the broker, a task that
+// was cancelled meanwhile gives them back, and one the broker has
+// refused fails rather than run outside of its accounting
+void Executor::grantTask(int id, int grant, std::vector<std::string> hosts) {
+  {
+    boost::lock_guard<Executor> guard(*this);
+    Task &task = tasks_[id];
+    task.request = -1;
+    if (task.skipped || stopping_ || grant < 0) {
+      if (grant >= 0) {
+        broker_->release(grant);
+      }
+      int ret = 0;
+      if (!task.skipped && !stopping_) {
+        LOG(ERROR) << "Slot broker refused task " << task.idx << " of "
+                   << task.stage->label();
+        if (!error_ && task.original < 0) {
+          error_ = std::make_exception_ptr(internalError(
+                "slot broker refused task " + 
+                std::to_string((long long)task.idx) + " of " + 
+                task.stage->label()));
+        }
+        ret = 1;
+      }
+      task.end_ts = getUs();
+      releaseTask(id);
+      finishTask(id, ret, ret == 0);
+      dispatch();
+      cond_.notify_all();
+      return;
+    }
+    task.grant = grant;
+    task.stage->task(task.idx)->setHosts(hosts);
+  }
+  runTask(id);
+}
+
+// longest wall time in seconds of the finished tasks of stages 
+// with the same label, in this run or a previous run of this 
+// executor, 0 if none has finished yet; must be called with the
+// lock held
+int Executor::estimateRuntime(Stage* stage) {
+  uint64_t wall_us = 0;
+  for (int i = 0; i < tasks_.size(); i++) {
+    Task &task = tasks_[i];
+    if (task.stage->label() != stage->label() || !task.start_ts || 
+        !task.end_ts || task.ret || task.cached || task.skipped) {
+      continue;
+    }
+    wall_us = std::max(wall_us, task.end_ts - task.start_ts);
+  }
+  for (int i = 0; i < report_["tasks"].size(); i++) {
+    Json::Value &record = report_["tasks"][i];
+    if (record["stage"].asString() == stage->label() && 
+        record["status"].asString() == "done") {
+      wall_us = std::max(wall_us, (uint64_t)record["wall_us"].asUInt64());
+    }
+  }
+  return (wall_us + 999999) / 1000000;
+}
+
+void Executor::waitChildren() {
+  sigchld_->async_wait([this](const boost::system::error_code &err, int sig) {
+      if (err) return;
+      // re-arm under the lock so stop() cannot miss a pending wait
+      boost::lock_guard<Executor> guard(*this);
+      reapChildren();
+      if (!stopping_) {
+        waitChildren();
+      }
+  });
+}
+
+// read the storage i/o counters of a process
+static void read_proc_io(pid_t pid, 
+    uint64_t &read_bytes, 
+    uint64_t &write_bytes) 
+{
+  std::ifstream fin("/proc/" + std::to_string((long long)pid) + "/io");
+  std::string key;
+  uint64_t value;
+  while (fin >> key >> value) {
+    if (key == "read_bytes:") read_bytes = value;
+    else if (key == "write_bytes:") write_bytes = value;
+  }
+}
+
+// collect exited children of this executor without touching 
+// processes started elsewhere, must be called with the lock held
+void Executor::reapChildren() {
+  std::map<pid_t, int>::iterator it = children_.begin();
+  while (it != children_.end()) {
+    siginfo_t info;
+    info.si_pid = 0;
+    if (waitid(P_PID, it->first, &info, WEXITED | WNOHANG | WNOWAIT) ||
+        info.si_pid != it->first) {
+      it++;
+      continue;
+    }
+    int id  = it->second;
+    Task &task = tasks_[id];
+
+    // the child is a zombie until wait4(), its i/o counters 
+    // still include all the children it has waited for
+    read_proc_io(it->first, task.read_bytes, task.write_bytes);
+
+    // before wait4(), after which the pid can be reused
+    remove_task_group(it->first);
+
+    int status = 0;
+    wait4(it->first, &status, 0, &task.usage);
+    task.end_ts = getUs();
+    removeCgroup(id);
+    closeOutput(id);
+
+    int ret = 0;
+    if (WIFEXITED(status)) {
+      ret = WEXITSTATUS(status);
+    }
+    else if (WIFSIGNALED(status)) {
+      ret = 128 + WTERMSIG(status);
+    }
+    children_.erase(it++);
+
+    if (task.spec_won) {
+      // killed after its split finished first, its outputs are
+      // only replaced now that it cannot write them anymore
+      ret = takeSplitOutputs(id) ? 0 : 1;
+    }
+    else if (task.fatal && ret == 0) {
+      ret = 1;
+    }
+    if (ret == 0 && task.original < 0 && ledger_) {
+      Worker_ptr worker = task.stage->task(task.idx);
+      ledger_->record(worker->getCommand(), 
+          worker->getInputs(), worker->getOutputs());
+    }
+    if (ret == 0 && task.host >= 0) {
+      // outputs of a remote task stay on the scratch of its host
+      std::vector<std::string> outputs = 
+          task.stage->task(task.idx)->getOutputs();
+      for (int i = 0; i < outputs.size(); i++) {
+        locations_[normalize_path(outputs[i])] = task.host;
+      }
+    }
+
+    if (ret && !task.skipped) {
+      task.stage->saveLog(task.idx, task.output);
+    }
+    task.output.clear();
+
+    releaseTask(id);
+    if (ret && retryTask(id, ret)) {
+      continue;
+    }
+    finishTask(id, ret, task.skipped);
+  }
+  dispatch();
+  cond_.notify_all();
+}
+
+// start cmd with bash in a new process group, with stdout and 
+// stderr sent through a pipe to the stage log if it is started 
+// by runTask(), otherwise written to log, or inherited if log is empty
+pid_t Executor::spawn(std::string cmd, std::string log) {
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawnattr_init(&attr);
+
+  int id = -1;
+  {
+    boost::lock_guard<Executor> guard(*this);
+    std::map<boost::thread::id, int>::iterator it = 
+        launching_.find(boost::this_thread::get_id());
+    if (it != launching_.end()) {
+      id = it->second;
+      // the shell moves itself to the cgroup of the task before 
+      // running cmd, so that every process of the task is limited
+      if (!tasks_[id].cgroup.empty()) {
+        cmd = "{ echo $$ > '" + tasks_[id].cgroup + 
+              "/cgroup.procs'; } 2>/dev/null\n" + cmd;
+      }
+    }
+  }
+
+  // close-on-exec keeps the pipe of this task out of tasks 
+  // started at the same time, so that it ends with the task
+  int fds[2] = {-1, -1};
+  if (id >= 0 && !pipe2(fds, O_CLOEXEC)) {
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+  }
+  else if (!log.empty()) {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log.c_str(),
+        O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+  }
+
+  sigset_t sig_default;
+  sigset_t sig_mask;
+  sigemptyset(&sig_default);
+  sigaddset(&sig_default, SIGINT);
+  sigaddset(&sig_default, SIGCHLD);
+  sigaddset(&sig_default, SIGPIPE);
+  sigemptyset(&sig_mask);
+
+  posix_spawnattr_setpgroup(&attr, 0);
+  posix_spawnattr_setsigdefault(&attr, &sig_default);
+  posix_spawnattr_setsigmask(&attr, &sig_mask);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | 
+      POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+  const char* argv[] = {"/bin/bash", "-c", cmd.c_str(), NULL};
+
+  pid_t pid;
+  int err = posix_spawn(&pid, argv[0], &actions, &attr, 
+      const_cast<char* const*>(argv), environ);
+
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+
+  if (fds[1] >= 0) {
+    close(fds[1]);
+  }
+  if (err) {
+    if (fds[0] >= 0) close(fds[0]);
+    throw internalError("cannot start '" + cmd + "': " + strerror(err));
+  }
+  if (fds[0] >= 0) {
+    boost::shared_ptr<boost::asio::posix::stream_descriptor> pipe(
+        new boost::asio::posix::stream_descriptor(*ios_, fds[0]));
+    boost::system::error_code err;
+    pipe->non_blocking(true, err);
+    boost::lock_guard<Executor> guard(*this);
+    tasks_[id].output_pipe = pipe;
+    tasks_[id].partial.clear();
+    readOutput(id, pipe);
+  }
+  return pid;
+}
+
+// wait for output of a task and read it under the lock, so that 
+// closeOutput() does not miss a chunk being read, must be called 
+// with the lock held
+void Executor::readOutput(int id, 
+    boost::shared_ptr<boost::asio::posix::stream_descriptor> pipe) 
+{
+  pipe->async_read_some(boost::asio::null_buffers(), 
+      [this, id, pipe](const boost::system::error_code &err, size_t) {
+      if (err) return;
+      boost::lock_guard<Executor> guard(*this);
+      // the pipe is closed by closeOutput() once the task exits
+      if (id >= tasks_.size() || tasks_[id].output_pipe != pipe) return;
+      char buf[65536];
+      boost::system::error_code read_err;
+      size_t size = pipe->read_some(boost::asio::buffer(buf), read_err);
+      if (size > 0) {
+        appendOutput(id, buf, size);
+      }
+      if (!read_err || read_err == boost::asio::error::would_block) {
+        readOutput(id, pipe);
+      }
+  });
+}
+
+// write the complete lines of the output to the stage log and keep 
+// the tail of it in case the task fails, must be called with the lock held
+void Executor::appendOutput(int id, const char* data, size_t size) {
+  Task &task = tasks_[id];
+  task.partial.append(data, size);
+  size_t end = task.partial.rfind('\n');
+  if (end != std::string::npos) {
+    std::string lines = task.partial.substr(0, end + 1);
+    task.stage->write(task.idx, lines);
+    task.partial.erase(0, end + 1);
+
+    // stop a task as soon as it reports an error instead 
+    // of waiting for its other threads to finish
+    LogUtils logUtils;
+    if (fail_fast_ && !task.fatal && !task.skipped && 
+        logUtils.isFatalError(lines)) {
+      LOG(ERROR) << "Task " << task.idx << " of " << task.stage->label()
+                 << " reported an error, stopping it";
+      task.fatal = true;
+      killTask(id, SIGTERM);
+    }
+  }
+  task.output.append(data, size);
+  size_t limit = (size_t)get_config<int>("executor.output_buffer") << 10;
+  if (task.output.size() > limit) {
+    task.output.erase(0, task.output.size() - limit);
+  }
+}
+
+// read what is left in the pipe of an exited task, the processes 
+// it left behind cannot hold the task back, must be called with the lock held
+void Executor::closeOutput(int id) {
+  Task &task = tasks_[id];
+  if (!task.output_pipe) {
+    return;
+  }
+  boost::system::error_code err;
+  char buf[65536];
+  size_t size;
+  while (!err && (size = task.output_pipe->read_some(
+          boost::asio::buffer(buf), err)) > 0) {
+    appendOutput(id, buf, size);
+  }
+  if (!task.partial.empty()) {
+    task.stage->write(task.idx, task.partial + "\n");
+    task.partial.clear();
+  }
+  task.output_pipe->close(err);
+  task.output_pipe.reset();
+}
+
+// return the slot and resources of a task that stopped running
+void Executor::releaseTask(int id) {
+  num_running_--;
+  cores_used_  -= tasks_[id].cores;
+  memory_used_ -= tasks_[id].memory;
+  free_slots_.insert(tasks_[id].slot);
+  if (tasks_[id].grant >= 0) {
+    broker_->release(tasks_[id].grant);
+    tasks_[id].grant = -1;
+  }
+  if (tasks_[id].host >= 0) {
+    host_tasks_[tasks_[id].host]--;
+    tasks_[id].host = -1;
+  }
+}
+
+// release the children of a finished task, children of a failed 
+// task are skipped, must be called with the lock held
+void Executor::finishTask(int id, int ret, bool skipped) {
+  if (tasks_[id].original >= 0) {
+    finishSpeculation(id, ret);
+    return;
+  }
+  if (!tasks_[id].spec_tasks.empty() && !tasks_[id].spec_won) {
+    // the original finished first
+    cancelSpeculation(id);
+  }
+  Task &task = tasks_[id];
+  task.ret = ret;
+  num_finished_++;
+  if (task.stage->finish(task.idx, ret, skipped)) {
+    finished_stages_.push_back(task.stage);
+  }
+  if (ret && !skipped && fail_fast_ && !cancelled_) {
+    LOG(ERROR) << "Task " << task.idx << " of " << task.stage->label()
+               << " failed, cancelling the remaining tasks";
+    cancelTasks();
+  }
+  for (int i = 0; i < task.children.size(); i++) {
+    Task &child = tasks_[task.children[i]];
+    if (ret || skipped) child.skipped = true;
+    if (--child.num_deps == 0) {
+      if (child.skipped) {
+        finishTask(task.children[i], 0, true);
+      }
+      else {
+        child.ready_ts = getUs();
+        ready_.insert(task.children[i]);
+      }
+    }
+  }
+}
+
+// start a failed task again if its log shows that it ran out of
+// memory or hit a transient error, a task out of memory gets twice
+// the heap within the node budget, which also leaves less room for
+// others, must be called with the lock held
+bool Executor::retryTask(int id, int ret) {
+  Task &task = tasks_[id];
+  if (stopping_ || cancelled_ || task.original >= 0 || 
+      !task.spec_tasks.empty() ||
+      task.attempts >= get_config<int>("executor.max_retries")) {
+    return false;
+  }
+  Worker_ptr worker = task.stage->task(task.idx);
+  std::string log = task.stage->log(task.idx);
+  LogUtils logUtils;
+
+  int delay = 0;
+  if (ret == 128 + SIGKILL || logUtils.findOutOfMemory(log)) {
+    int max_memory = memory_budget_ / std::max(worker->num_process_, 1);
+    int memory = std::min(worker->memory_ * 2, max_memory);
+    if (memory <= worker->memory_) {
+      return false;
+    }
+    LOG(WARNING) << "Task " << task.idx << " of " << task.stage->label()
+                 << " ran out of memory, starting it again with "
+                 << memory << "GB";
+    worker->memory_ = memory;
+    if (task.memory) {
+      task.memory = worker->num_process_ * memory;
+    }
+  }
+  else if (logUtils.findTransientError(log)) {
+    delay = get_config<int>("executor.retry_delay") << task.attempts;
+    LOG(WARNING) << "Task " << task.idx << " of " << task.stage->label()
+                 << " failed with error code " << ret
+                 << ", starting it again in " << delay << "s";
+  }
+  else {
+    return false;
+  }
+  task.attempts++;
+  task.fatal = false;
+  task.start_ts = 0;
+  task.end_ts = 0;
+
+  if (!delay) {
+    task.ready_ts = getUs();
+    ready_.insert(id);
+    return true;
+  }
+  boost::shared_ptr<boost::asio::deadline_timer> timer(
+      new boost::asio::deadline_timer(*ios_));
+  retry_timers_.insert(timer);
+  timer->expires_from_now(boost::posix_time::seconds(delay));
+  timer->async_wait([this, id, timer](const boost::system::error_code &err) {
+      boost::lock_guard<Executor> guard(*this);
+      retry_timers_.erase(timer);
+      if (err || stopping_) return;
+      tasks_[id].ready_ts = getUs();
+      ready_.insert(id);
+      dispatch();
+  });
+  return true;
+}
+
+// create the cgroup leaf of a task with limits from its declared
+// cores and memory, spawn() moves the task into it
+void Executor::createCgroup(int id) {
+  int cores;
+  int memory;
+  std::string cgroup;
+  {
+    boost::lock_guard<Executor> guard(*this);
+    cores  = tasks_[id].cores;
+    memory = tasks_[id].memory;
+    cgroup = cgroup_dir_ + "/task-" + std::to_string((long long)id);
+    tasks_[id].cgroup = cgroup;
+  }
+  if (mkdir(cgroup.c_str(), 0755) && errno != EEXIST) {
+    DLOG(WARNING) << "Cannot create cgroup " << cgroup 
+                  << ": " << strerror(errno);
+    boost::lock_guard<Executor> guard(*this);
+    tasks_[id].cgroup.clear();
+    return;
+  }
+  if (memory > 0) {
+    // a JVM uses memory beyond its heap, throttle the task halfway 
+    // into the margin and kill all of it at the end
+    uint64_t bytes  = (uint64_t)memory << 30;
+    uint64_t margin = get_config<int>("executor.cgroup_margin");
+    write_cgroup(cgroup, "memory.high", 
+        std::to_string((unsigned long long)(bytes * (200 + margin) / 200)));
+    write_cgroup(cgroup, "memory.max", 
+        std::to_string((unsigned long long)(bytes * (100 + margin) / 100)));
+    write_cgroup(cgroup, "memory.oom.group", "1");
+  }
+  if (cores > 0) {
+    write_cgroup(cgroup, "cpu.max", 
+        std::to_string((long long)cores * 100000) + " 100000");
+  }
+}
+
+// collect the usage of a task from its cgroup and remove it, 
+// must be called with the lock held
+void Executor::removeCgroup(int id) {
+  Task &task = tasks_[id];
+  if (task.cgroup.empty()) {
+    return;
+  }
+  task.memory_peak  = read_cgroup(task.cgroup, "memory.peak");
+  task.throttled_us = read_cgroup(task.cgroup, "cpu.stat", "throttled_usec");
+  if (read_cgroup(task.cgroup, "memory.events", "oom_kill")) {
+    LOG(WARNING) << "Task " << task.idx << " of " << task.stage->label()
+                 << " was killed at its cgroup memory limit";
+  }
+  // processes left behind by the task would keep the cgroup busy
+  write_cgroup(task.cgroup, "cgroup.kill", "1");
+  rmdir(task.cgroup.c_str());
+  task.cgroup.clear();
+}
+
+// skip all tasks that have not finished and stop the running 
+// ones, must be called with the lock held
+void Executor::cancelTasks() {
+  cancelled_ = true;
+  for (int i = 0; i < tasks_.size(); i++) {
+    if (!tasks_[i].end_ts) {
+      tasks_[i].skipped = true;
+      cancelRequest(i);
+    }
+  }
+  for (std::map<pid_t, int>::iterator it = children_.begin();
+       it != children_.end(); it++) {
+    kill(-it->first, SIGTERM);
+  }
+}
+
+void Executor::watchStragglers() {
+  straggler_timer_->expires_from_now(boost::posix_time::seconds(1));
+  straggler_timer_->async_wait([this](const boost::system::error_code &err) {
+      boost::lock_guard<Executor> guard(*this);
+      watching_ = false;
+      if (err || stopping_) return;
+      speculate();
+      dispatch();
+  });
+}
+
+// split running tasks that take much longer than the finished 
+// tasks of their stage, the split tasks run on the idle slots 
+// next to the original, must be called with the lock held
+void Executor::speculate() {
+  int ratio    = get_config<int>("executor.speculation");
+  int num_idle = num_executors_ - num_running_;
+  if (ratio <= 0 || !ready_.empty() || num_idle < 2) {
+    return;
+  }
+  uint64_t now = getUs();
+  int num_tasks = tasks_.size();
+  for (int id = 0; id < num_tasks && num_idle >= 2; id++) {
+    // a task waiting for the broker is not straggling
+    if (tasks_[id].original >= 0 || tasks_[id].speculated ||
+        !tasks_[id].start_ts || tasks_[id].end_ts || 
+        tasks_[id].request >= 0) {
+      continue;
+    }
+    Stage* stage = tasks_[id].stage;
+
+    // the median is only meaningful once most of the stage is done
+    std::vector<uint64_t> times;
+    int stage_size = 0;
+    for (int i = 0; i < num_tasks; i++) {
+      Task &task = tasks_[i];
+      if (task.stage != stage) continue;
+      stage_size++;
+      if (task.end_ts && !task.ret && !task.cached && !task.spec_won) {
+        times.push_back(task.end_ts - task.start_ts);
+      }
+    }
+    if (times.size() < 2 || times.size() * 2 < stage_size) {
+      continue;
+    }
+    std::nth_element(times.begin(), times.begin() + times.size()/2, times.end());
+    uint64_t median = times[times.size()/2];
+    if ((now - tasks_[id].start_ts) * 100 <= median * ratio) {
+      continue;
+    }
+
+    tasks_[id].speculated = true;
+    Worker_ptr worker = stage->task(tasks_[id].idx);
+    std::vector<Worker_ptr> parts;
+    Worker_ptr merge;
+    try {
+      if (!worker->split(num_idle, parts, merge)) continue;
+    }
+    catch (std::runtime_error &e) {
+      DLOG(WARNING) << "Cannot split " << worker->getTaskName() 
+                    << ", because: " << e.what();
+      continue;
+    }
+    LOG(INFO) << "Task " << tasks_[id].idx << " of " << stage->label()
+              << " is straggling, running it as " << parts.size() 
+              << " parts on idle slots";
+
+    Stage_ptr spec_stage(new Stage(this, 
+          "Split " + stage->label(), stage->sample_id(), true));
+    job_stages_.push_back(spec_stage);
+
+    std::vector<int> part_ids;
+    for (int i = 0; i < parts.size(); i++) {
+      int part_id = newTask(spec_stage.get(), parts[i]);
+      tasks_[part_id].original = id;
+      tasks_[part_id].ready_ts = now;
+      ready_.insert(part_id);
+      part_ids.push_back(part_id);
+    }
+    int merge_id = newTask(spec_stage.get(), merge);
+    tasks_[merge_id].original = id;
+    tasks_[merge_id].num_deps = part_ids.size();
+    for (int i = 0; i < part_ids.size(); i++) {
+      tasks_[part_ids[i]].children.push_back(merge_id);
+    }
+    part_ids.push_back(merge_id);
+    tasks_[id].spec_tasks = part_ids;
+
+    num_idle -= parts.size();
+  }
+}
+
+// record a split task, the merge task finishing before the 
+// original stops it to take its place, must be called with the lock held
+void Executor::finishSpeculation(int id, int ret) {
+  Task &task = tasks_[id];
+  task.ret = ret;
+  num_finished_++;
+
+  int  orig_id   = task.original;
+  bool cancelled = task.skipped;
+  bool is_merge  = id == tasks_[orig_id].spec_tasks.back();
+  if (task.stage->finish(task.idx, ret, cancelled)) {
+    finished_stages_.push_back(task.stage);
+  }
+  for (int i = 0; i < task.children.size(); i++) {
+    int child_id = task.children[i];
+    Task &child = tasks_[child_id];
+    if (ret || cancelled) child.skipped = true;
+    if (--child.num_deps == 0) {
+      if (child.skipped) {
+        finishSpeculation(child_id, 0);
+      }
+      else {
+        child.ready_ts = getUs();
+        ready_.insert(child_id);
+      }
+    }
+  }
+  if (cancelled) {
+    return;
+  }
+  if (ret) {
+    DLOG(WARNING) << "Split task " << task.idx << " of " 
+                  << task.stage->label() << " failed with error code " << ret;
+    cancelSpeculation(orig_id);
+    return;
+  }
+  if (!is_merge) {
+    return;
+  }
+
+  // the original is still running, otherwise this would be cancelled;
+  // reapChildren() moves the merged outputs once it is gone
+  Task &orig = tasks_[orig_id];
+  LOG(INFO) << "Split of task " << orig.idx << " of " << orig.stage->label()
+            << " finished first";
+  orig.spec_won = true;
+  killTask(orig_id, SIGTERM);
+}
+
+// index files next to an output, named after it with their
+// extension added, or for a bam index also in place of its own
+static std::vector<std::string> index_paths(std::string path) {
+  const char* exts[] = {".idx", ".tbi", ".csi", ".bai"};
+  std::vector<std::string> paths;
+  for (int i = 0; i < sizeof(exts) / sizeof(exts[0]); i++) {
+    paths.push_back(path + exts[i]);
+  }
+  paths.push_back(boost::filesystem::path(path).replace_extension(".bai").string());
+  return paths;
+}
+
+// replace the outputs of a task killed by its split with the 
+// outputs of the merge task and their indexes, return false if 
+// any of them cannot be moved, must be called with the lock held
+bool Executor::takeSplitOutputs(int id) {
+  namespace fs = boost::filesystem;
+  Task &orig  = tasks_[id];
+  Task &merge = tasks_[orig.spec_tasks.back()];
+  std::vector<std::string> outputs = orig.stage->task(orig.idx)->getOutputs();
+  std::vector<std::string> merged  = merge.stage->task(merge.idx)->getOutputs();
+  for (int i = 0; i < outputs.size() && i < merged.size(); i++) {
+    std::vector<std::string> from = index_paths(merged[i]);
+    std::vector<std::string> to   = index_paths(outputs[i]);
+    boost::system::error_code err;
+    // indexes left by the original do not match the merged output
+    for (int k = 0; k < to.size(); k++) {
+      fs::remove(to[k], err);
+    }
+    fs::rename(merged[i], outputs[i], err);
+    for (int k = 0; !err && k < from.size(); k++) {
+      if (fs::exists(from[k])) {
+        fs::rename(from[k], to[k], err);
+      }
+    }
+    if (err) {
+      LOG(ERROR) << "Cannot move " << merged[i] << " to " << outputs[i]
+                 << ": " << err.message();
+      return false;
+    }
+  }
+  return true;
+}
+
+// stop the split tasks of a task that are still waiting or 
+// running, must be called with the lock held
+void Executor::cancelSpeculation(int id) {
+  std::vector<int> spec_tasks = tasks_[id].spec_tasks;
+  for (int i = 0; i < spec_tasks.size(); i++) {
+    int spec_id = spec_tasks[i];
+    // a finished split task keeps its own status
+    if (tasks_[spec_id].skipped || tasks_[spec_id].end_ts) continue;
+    tasks_[spec_id].skipped = true;
+    if (ready_.erase(spec_id)) {
+      finishSpeculation(spec_id, 0);
+    }
+    else {
+      // tasks waiting for their parts finish with the last part
+      killTask(spec_id, SIGTERM);
+    }
+  }
+}
+
+void Executor::killTask(int id, int sig) {
+  cancelRequest(id);
+  for (std::map<pid_t, int>::iterator it = children_.begin();
+       it != children_.end(); it++) {
+    if (it->second == id) {
+      kill(-it->first, sig);
+    }
   }
-  job_stages_.back()->add(worker);
 }
 
 void Executor::run() {
   uint64_t start_ts = getTs();
-  while (!job_stages_.empty()) {    
-    job_stages_.front()->run();
-    job_stages_.pop();
+  bool failed = false;
+
+  // the archives are dumped once here, so that tasks only look
+  // them up when they start
+  if (!tasks_.empty()) {
+    dump_class_archives();
+  }
+
+  boost::unique_lock<Executor> lock(*this);
+  for (int i = 0; i < tasks_.size(); i++) {
+    if (tasks_[i].num_deps == 0) {
+      tasks_[i].ready_ts = getUs();
+      ready_.insert(i);
+    }
+  }
+  dispatch();
+
+  while (num_finished_ < tasks_.size() || !finished_stages_.empty()) {
+    if (checkTask(lock) >= 0) {
+      continue;
+    }
+    if (finished_stages_.empty()) {
+      cond_.wait(lock);
+      continue;
+    }
+    Stage* stage = finished_stages_.front();
+    finished_stages_.erase(finished_stages_.begin());
+
+    // concat logs and check errors without blocking the workers
+    lock.unlock();
+    try {
+      stage->report();
+    }
+    catch (failedCommand &e) {
+      failed = true;
+    }
+    lock.lock();
+  }
+
+  writeReport();
+  if (get_config<bool>("executor.trace")) {
+    writeTrace();
+  }
+
+  // reset the graph so that new tasks can be added 
+  std::exception_ptr error = error_;
+  error_ = std::exception_ptr();
+  tasks_.clear();
+  ready_.clear();
+  readers_.clear();
+  writers_.clear();
+  barrier_.clear();
+  fence_.clear();
+  next_fence_.clear();
+  num_finished_ = 0;
+  cancelled_ = false;
+  job_stages_.clear();
+  lock.unlock();
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  if (failed) {
+    throw failedCommand("");
+  }
+}
+
+// check a ready task on the thread of run(), as the checks may
+// ask the user whether to overwrite outputs, a task whose check
+// fails is failed without starting; returns the task checked or
+// -1 if every ready task is checked, must be called with the lock held
+int Executor::checkTask(boost::unique_lock<Executor> &lock) {
+  int id = -1;
+  for (std::set<int>::iterator it = ready_.begin(); 
+       it != ready_.end(); it++) {
+    if (!tasks_[*it].checked) {
+      id = *it;
+      break;
+    }
+  }
+  if (id < 0) {
+    return -1;
+  }
+  Worker_ptr worker = tasks_[id].stage->task(tasks_[id].idx);
+
+  std::exception_ptr error;
+  bool exiting = false;
+  lock.unlock();
+  try {
+    worker->check();
+  }
+  catch (silentExit &e) {
+    error = std::current_exception();
+    exiting = true;
+  }
+  catch (...) {
+    error = std::current_exception();
+  }
+  lock.lock();
+
+  // the task may have been cancelled meanwhile
+  tasks_[id].checked = true;
+  if (!ready_.count(id)) {
+    return id;
+  }
+  if (error) {
+    if (!error_ && tasks_[id].original < 0) {
+      error_ = error;
+    }
+    ready_.erase(id);
+    tasks_[id].end_ts = getUs();
+    finishTask(id, 1);
+
+    // the user chose not to go on
+    if (exiting && !cancelled_) {
+      cancelTasks();
+    }
+  }
+  dispatch();
+  return id;
+}
+
+// a field of the csv report, quoted if it has a separator, a quote
+// or a line break, with its quotes doubled
+static std::string csv_field(std::string field) {
+  if (field.find_first_of(",\"\r\n") == std::string::npos) {
+    return field;
+  }
+  std::string quoted = "\"";
+  for (int i = 0; i < field.size(); i++) {
+    if (field[i] == '"') quoted += '"';
+    quoted += field[i];
+  }
+  return quoted + "\"";
+}
+
+static inline uint64_t get_us(struct timeval tv) {
+  return (uint64_t)tv.tv_sec*1000000 + tv.tv_usec;
+}
+
+std::string Executor::taskStatus(const Task &task) {
+  if (task.skipped) {
+    return task.original < 0 ? "skipped" : "cancelled";
+  }
+  else if (task.spec_won) {
+    return "split";
+  }
+  else if (task.cached) {
+    return "cached";
+  }
+  else {
+    return task.ret ? "failed" : "done";
+  }
+}
+
+// add the tasks of this run to the report and write it as json 
+// and csv next to the executor log, must be called with the lock held
+void Executor::writeReport() {
+  const char* columns[] = {"stage", "task", "status", "exit_code", 
+    "cores", "memory_gb", "queue_us", "wall_us", "user_us", "sys_us", 
+    "max_rss_kb", "read_bytes", "write_bytes", "attempts", 
+    "memory_peak_kb", "throttled_us"};
+  const int num_columns = sizeof(columns) / sizeof(columns[0]);
+
+  report_["job"] = job_name_;
+  for (int i = 0; i < tasks_.size(); i++) {
+    Task &task = tasks_[i];
+    Json::Value record;
+    record["stage"] = task.stage->label();
+    record["task"]  = task.idx;
+    record["status"] = taskStatus(task);
+    record["exit_code"]   = task.ret;
+    record["cores"]       = task.cores;
+    record["memory_gb"]   = task.memory;
+    record["queue_us"]    = (Json::UInt64)(task.start_ts ? 
+                            task.start_ts - task.ready_ts : 0);
+    record["wall_us"]     = (Json::UInt64)(task.start_ts ? 
+                            task.end_ts - task.start_ts : 0);
+    record["user_us"]     = (Json::UInt64)get_us(task.usage.ru_utime);
+    record["sys_us"]      = (Json::UInt64)get_us(task.usage.ru_stime);
+    record["max_rss_kb"]  = (Json::Int64)task.usage.ru_maxrss;
+    record["read_bytes"]  = (Json::UInt64)task.read_bytes;
+    record["write_bytes"] = (Json::UInt64)task.write_bytes;
+    record["attempts"]    = task.attempts + 1;
+    record["memory_peak_kb"] = (Json::UInt64)(task.memory_peak >> 10);
+    record["throttled_us"]   = (Json::UInt64)task.throttled_us;
+    report_["tasks"].append(record);
+  }
+
+  boost::filesystem::path report_path(log_fname_);
+  std::string json_fname = report_path.replace_extension(".json").string();
+  std::string csv_fname  = report_path.replace_extension(".csv").string();
+
+  std::ofstream json_out(json_fname);
+  json_out << report_;
+  json_out.close();
+
+  std::ofstream csv_out(csv_fname);
+  for (int k = 0; k < num_columns; k++) {
+    csv_out << (k ? "," : "") << columns[k];
+  }
+  csv_out << std::endl;
+  for (int i = 0; i < report_["tasks"].size(); i++) {
+    Json::Value &record = report_["tasks"][i];
+    for (int k = 0; k < num_columns; k++) {
+      csv_out << (k ? "," : "") << csv_field(record[columns[k]].asString());
+    }
+    csv_out << std::endl;
+  }
+  csv_out.close();
+
+  DLOG(INFO) << "Task report is written to " << json_fname;
+}
+
+static Json::Value trace_event(std::string name, std::string phase, 
+    int pid, int tid) 
+{
+  Json::Value event;
+  event["name"] = name;
+  event["ph"]   = phase;
+  event["pid"]  = pid;
+  event["tid"]  = tid;
+  return event;
+}
+
+// add the tasks of this run to a trace in the chrome trace event 
+// format, which chrome://tracing and perfetto can load; track 0 
+// shows the stages and track i+1 shows executor slot i, must be 
+// called with the lock held
+void Executor::writeTrace() {
+  int pid = getpid();
+
+  if (trace_["traceEvents"].empty()) {
+    Json::Value event = trace_event("process_name", "M", pid, 0);
+    event["args"]["name"] = job_name_;
+    trace_["traceEvents"].append(event);
+
+    event = trace_event("thread_name", "M", pid, 0);
+    event["args"]["name"] = "stages";
+    trace_["traceEvents"].append(event);
+
+    for (int t = 0; t < num_executors_; t++) {
+      event = trace_event("thread_name", "M", pid, t + 1);
+      event["args"]["name"] = "slot " + std::to_string((long long)t);
+      trace_["traceEvents"].append(event);
+    }
+  }
+
+  std::map<Stage*, std::pair<uint64_t, uint64_t> > stage_spans;
+  for (int i = 0; i < tasks_.size(); i++) {
+    Task &task = tasks_[i];
+    if (!task.start_ts) continue;
+
+    Json::Value event = trace_event(
+        task.stage->task(task.idx)->getTaskName(), "X", pid, task.slot + 1);
+    event["cat"] = "task";
+    event["ts"]  = (Json::UInt64)task.start_ts;
+    event["dur"] = (Json::UInt64)(task.end_ts - task.start_ts);
+    event["args"]["stage"]     = task.stage->label();
+    event["args"]["sample_id"] = task.stage->sample_id();
+    event["args"]["index"]     = task.idx;
+    event["args"]["exit_code"] = task.ret;
+    event["args"]["status"]    = taskStatus(task);
+    event["args"]["queue_us"]  = (Json::UInt64)(task.start_ts - task.ready_ts);
+    trace_["traceEvents"].append(event);
+
+    if (!stage_spans.count(task.stage)) {
+      stage_spans[task.stage] = std::make_pair(task.start_ts, task.end_ts);
+    }
+    std::pair<uint64_t, uint64_t> &span = stage_spans[task.stage];
+    span.first  = std::min(span.first, task.start_ts);
+    span.second = std::max(span.second, task.end_ts);
+  }
+
+  // stages overlap once tasks only wait for their own inputs,
+  // so use async events that may nest on the same track
+  for (int i = 0; i < job_stages_.size(); i++) {
+    Stage* stage = job_stages_[i].get();
+    if (!stage_spans.count(stage)) continue;
+
+    Json::Value begin = trace_event(stage->label(), "b", pid, 0);
+    begin["cat"] = "stage";
+    begin["id"]  = (Json::UInt64)trace_["traceEvents"].size();
+    begin["ts"]  = (Json::UInt64)stage_spans[stage].first;
+
+    Json::Value end = begin;
+    end["ph"] = "e";
+    end["ts"] = (Json::UInt64)stage_spans[stage].second;
+
+    trace_["traceEvents"].append(begin);
+    trace_["traceEvents"].append(end);
   }
 
-  // TODO: produce executor log in a file
+  boost::filesystem::path trace_path(log_fname_);
+  std::string trace_fname = trace_path.replace_extension(".trace.json").string();
+
+  std::ofstream fout(trace_fname);
+  fout << trace_;
+  fout.close();
+
+  LOG(INFO) << "Execution trace is written to " << trace_fname;
 }
 
 void Executor::stop() {
+  {
+    boost::lock_guard<Executor> guard(*this);
+    stopping_ = true;
+    sigchld_->cancel();
+    straggler_timer_->cancel();
+    for (int i = 0; i < tasks_.size(); i++) {
+      cancelRequest(i);
+    }
+    for (std::set<boost::shared_ptr<boost::asio::deadline_timer> >::iterator 
+         it = retry_timers_.begin(); it != retry_timers_.end(); it++) {
+      (*it)->cancel();
+    }
+    // pipes held open by processes still running would keep 
+    // the executor threads waiting
+    for (int i = 0; i < tasks_.size(); i++) {
+      closeOutput(i);
+    }
+  }
   // finish existing jobs
   ios_work_.reset();
   executors_.join_all();
+
+  if (broker_renewer_.joinable()) {
+    broker_renewer_.interrupt();
+    broker_renewer_.join();
+  }
+}
+
+void Executor::renewSlots() {
+  int interval = std::max(broker_->lease() / 3, 1);
+  try {
+    while (true) {
+      boost::this_thread::sleep_for(boost::chrono::seconds(interval));
+      broker_->renew();
+    }
+  }
+  catch (boost::thread_interrupted &e) {
+    ;
+  }
 }
 
 void Executor::interrupt() {
@@ -217,7 +1805,119 @@ void Executor::interrupt() {
   executors_.join_all();
 }
 
-int Executor::execute(Worker_ptr worker, std::string log) {
+// host holding most of the inputs of a worker, -1 if none is 
+// known, must be called with the lock held
+int Executor::findLocalHost(Worker_ptr worker) {
+  namespace fs = boost::filesystem;
+  std::vector<std::string> inputs = worker->getInputs();
+  std::vector<int> num_inputs(conf_host_list.size(), 0);
+  for (int i = 0; i < inputs.size(); i++) {
+    // a file inside a partition dir is held by the host of the dir
+    for (fs::path p(normalize_path(inputs[i])); 
+         !p.empty() && p != p.root_path(); 
+         p = p.parent_path()) 
+    {
+      std::map<std::string, int>::iterator it = locations_.find(p.string());
+      if (it != locations_.end()) {
+        if (it->second < num_inputs.size()) {
+          num_inputs[it->second]++;
+        }
+        break;
+      }
+    }
+  }
+  int host = -1;
+  for (int i = 0; i < num_inputs.size(); i++) {
+    if (num_inputs[i] > 0 && 
+        (host < 0 || num_inputs[i] > num_inputs[host])) {
+      host = i;
+    }
+  }
+  return host;
+}
+
+// choose the host of a latency_mode task: the host holding its 
+// inputs unless it stays saturated for executor.locality_wait 
+// seconds, otherwise the least loaded agent, or the host running 
+// the fewest tasks of this executor
+int Executor::placeTask(Worker_ptr worker, int job_id, bool &use_agent) {
+  int num_hosts = conf_host_list.size();
+  bool agents = get_config<bool>("agent.enabled");
+  int agent_port = get_config<int>("agent.port");
+  std::string token;
+  if (agents) {
+    try {
+      token = Agent::readToken(get_config<std::string>("agent.token_file"));
+    }
+    catch (std::runtime_error &e) {
+      LOG(WARNING) << "Cannot use the agents, falling back to ssh: " 
+                   << e.what();
+      agents = false;
+    }
+  }
+
+  int host = -1;
+  {
+    boost::unique_lock<Executor> lock(*this);
+    if (host_tasks_.size() != num_hosts) {
+      host_tasks_.resize(num_hosts, 0);
+    }
+    int local = findLocalHost(worker);
+    if (local >= 0) {
+      // slots of this executor are shared evenly by the hosts
+      int capacity = (num_executors_ + num_hosts - 1) / num_hosts;
+      boost::chrono::steady_clock::time_point deadline = 
+          boost::chrono::steady_clock::now() + 
+          boost::chrono::seconds(get_config<int>("executor.locality_wait"));
+      while (host_tasks_[local] >= capacity && !cancelled_ &&
+             cond_.wait_until(lock, deadline) != boost::cv_status::timeout) ;
+
+      if (host_tasks_[local] < capacity) {
+        host = local;
+      }
+      else {
+        DLOG(INFO) << conf_host_list[local] << " is saturated, sending "
+                   << worker->getTaskName() << " to another host";
+      }
+    }
+  }
+
+  use_agent = false;
+  if (agents) {
+    if (host >= 0) {
+      // check the agent is still there
+      std::vector<std::string> local(1, conf_host_list[host]);
+      use_agent = Agent::findLeastLoaded(local, agent_port, token) == 0;
+    }
+    else {
+      host = Agent::findLeastLoaded(conf_host_list, agent_port, token);
+      use_agent = host >= 0;
+    }
+    if (!use_agent) {
+      LOG(WARNING) << "No agent is reachable, falling back to ssh";
+    }
+  }
+
+  boost::lock_guard<Executor> guard(*this);
+  if (host < 0) {
+    // fewest running tasks, in turn among equally loaded hosts
+    for (int i = 0; i < num_hosts; i++) {
+      int h = (job_id + i) % num_hosts;
+      if (host < 0 || host_tasks_[h] < host_tasks_[host]) {
+        host = h;
+      }
+    }
+  }
+  std::map<boost::thread::id, int>::iterator it = 
+      launching_.find(boost::this_thread::get_id());
+  if (it != launching_.end()) {
+    tasks_[it->second].host = host;
+    host_tasks_[host]++;
+  }
+  return host;
+}
+
+pid_t Executor::execute(Worker_ptr worker, std::string log) {
 
   int job_id = job_id_.fetch_add(1);
 
@@ -225,6 +1925,17 @@ int Executor::execute(Worker_ptr worker, std::string log) {
   try {
     worker->setup();
 
+    if (ledger_) {
+      boost::lock_guard<Executor> guard(*this);
+      if (ledger_->check(worker->getCommand(), 
+            worker->getInputs(), worker->getOutputs())) {
+        LOG(INFO) << "Skipping " << worker->getTaskName() 
+                  << " finished in a previous run";
+        DLOG(INFO) << worker->getCommand();
+        return 0;
+      }
+    }
+
     std::string cmd;
 
     // launch system calls through ssh if using latency mode
@@ -238,19 +1949,29 @@ int Executor::execute(Worker_ptr worker, std::string log) {
         ".sh";
       std::string pid_file = script_file + ".pid";
 
+      DLOG(INFO) << worker->getCommand();
+
+      // a running agent tracks and kills the task itself
+      bool use_agent = false;
+      int host_id = placeTask(worker, job_id, use_agent);
+      std::string host = conf_host_list[host_id];
+
       // generate a script the record the process id
       std::stringstream cmd_sh;
-      cmd_sh << worker->getCommand()
-        << " 2> " << log
-        << " &" << std::endl;
-      cmd_sh << "pid=$!" << std::endl;
-      cmd_sh << "echo $pid > " << pid_file << std::endl;
-      cmd_sh << "wait \"$pid\"" << std::endl;
-      cmd_sh << "ret=$?" << std::endl;
-      cmd_sh << "rm -f " << pid_file << std::endl;
-      cmd_sh << "exit $ret" << std::endl;
-
-      DLOG(INFO) << worker->getCommand();
+      if (use_agent) {
+        cmd_sh << worker->getCommand() << std::endl;
+      }
+      else {
+        // the output comes back through ssh
+        cmd_sh << worker->getCommand()
+          << " &" << std::endl;
+        cmd_sh << "pid=$!" << std::endl;
+        cmd_sh << "echo $pid > " << pid_file << std::endl;
+        cmd_sh << "wait \"$pid\"" << std::endl;
+        cmd_sh << "ret=$?" << std::endl;
+        cmd_sh << "rm -f " << pid_file << std::endl;
+        cmd_sh << "exit $ret" << std::endl;
+      }
 
       // write the script to file
       std::ofstream fout;
@@ -258,26 +1979,33 @@ int Executor::execute(Worker_ptr worker, std::string log) {
       fout << cmd_sh.rdbuf();
       fout.close();
 
-      // obtain host name from host_list
-      int host_id = job_id % conf_host_list.size();
-      std::string host = conf_host_list[host_id];
-
-      cmd = "ssh -q " + host + " '/bin/bash -s' < " +
-        script_file;
+      if (use_agent) {
+        // the local client streams the output back and turns
+        // a signal into a kill of the remote task
+        cmd = conf_bin_dir + "/fcs-genome agent --submit " + host +
+          " --port " + std::to_string((long long)get_config<int>("agent.port")) +
+          " --token-file " + get_config<std::string>("agent.token_file") +
+          " --cores " + std::to_string((long long)worker->num_thread_) +
+          " --memory " + std::to_string((long long)worker->memory_) +
+          " < " + script_file;
+      }
+      else {
+        cmd = "ssh -q " + host + " '/bin/bash -s' < " +
+          script_file;
+      }
     }
     else {
-      cmd = worker->getCommand() + " &> " + log;
-      DLOG(INFO) << cmd;
+      cmd = worker->getCommand();
+      DLOG(INFO) << cmd << " &> " << log;
     }
 
     signal(SIGINT, sigint_handler);
 
-    // fork command
-    return system(cmd.c_str());
+    return spawn(cmd, log);
   } 
   catch (std::runtime_error &e) {
     DLOG(ERROR) << "Failed to setup job execution, because: " << e.what();
-    return 1;
+    return -1;
   }
 }
 
@@ -0,0 +1,610 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "fcs-genome/ClassArchive.h"
+#include "fcs-genome/common.h"
+#include "fcs-genome/config.h"
+#include "fcs-genome/JvmPool.h"
+
+extern char **environ;
+
+namespace fcsgenome {
+
+using boost::asio::local::stream_protocol;
+
+// ends the output of a task on the stdout of the runner
+static const std::string exit_marker = "\001fcs-exit ";
+
+// write one message, without SIGPIPE if the peer is gone
+static bool send_line(int fd, Json::Value msg) {
+  Json::FastWriter writer;
+  std::string line = writer.write(msg);
+  const char* ptr = line.c_str();
+  size_t left = line.size();
+  while (left > 0) {
+    ssize_t n = ::send(fd, ptr, left, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    ptr += n;
+    left -= n;
+  }
+  return true;
+}
+
+static bool read_line(stream_protocol::socket &sock,
+    boost::asio::streambuf &buf, Json::Value &msg)
+{
+  boost::system::error_code err;
+  boost::asio::read_until(sock, buf, '\n', err);
+  if (err && !buf.size()) {
+    return false;
+  }
+  std::istream is(&buf);
+  std::string line;
+  std::getline(is, line);
+  Json::Reader reader;
+  return reader.parse(line, msg);
+}
+
+// a socket left by a previous process cannot be bound again
+static std::string unlinked(std::string path) {
+  ::unlink(path.c_str());
+  return path;
+}
+
+JvmPool::JvmPool(std::string path, std::string java, std::string runner,
+    int size, int reuse):
+  path_(path),
+  java_(java),
+  runner_(runner),
+  size_(size),
+  reuse_(reuse),
+  acceptor_(ios_, stream_protocol::endpoint(unlinked(path))),
+  num_busy_(0),
+  num_conns_(0),
+  stopped_(false)
+{
+  // keep the sockets out of the jvms and the tasks
+  ::fcntl(acceptor_.native_handle(), F_SETFD, FD_CLOEXEC);
+}
+
+JvmPool::~JvmPool() {
+  stop();
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  // connections still being served refer to this object
+  while (num_conns_ > 0) {
+    cond_.wait(lock);
+  }
+  for (int i = 0; i < idle_.size(); i++) {
+    terminate(idle_[i]);
+  }
+  idle_.clear();
+  ::unlink(path_.c_str());
+}
+
+void JvmPool::run() {
+  while (true) {
+    socket* sock = new socket(ios_);
+    boost::system::error_code err;
+    acceptor_.accept(*sock, err);
+    if (stopped_) {
+      delete sock;
+      break;
+    }
+    if (err) {
+      LOG(WARNING) << "Failed to accept connection: " << err.message();
+      delete sock;
+      continue;
+    }
+    ::fcntl(sock->native_handle(), F_SETFD, FD_CLOEXEC);
+    {
+      boost::lock_guard<boost::mutex> guard(mutex_);
+      num_conns_++;
+    }
+    boost::thread(boost::bind(&JvmPool::serve, this, sock)).detach();
+  }
+}
+
+void JvmPool::stop() {
+  if (stopped_) {
+    return;
+  }
+  stopped_ = true;
+  // shutdown wakes up a thread blocked in accept()
+  ::shutdown(acceptor_.native_handle(), SHUT_RDWR);
+  boost::system::error_code err;
+  acceptor_.close(err);
+}
+
+// the socket is owned here rather than by the thread, so that
+// it is closed before the pool can be destroyed
+void JvmPool::serve(socket* raw) {
+  {
+    socket_ptr sock(raw);
+    handle(sock);
+  }
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  num_conns_--;
+  cond_.notify_all();
+}
+
+void JvmPool::handle(socket_ptr sock) {
+  boost::asio::streambuf buf;
+  Json::Value req;
+  if (!read_line(*sock, buf, req)) {
+    return;
+  }
+  int fd = sock->native_handle();
+  std::string jar = req["jar"].asString();
+  int memory = req.get("memory", 0).asInt();
+  std::string opts = req.get("opts", "").asString();
+  std::vector<std::string> args;
+  for (int i = 0; i < req["args"].size(); i++) {
+    args.push_back(req["args"][i].asString());
+  }
+
+  Jvm jvm;
+  if (!take(jar, memory, opts, jvm)) {
+    Json::Value reply;
+    reply["error"] = "cannot start jvm";
+    send_line(fd, reply);
+    return;
+  }
+  bool connected = true;
+  int ret = runTask(fd, jvm, args, connected);
+
+  // a jvm that failed a task may be left in any state
+  put(jvm, ret == 0);
+  if (connected) {
+    Json::Value exit;
+    exit["exit"] = ret;
+    send_line(fd, exit);
+  }
+}
+
+// words of the jvm options, split at blanks outside of quotes and
+// with quotes and backslashes removed as a shell would, but without
+// any expansion
+static std::vector<std::string> split_opts(std::string opts) {
+  std::vector<std::string> words;
+  std::string word;
+  bool in_word = false;
+  char quote = 0;
+  for (int i = 0; i < opts.size(); i++) {
+    char c = opts[i];
+    if (quote) {
+      if (c == quote) {
+        quote = 0;
+      }
+      else if (c == '\\' && quote == '"' && i + 1 < opts.size() &&
+               (opts[i + 1] == '"' || opts[i + 1] == '\\')) {
+        word += opts[++i];
+      }
+      else {
+        word += c;
+      }
+    }
+    else if (c == ' ' || c == '\t' || c == '\n') {
+      if (in_word) {
+        words.push_back(word);
+        word.clear();
+        in_word = false;
+      }
+    }
+    else {
+      in_word = true;
+      if (c == '\'' || c == '"') {
+        quote = c;
+      }
+      else if (c == '\\' && i + 1 < opts.size()) {
+        word += opts[++i];
+      }
+      else {
+        word += c;
+      }
+    }
+  }
+  if (in_word) {
+    words.push_back(word);
+  }
+  return words;
+}
+
+// idle jvm of the jar, heap and options, or a new one
+bool JvmPool::take(std::string jar, int memory, std::string opts,
+    Jvm &jvm)
+{
+  // the jvm is started without a shell, so the options of the
+  // client are never parsed as a command
+  std::vector<std::string> argv;
+  argv.push_back(java_);
+  std::vector<std::string> words = split_opts(opts);
+  argv.insert(argv.end(), words.begin(), words.end());
+  argv.push_back("-Xmx" + std::to_string((long long)memory) + "g");
+  argv.push_back("-cp");
+  argv.push_back(runner_ + ":" + jar);
+  argv.push_back("JvmRunner");
+  argv.push_back(jar);
+
+  // jvms are matched by their arguments
+  std::string key;
+  for (int i = 0; i < argv.size(); i++) {
+    key += (i ? "\n" : "") + argv[i];
+  }
+  Jvm oldest;
+  oldest.pid = -1;
+  {
+    boost::lock_guard<boost::mutex> guard(mutex_);
+    for (int i = 0; i < idle_.size(); i++) {
+      if (idle_[i].key == key) {
+        jvm = idle_[i];
+        idle_.erase(idle_.begin() + i);
+        num_busy_++;
+        DLOG(INFO) << "Reusing jvm " << jvm.pid << " after "
+                   << jvm.tasks << " tasks";
+        return true;
+      }
+    }
+    // make room among the jvms of other tools
+    if (!idle_.empty() && idle_.size() + num_busy_ >= size_) {
+      oldest = idle_.front();
+      idle_.erase(idle_.begin());
+    }
+    num_busy_++;
+  }
+  if (oldest.pid > 0) {
+    terminate(oldest);
+  }
+
+  int in[2], out[2], err[2];
+  // stdin is a socket so that writing to a dead jvm does not
+  // raise SIGPIPE
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, in) == 0) {
+    if (pipe2(out, O_CLOEXEC) == 0) {
+      if (pipe2(err, O_CLOEXEC) == 0) {
+        jvm.memory = memory;
+        return spawn(argv, key, in, out, err, jvm);
+      }
+      ::close(out[0]); ::close(out[1]);
+    }
+    ::close(in[0]); ::close(in[1]);
+  }
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  num_busy_--;
+  return false;
+}
+
+bool JvmPool::spawn(std::vector<std::string> &argv, std::string key,
+    int in[2], int out[2], int err[2], Jvm &jvm)
+{
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, in[1],  0);
+  posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+  posix_spawn_file_actions_adddup2(&actions, err[1], 2);
+
+  // in its own process group, out of reach of the signals
+  // the executor sends to its tasks
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+  posix_spawnattr_setpgroup(&attr, 0);
+
+  std::vector<char*> args;
+  for (int i = 0; i < argv.size(); i++) {
+    args.push_back(const_cast<char*>(argv[i].c_str()));
+  }
+  args.push_back(NULL);
+
+  // java_path may be a command in PATH
+  pid_t pid;
+  int ret = posix_spawnp(&pid, argv[0].c_str(), &actions, &attr,
+      &args[0], environ);
+
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  ::close(in[1]);
+  ::close(out[1]);
+  ::close(err[1]);
+
+  if (ret) {
+    LOG(ERROR) << "Cannot start jvm " << argv[0] << ": " << strerror(ret);
+    boost::lock_guard<boost::mutex> guard(mutex_);
+    num_busy_--;
+    ::close(in[0]);
+    ::close(out[0]);
+    ::close(err[0]);
+    return false;
+  }
+  DLOG(INFO) << "Started jvm " << pid << " for " << argv.back();
+
+  jvm.pid   = pid;
+  jvm.in    = in[0];
+  jvm.out   = out[0];
+  jvm.err   = err[0];
+  jvm.key   = key;
+  jvm.tasks = 0;
+  return true;
+}
+
+// keep a jvm for the next task, replacing the one idle for the
+// longest if the pool is full
+void JvmPool::put(Jvm &jvm, bool reuse) {
+  jvm.tasks++;
+  {
+    boost::lock_guard<boost::mutex> guard(mutex_);
+    num_busy_--;
+  }
+  if (!reuse || jvm.tasks >= reuse_ || stopped_) {
+    terminate(jvm);
+    return;
+  }
+  Jvm oldest;
+  oldest.pid = -1;
+  {
+    boost::lock_guard<boost::mutex> guard(mutex_);
+    if (idle_.size() >= size_) {
+      oldest = idle_.front();
+      idle_.erase(idle_.begin());
+    }
+    idle_.push_back(jvm);
+  }
+  if (oldest.pid > 0) {
+    terminate(oldest);
+  }
+}
+
+void JvmPool::terminate(Jvm &jvm) {
+  ::kill(-jvm.pid, SIGKILL);
+  ::close(jvm.in);
+  ::close(jvm.out);
+  ::close(jvm.err);
+  while (waitpid(jvm.pid, NULL, 0) < 0 && errno == EINTR) ;
+  DLOG(INFO) << "Stopped jvm " << jvm.pid << " after "
+             << jvm.tasks << " tasks";
+}
+
+// exit code of the task, 255 if the jvm is gone, connected is
+// cleared if the submitter is gone
+int JvmPool::runTask(int fd, Jvm &jvm, std::vector<std::string> &args,
+    bool &connected)
+{
+  std::string line;
+  for (int i = 0; i < args.size(); i++) {
+    if (i > 0) line += "\t";
+    line += args[i];
+  }
+  line += "\n";
+  const char* ptr = line.c_str();
+  size_t left = line.size();
+  while (left > 0) {
+    ssize_t n = ::send(jvm.in, ptr, left, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      LOG(WARNING) << "Jvm " << jvm.pid << " is gone";
+      return 255;
+    }
+    ptr += n;
+    left -= n;
+  }
+
+  // forward the output until the runner writes the exit marker,
+  // and kill the jvm if the submitter goes away
+  int err_fd = jvm.err;
+  std::string pending;
+  char data[4096];
+  while (true) {
+    struct pollfd pfds[3];
+    pfds[0].fd = jvm.out;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = err_fd;
+    pfds[1].events = POLLIN;
+    pfds[2].fd = fd;
+    pfds[2].events = POLLIN;
+    if (::poll(pfds, 3, -1) < 0) {
+      if (errno == EINTR) continue;
+      return 255;
+    }
+    if (pfds[2].revents) {
+      if (::recv(fd, data, sizeof(data), MSG_DONTWAIT) <= 0) {
+        LOG(WARNING) << "Submitter of a task on jvm " << jvm.pid
+                     << " is gone, killing it";
+        connected = false;
+        return 128 + SIGKILL;
+      }
+    }
+    if (pfds[1].revents) {
+      ssize_t n = ::read(err_fd, data, sizeof(data));
+      if (n < 0 && errno == EINTR) continue;
+      if (n > 0) {
+        Json::Value err;
+        err["err"] = std::string(data, n);
+        send_line(fd, err);
+      }
+      else {
+        err_fd = -1;
+      }
+    }
+    if (pfds[0].revents) {
+      ssize_t n = ::read(jvm.out, data, sizeof(data));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        LOG(WARNING) << "Jvm " << jvm.pid << " exited during a task";
+        return 255;
+      }
+      pending.append(data, n);
+
+      size_t pos = pending.find(exit_marker);
+      size_t end = pos == std::string::npos ? std::string::npos :
+                   pending.find('\n', pos);
+      // hold back what may be the start of the marker
+      size_t keep = end != std::string::npos ? pos :
+                    pending.rfind(exit_marker[0]);
+      if (keep == std::string::npos) {
+        keep = pending.size();
+      }
+      if (keep > 0) {
+        Json::Value out;
+        out["out"] = pending.substr(0, keep);
+        send_line(fd, out);
+      }
+      if (end != std::string::npos) {
+        int ret = std::atoi(pending.substr(pos + exit_marker.size(),
+              end - pos - exit_marker.size()).c_str());
+
+        // the runner flushes stderr before writing the marker
+        while (true) {
+          struct pollfd pfd;
+          pfd.fd = jvm.err;
+          pfd.events = POLLIN;
+          if (::poll(&pfd, 1, 0) <= 0) break;
+          ssize_t n = ::read(jvm.err, data, sizeof(data));
+          if (n <= 0) break;
+          Json::Value err;
+          err["err"] = std::string(data, n);
+          send_line(fd, err);
+        }
+        return ret;
+      }
+      pending.erase(0, keep);
+    }
+  }
+}
+
+int JvmPool::submit(std::string path, std::string jar, int memory,
+    std::string opts, std::vector<std::string> args,
+    std::ostream &out, std::ostream &err,
+    volatile int* sock_fd)
+{
+  boost::asio::io_service ios;
+  stream_protocol::socket sock(ios);
+  try {
+    sock.connect(stream_protocol::endpoint(path));
+  }
+  catch (boost::system::system_error &e) {
+    LOG(ERROR) << "Cannot reach jvm pool on " << path << ": " << e.what();
+    return 255;
+  }
+  if (sock_fd) {
+    *sock_fd = sock.native_handle();
+  }
+
+  Json::Value req;
+  req["jar"]    = jar;
+  req["memory"] = memory;
+  req["opts"]   = opts;
+  req["args"]   = Json::Value(Json::arrayValue);
+  for (int i = 0; i < args.size(); i++) {
+    req["args"].append(args[i]);
+  }
+
+  int ret = 255;
+  boost::asio::streambuf buf;
+  Json::Value msg;
+  if (send_line(sock.native_handle(), req)) {
+    while (read_line(sock, buf, msg)) {
+      if (msg.isMember("out")) {
+        out << msg["out"].asString();
+        out.flush();
+      }
+      else if (msg.isMember("err")) {
+        err << msg["err"].asString();
+        err.flush();
+      }
+      else if (msg.isMember("exit")) {
+        ret = msg["exit"].asInt();
+        break;
+      }
+      else if (msg.isMember("error")) {
+        LOG(ERROR) << "Jvm pool refused the task: "
+                   << msg["error"].asString();
+        break;
+      }
+    }
+  }
+  if (sock_fd) {
+    *sock_fd = -1;
+  }
+  return ret;
+}
+
+static boost::mutex pool_mutex;
+static JvmPool* pool = NULL;
+static bool pool_started = false;
+
+JvmPool* JvmPool::get() {
+  boost::lock_guard<boost::mutex> guard(pool_mutex);
+  if (pool_started) {
+    return pool;
+  }
+  pool_started = true;
+
+  int size = get_config<int>("gatk.jvm_pool");
+  if (size <= 0) {
+    return NULL;
+  }
+
+  // the runner traps System.exit() of the tools with a security
+  // manager, which java 18 to 23 only allow when asked for, and
+  // java 24 and later do not support at all
+  std::string java = get_config<std::string>("java_path");
+  std::string version = get_java_version(java);
+  int major = get_java_major(version);
+  if (major >= 24) {
+    LOG(WARNING) << "Java " << version << " cannot host the jvm pool, "
+                 << "running without it";
+    return NULL;
+  }
+  if (major >= 12) {
+    java += " -Djava.security.manager=allow";
+  }
+
+  // a unix socket path is limited to the size of sun_path
+  std::string path = conf_temp_dir + "/jvm-pool.sock";
+  if (path.size() >= sizeof(((struct sockaddr_un*)0)->sun_path)) {
+    path = "/tmp/fcs-genome-jvm-" +
+           std::to_string((long long)getpid()) + ".sock";
+  }
+  try {
+    pool = new JvmPool(path, java,
+        get_config<std::string>("jvm_runner_path"),
+        size, get_config<int>("gatk.jvm_pool_reuse"));
+  }
+  catch (boost::system::system_error &e) {
+    LOG(WARNING) << "Cannot start jvm pool on " << path << ": "
+                 << e.what() << ", running without it";
+    return NULL;
+  }
+  // the pool lives until the process exits, which closes the
+  // stdin of its jvms and ends them
+  boost::thread(boost::bind(&JvmPool::run, pool)).detach();
+  LOG(INFO) << "Started jvm pool on " << path;
+
+  return pool;
+}
+
+int JvmPool::reserved() {
+  boost::lock_guard<boost::mutex> guard(pool_mutex);
+  if (!pool) {
+    return 0;
+  }
+  boost::lock_guard<boost::mutex> pool_guard(pool->mutex_);
+  int memory = 0;
+  for (int i = 0; i < pool->idle_.size(); i++) {
+    memory += pool->idle_[i].memory;
+  }
+  return memory;
+}
+
+} // namespace fcsgenome
@@ -38,4 +38,60 @@ std::string LogUtils::findError(std::vector<std::string> logs_) {
   // message will be the shared message accross all logs
   return message;
 }
+
+bool LogUtils::findAny(std::string log, 
+    const char* patterns[], 
+    int num_patterns) 
+{
+  std::ifstream fin(log, std::ios::in);
+  std::string line;
+  while (getline(fin, line)) {
+    for (int i = 0; i < num_patterns; i++) {
+      if (line.find(patterns[i]) != std::string::npos) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool LogUtils::findOutOfMemory(std::string log) {
+  const char* patterns[] = {
+    "java.lang.OutOfMemoryError",
+    "GC overhead limit exceeded",
+    "Cannot allocate memory"
+  };
+  return findAny(log, patterns, sizeof(patterns) / sizeof(patterns[0]));
+}
+
+// GATK keeps running after some of these messages 
+// until all its threads stop
+bool LogUtils::isFatalError(const std::string &line) {
+  const char* patterns[] = {
+    "##### ERROR MESSAGE",
+    "A USER ERROR has occurred",
+    "Exception in thread \"main\""
+  };
+  for (int i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+    if (line.find(patterns[i]) != std::string::npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// errors from the file system or the network that may 
+// not happen again
+bool LogUtils::findTransientError(std::string log) {
+  const char* patterns[] = {
+    "Stale file handle",
+    "Resource temporarily unavailable",
+    "Connection reset by peer",
+    "Connection timed out",
+    "No route to host",
+    "ssh_exchange_identification",
+    "Input/output error"
+  };
+  return findAny(log, patterns, sizeof(patterns) / sizeof(patterns[0]));
+}
 } // namespace fcsgenome
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <fstream>
+#include <glog/logging.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <set>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "fcs-genome/NumaTopology.h"
+
+namespace fcsgenome {
+
+static std::string read_line(std::string path) {
+  std::ifstream fin(path);
+  std::string line;
+  std::getline(fin, line);
+  boost::trim(line);
+  return line;
+}
+
+NumaTopology::NumaTopology(std::string sysfs_dir) {
+  namespace fs = boost::filesystem;
+  boost::system::error_code err;
+
+  std::string node_dir = sysfs_dir + "/node";
+  for (fs::directory_iterator it(node_dir, err), end; 
+       !err && it != end; it.increment(err)) 
+  {
+    std::string name = it->path().filename().string();
+    if (name.compare(0, 4, "node") || name.size() == 4 ||
+        name.find_first_not_of("0123456789", 4) != std::string::npos) {
+      continue;
+    }
+    Node node;
+    node.id   = std::stoi(name.substr(4));
+    node.cpus = parse_cpulist(read_line(it->path().string() + "/cpulist"));
+    if (!node.cpus.empty()) {
+      nodes_.push_back(node);
+    }
+  }
+  if (nodes_.empty()) {
+    Node node;
+    node.id   = 0;
+    node.cpus = parse_cpulist(read_line(sysfs_dir + "/cpu/online"));
+    if (node.cpus.empty()) {
+      for (int i = 0; i < boost::thread::hardware_concurrency(); i++) {
+        node.cpus.push_back(i);
+      }
+    }
+    nodes_.push_back(node);
+  }
+  std::sort(nodes_.begin(), nodes_.end(), 
+      [](const Node &a, const Node &b) { return a.id < b.id; });
+
+  // SMT siblings share the same core in the same package
+  for (int i = 0; i < nodes_.size(); i++) {
+    std::set<std::pair<std::string, std::string> > cores;
+    for (int k = 0; k < nodes_[i].cpus.size(); k++) {
+      std::string topology = sysfs_dir + "/cpu/cpu" + 
+          std::to_string((long long)nodes_[i].cpus[k]) + "/topology";
+      std::string package = read_line(topology + "/physical_package_id");
+      std::string core    = read_line(topology + "/core_id");
+      if (core.empty()) {
+        // count the cpu itself if the topology is unknown
+        core = "cpu" + std::to_string((long long)nodes_[i].cpus[k]);
+      }
+      cores.insert(std::make_pair(package, core));
+    }
+    nodes_[i].num_cores = cores.size();
+  }
+  DLOG(INFO) << "System has " << nodes_.size() << " numa nodes and " 
+             << num_cores() << " physical cores";
+}
+
+int NumaTopology::num_cores() {
+  int num_cores = 0;
+  for (int i = 0; i < nodes_.size(); i++) {
+    num_cores += nodes_[i].num_cores;
+  }
+  return num_cores;
+}
+
+// parse a list like 0-3,8-11 in sysfs
+std::vector<int> NumaTopology::parse_cpulist(std::string cpulist) {
+  std::vector<int> cpus;
+  std::vector<std::string> ranges;
+  boost::split(ranges, cpulist, boost::is_any_of(","));
+  for (int i = 0; i < ranges.size(); i++) {
+    if (ranges[i].empty()) continue;
+    try {
+      size_t pos = ranges[i].find('-');
+      int first = std::stoi(ranges[i].substr(0, pos));
+      int last  = pos == std::string::npos ? 
+                  first : std::stoi(ranges[i].substr(pos + 1));
+      for (int cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+    }
+    catch (std::exception &e) {
+      DLOG(WARNING) << "Cannot parse cpu list '" << cpulist << "'";
+      return std::vector<int>();
+    }
+  }
+  return cpus;
+}
+
+bool NumaTopology::bind(int node) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int i = 0; i < nodes_[node].cpus.size(); i++) {
+    if (nodes_[node].cpus[i] < CPU_SETSIZE) {
+      CPU_SET(nodes_[node].cpus[i], &cpu_set);
+    }
+  }
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set)) {
+    return false;
+  }
+  // both the affinity and the memory policy are kept across 
+  // fork() and exec()
+  int id = nodes_[node].id;
+  unsigned long node_mask[16] = {0};
+  const int bits = 8 * sizeof(unsigned long);
+  if (id < 16 * bits) {
+    node_mask[id / bits] = 1UL << (id % bits);
+    syscall(SYS_set_mempolicy, MPOL_PREFERRED, node_mask, 16 * bits);
+  }
+  return true;
+}
+
+void NumaTopology::unbind() {
+  // the main thread keeps the affinity the process started with
+  cpu_set_t cpu_set;
+  if (!sched_getaffinity(getpid(), sizeof(cpu_set), &cpu_set)) {
+    sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+  }
+  syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+}
+
+} // namespace fcsgenome
@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <cmath>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <glog/logging.h>
+#include <map>
+#include <sstream>
+#include <unistd.h>
+
+#include "fcs-genome/common.h"
+#include "fcs-genome/config.h"
+#include "fcs-genome/RefPartition.h"
+
+namespace fcsgenome {
+
+// shorter runs of N are left in the partitions
+static const uint64_t ref_min_gap = 1000;
+
+// a cut within this share of a part's weight from its target
+// moves to the nearest boundary between intervals
+static const double part_tolerance = 0.1;
+
+std::vector<RefContig> scan_ref_gaps(std::string ref_path,
+    uint64_t min_gap)
+{
+  std::string fai_path = check_input(ref_path + ".fai");
+  std::ifstream fai(fai_path);
+  std::ifstream fasta(ref_path, std::ios::binary);
+  if (!fasta) {
+    throw fileNotFound("Cannot open " + ref_path);
+  }
+
+  std::vector<RefContig> contigs;
+  std::vector<char> buf(1 << 20);
+  std::string line;
+  while (std::getline(fai, line)) {
+    // name, length, offset, bases and bytes per line
+    std::stringstream ss(line);
+    RefContig contig;
+    uint64_t offset;
+    if (!(ss >> contig.name >> contig.length >> offset)) {
+      continue;
+    }
+
+    fasta.clear();
+    fasta.seekg(offset);
+    uint64_t pos = 0;       // of the last base read
+    uint64_t run_start = 0; // of the current run of N, 0 if none
+    while (pos < contig.length && fasta) {
+      fasta.read(&buf[0], buf.size());
+      for (int i = 0; i < fasta.gcount() && pos < contig.length; i++) {
+        char c = buf[i];
+        if (c == '\n' || c == '\r') continue;
+        pos++;
+        if (c == 'N' || c == 'n') {
+          if (!run_start) run_start = pos;
+        }
+        else if (run_start) {
+          if (pos - run_start >= min_gap) {
+            contig.gaps.push_back(std::make_pair(run_start, pos - 1));
+          }
+          run_start = 0;
+        }
+      }
+    }
+    if (run_start && pos + 1 - run_start >= min_gap) {
+      contig.gaps.push_back(std::make_pair(run_start, pos));
+    }
+    contigs.push_back(contig);
+  }
+  return contigs;
+}
+
+// gaps of the reference, from gaps.bed in the cache dir if it
+// has been scanned before
+static std::vector<RefContig> get_ref_gaps(std::string ref_path,
+    std::string cache_dir)
+{
+  std::string gaps_path = cache_dir + "/gaps.bed";
+  if (!boost::filesystem::exists(gaps_path)) {
+    uint64_t start_ts = getTs();
+    std::vector<RefContig> contigs = scan_ref_gaps(ref_path, ref_min_gap);
+
+    // written to a file of this process and renamed, so that
+    // other runs never read a partial one
+    std::string tmp = gaps_path + "." + std::to_string((long long)getpid());
+    std::ofstream fout(tmp);
+    for (int i = 0; i < contigs.size(); i++) {
+      for (int j = 0; j < contigs[i].gaps.size(); j++) {
+        fout << contigs[i].name << "\t" << contigs[i].gaps[j].first - 1
+             << "\t" << contigs[i].gaps[j].second << std::endl;
+      }
+    }
+    fout.close();
+    boost::filesystem::rename(tmp, gaps_path);
+
+    LOG(INFO) << "Scanned the gaps of " << ref_path << " in "
+              << getTs() - start_ts << " seconds";
+    return contigs;
+  }
+
+  // contigs from the .fai and gaps from the cache
+  std::vector<RefContig> contigs;
+  std::map<std::string, int> contig_idx;
+  std::ifstream fai(ref_path + ".fai");
+  std::string line;
+  while (std::getline(fai, line)) {
+    std::stringstream ss(line);
+    RefContig contig;
+    if (ss >> contig.name >> contig.length) {
+      contig_idx[contig.name] = contigs.size();
+      contigs.push_back(contig);
+    }
+  }
+  std::ifstream fin(gaps_path);
+  while (std::getline(fin, line)) {
+    std::stringstream ss(line);
+    std::string chr;
+    uint64_t lbound, ubound;
+    if (ss >> chr >> lbound >> ubound && contig_idx.count(chr)) {
+      contigs[contig_idx[chr]].gaps.push_back(
+          std::make_pair(lbound + 1, ubound));
+    }
+  }
+  return contigs;
+}
+
+static std::string get_ref_cache_dir(std::string ref_path) {
+  namespace fs = boost::filesystem;
+
+  std::string key = get_file_checksum(ref_path + ".fai");
+  std::string dict_path = fs::path(ref_path).replace_extension(".dict").string();
+  if (fs::exists(dict_path)) {
+    key += get_file_checksum(dict_path);
+  }
+  // the gaps come from the sequence, which can change without its
+  // index, and is too large to checksum each run
+  std::stringstream ss;
+  ss << "-" << std::hex << fs::file_size(ref_path) 
+     << "-" << fs::last_write_time(ref_path);
+  key += ss.str();
+
+  std::string ref_dir = fs::path(ref_path).parent_path().string();
+  if (ref_dir.empty()) ref_dir = ".";
+  if (is_folder_writable(ref_dir.c_str())) {
+    return ref_path + ".fcs-intv/" + key;
+  }
+  else {
+    return get_config<std::string>("temp_dir") + "/fcs-genome-intv/" +
+        get_basename(ref_path) + "-" + key;
+  }
+}
+
+std::vector<std::vector<Interval> > split_intervals(
+    std::vector<Interval> &intervals, int nparts)
+{
+  std::vector<std::vector<Interval> > parts;
+
+  // bases and weight of the intervals before the i-th one
+  std::vector<uint64_t> start(1, 0);
+  std::vector<double>   cum(1, 0);
+  for (int i = 0; i < intervals.size(); i++) {
+    start.push_back(start.back() + 
+        intervals[i].ubound - intervals[i].lbound + 1);
+    cum.push_back(cum.back() + intervals[i].weight);
+  }
+  uint64_t total_npos = start.back();
+  if (nparts < 1 || total_npos < nparts) {
+    return parts;
+  }
+  // without any weight, by length
+  if (cum.back() <= 0) {
+    for (int i = 0; i < cum.size(); i++) cum[i] = start[i];
+  }
+  double total_weight = cum.back();
+  double tolerance = total_weight / nparts * part_tolerance;
+
+  // cuts are offsets in the bases of all intervals
+  std::vector<uint64_t> cuts(nparts + 1, 0);
+  cuts[nparts] = total_npos;
+  for (int k = 1; k < nparts; k++) {
+    double target = total_weight * k / nparts;
+
+    // in the interval holding the target, by its weight
+    int i = std::upper_bound(cum.begin(), cum.end(), target) - cum.begin() - 1;
+    uint64_t cut = start[i] + (uint64_t)((target - cum[i]) / 
+        (cum[i+1] - cum[i]) * (start[i+1] - start[i]));
+
+    // or the nearest boundary between intervals, the middle of
+    // a run of them if they are as near
+    int lo = std::lower_bound(cum.begin(), cum.end(), target - tolerance) - cum.begin();
+    int hi = std::upper_bound(cum.begin(), cum.end(), target + tolerance) - cum.begin();
+    double best_diff = -1;
+    int first = -1;
+    int last = -1;
+    for (int b = lo; b < hi; b++) {
+      double diff = std::abs(cum[b] - target);
+      if (best_diff < 0 || diff < best_diff) {
+        best_diff = diff;
+        first = last = b;
+      }
+      else if (diff == best_diff && last == b - 1) {
+        last = b;
+      }
+    }
+    if (first >= 0) {
+      cut = start[(first + last) / 2];
+    }
+
+    // every part keeps at least one base
+    cut = std::max(cut, cuts[k-1] + 1);
+    cut = std::min(cut, total_npos - (nparts - k));
+    cuts[k] = cut;
+  }
+
+  parts.resize(nparts);
+  int i = 0;
+  for (int k = 0; k < nparts; k++) {
+    while (i < intervals.size() && start[i] < cuts[k+1]) {
+      uint64_t lbound = std::max(cuts[k], start[i]);
+      uint64_t ubound = std::min(cuts[k+1], start[i+1]);
+      if (lbound < ubound) {
+        Interval intv = intervals[i];
+        intv.lbound = intervals[i].lbound + lbound - start[i];
+        intv.ubound = intervals[i].lbound + ubound - start[i] - 1;
+        intv.weight = intervals[i].weight * (ubound - lbound) / 
+            (start[i+1] - start[i]);
+        parts[k].push_back(intv);
+      }
+      // the interval continues in the next part
+      if (start[i+1] > cuts[k+1]) break;
+      i++;
+    }
+  }
+  return parts;
+}
+
+// cut the callable bases of the contigs into the lists at intv_paths
+static void write_ref_partitions(std::vector<RefContig> &contigs,
+    std::vector<std::string> &intv_paths)
+{
+  // segments between the gaps of all contigs one after another
+  std::vector<Interval> segments;
+  for (int i = 0; i < contigs.size(); i++) {
+    uint64_t lbound = 1;
+    for (int j = 0; j <= contigs[i].gaps.size(); j++) {
+      uint64_t ubound = j < contigs[i].gaps.size() ?
+          contigs[i].gaps[j].first - 1 : contigs[i].length;
+      if (ubound >= lbound) {
+        Interval segment = {contigs[i].name, lbound, ubound, 
+            (double)(ubound - lbound + 1)};
+        segments.push_back(segment);
+      }
+      if (j < contigs[i].gaps.size()) {
+        lbound = contigs[i].gaps[j].second + 1;
+      }
+    }
+  }
+
+  std::vector<std::vector<Interval> > parts = split_intervals(
+      segments, intv_paths.size());
+  for (int k = 0; k < parts.size(); k++) {
+    std::ofstream fout(intv_paths[k]);
+    for (int i = 0; i < parts[k].size(); i++) {
+      fout << parts[k][i].chr << ":" << parts[k][i].lbound << "-"
+           << parts[k][i].ubound << std::endl;
+    }
+    fout.close();
+  }
+}
+
+std::vector<std::string> get_ref_partitions(std::string ref_path,
+    int nparts)
+{
+  namespace fs = boost::filesystem;
+
+  if (!fs::exists(ref_path + ".fai") || nparts < 1) {
+    return std::vector<std::string>();
+  }
+  std::string cache_dir = get_ref_cache_dir(ref_path);
+
+  std::stringstream ss;
+  ss << cache_dir << "/intv_" << nparts;
+  if (!get_config<bool>("gatk.skip_pseudo_chr")) {
+    ss << "_all";
+  }
+  std::string intv_dir = ss.str();
+
+  std::vector<std::string> intv_paths(nparts);
+  for (int i = 0; i < nparts; i++) {
+    intv_paths[i] = get_contig_fname(intv_dir, i, "list", "part-");
+  }
+  if (fs::exists(intv_dir)) {
+    DLOG(INFO) << "Use cached partitions in " << intv_dir;
+    return intv_paths;
+  }
+
+  create_dir(cache_dir);
+  std::vector<RefContig> contigs = get_ref_gaps(ref_path, cache_dir);
+  if (get_config<bool>("gatk.skip_pseudo_chr") && contigs.size() > 25) {
+    contigs.resize(25);
+  }
+  uint64_t total_npos = 0;
+  for (int i = 0; i < contigs.size(); i++) {
+    total_npos += contigs[i].length;
+    for (int j = 0; j < contigs[i].gaps.size(); j++) {
+      total_npos -= contigs[i].gaps[j].second - contigs[i].gaps[j].first + 1;
+    }
+  }
+  if (total_npos < nparts) {
+    return std::vector<std::string>();
+  }
+
+  // written to a dir of this process and renamed, so that other
+  // runs never read partial lists
+  std::string tmp_dir = intv_dir + "." + std::to_string((long long)getpid());
+  std::vector<std::string> tmp_paths(nparts);
+  create_dir(tmp_dir);
+  for (int i = 0; i < nparts; i++) {
+    tmp_paths[i] = get_contig_fname(tmp_dir, i, "list", "part-");
+  }
+  write_ref_partitions(contigs, tmp_paths);
+
+  boost::system::error_code err;
+  fs::rename(tmp_dir, intv_dir, err);
+  if (err) {
+    // another run got there first
+    remove_path(tmp_dir);
+  }
+  DLOG(INFO) << "Partitioned " << ref_path << " in " << intv_dir;
+
+  return intv_paths;
+}
+
+} // namespace fcsgenome
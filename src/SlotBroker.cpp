@@ -0,0 +1,572 @@
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp>
+#include <errno.h>
+#include <glog/logging.h>
+#include <signal.h>
+#include <sstream>
+#include <string.h>
+#include <unistd.h>
+
+#include "fcs-genome/SlotBroker.h"
+
+namespace fcsgenome {
+
+namespace ipc = boost::interprocess;
+
+static uint64_t now_us() {
+  return boost::chrono::duration_cast<boost::chrono::microseconds>(
+      boost::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool is_alive(int pid) {
+  return ::kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+std::string SlotBroker::queue_name(std::string name) {
+  return "fcs-slots-" + std::to_string((long long)getuid()) + "-" + name;
+}
+
+std::string SlotBroker::client_queue_name(std::string name,
+    int pid, int client)
+{
+  return queue_name(name) + "-" + std::to_string((long long)pid) +
+         "-" + std::to_string((long long)client);
+}
+
+void SlotBroker::remove(std::string name) {
+  ipc::message_queue::remove(queue_name(name).c_str());
+}
+
+SlotBroker::SlotBroker(std::string name): name_(name), next_grant_(0) {
+  queue_.reset(new ipc::message_queue(ipc::create_only,
+        queue_name(name).c_str(), 256, sizeof(SlotRequest)));
+}
+
+SlotBroker::~SlotBroker() {
+  queue_.reset();
+  remove(name_);
+}
+
+void SlotBroker::addHost(std::string host, int slots, int memory) {
+  Host h;
+  h.name   = host;
+  h.slots  = std::max(slots, 1);
+  h.memory = memory;
+  h.used   = 0;
+  hosts_.push_back(h);
+  VLOG(1) << "Added host " << host << " with " << slots
+          << " slots and " << memory << "GB memory";
+}
+
+void SlotBroker::run() {
+  while (true) {
+    SlotRequest req;
+    unsigned int priority = 0;
+    ipc::message_queue::size_type recv_size = 0;
+
+    // wake up every second to take back expired leases
+    bool received = queue_->timed_receive(&req, sizeof(req),
+        recv_size, priority,
+        boost::posix_time::microsec_clock::universal_time() +
+        boost::posix_time::seconds(1));
+
+    if (received && recv_size != sizeof(req)) {
+      LOG(ERROR) << "Unrecognized message";
+      continue;
+    }
+    if (received) {
+      if (req.type == SlotRequest::STOP) {
+        break;
+      }
+      else if (req.type == SlotRequest::ACQUIRE) {
+        VLOG(1) << "Received request " << req.id << " from " << req.pid
+                << " for " << req.slots << " slots of " << req.cores 
+                << " cores and " << req.memory << "GB memory";
+
+        // a request larger than all hosts would block the queue
+        std::vector<int> free;
+        for (int i = 0; i < hosts_.size(); i++) {
+          free.push_back(hosts_[i].slots);
+        }
+        Allocation alloc;
+        if (place(req, free, alloc)) {
+          pending_.push_back(req);
+        }
+        else {
+          LOG(WARNING) << "Request " << req.id << " from " << req.pid
+                       << " does not fit on the hosts";
+          refuse(req);
+        }
+      }
+      else if (req.type == SlotRequest::RELEASE) {
+        for (int i = 0; i < leases_.size(); i++) {
+          if (leases_[i].grant == req.id) {
+            VLOG(1) << "Process " << req.pid << " released grant " << req.id;
+            release(i);
+            break;
+          }
+        }
+      }
+      else if (req.type == SlotRequest::RENEW) {
+        for (int i = 0; i < leases_.size(); i++) {
+          if (leases_[i].req.pid == req.pid &&
+              leases_[i].req.client == req.client)
+          {
+            leases_[i].expiry = now_us() +
+                (uint64_t)leases_[i].req.lease * 1000000;
+          }
+        }
+      }
+    }
+    expire();
+    schedule();
+  }
+}
+
+void SlotBroker::stop() {
+  SlotRequest req;
+  memset(&req, 0, sizeof(req));
+  req.type = SlotRequest::STOP;
+  queue_->send(&req, sizeof(req), 0);
+}
+
+// slots taken by a request, memory counts as much as cores
+// so that a few large-heap tasks cannot exhaust the host
+int SlotBroker::weight(Host &host, SlotRequest &req) {
+  int w = std::max(req.cores, 1);
+  if (host.memory > 0 && req.memory > 0) {
+    int mem_slots = (req.memory * host.slots + host.memory - 1) / host.memory;
+    w = std::max(w, mem_slots);
+  }
+  return std::min(w, host.slots);
+}
+
+// fit all slots of a request in free, taking the hosts with
+// the most free slots first, and update free if it fits
+bool SlotBroker::place(SlotRequest &req,
+    std::vector<int> &free, Allocation &alloc)
+{
+  std::vector<std::pair<int, int> > order;
+  for (int i = 0; i < hosts_.size(); i++) {
+    order.push_back(std::make_pair(-free[i], i));
+  }
+  std::sort(order.begin(), order.end());
+
+  alloc.clear();
+  int left = std::max(req.slots, 1);
+  for (int i = 0; i < order.size() && left > 0; i++) {
+    int host = order[i].second;
+    int w = weight(hosts_[host], req);
+    int n = std::min(left, free[host] / w);
+    if (n > 0) {
+      alloc.push_back(std::make_pair(host, n * w));
+      left -= n;
+    }
+  }
+  if (left > 0) {
+    return false;
+  }
+  for (int i = 0; i < alloc.size(); i++) {
+    free[alloc[i].first] -= alloc[i].second;
+  }
+  return true;
+}
+
+// earliest time the request fits if the leases end as estimated,
+// and the slots it leaves free then; leases without an estimate 
+// are counted as ending last
+bool SlotBroker::reserve(SlotRequest &req,
+    uint64_t &shadow, std::vector<int> &extra)
+{
+  std::vector<std::pair<uint64_t, int> > ends;
+  for (int i = 0; i < leases_.size(); i++) {
+    ends.push_back(std::make_pair(leases_[i].end, i));
+  }
+  std::sort(ends.begin(), ends.end());
+
+  std::vector<int> free;
+  for (int i = 0; i < hosts_.size(); i++) {
+    free.push_back(hosts_[i].slots - hosts_[i].used);
+  }
+  for (int i = 0; i < ends.size(); i++) {
+    Allocation &alloc = leases_[ends[i].second].alloc;
+    for (int j = 0; j < alloc.size(); j++) {
+      free[alloc[j].first] += alloc[j].second;
+    }
+    std::vector<int> left = free;
+    Allocation taken;
+    if (place(req, left, taken)) {
+      shadow = ends[i].first;
+      extra  = left;
+      return true;
+    }
+  }
+  return false;
+}
+
+// take back the slots of leases that were not renewed in time,
+// or of owners that are gone
+void SlotBroker::expire() {
+  uint64_t now = now_us();
+  for (int i = 0; i < leases_.size(); ) {
+    Lease &lease = leases_[i];
+    if ((lease.req.lease > 0 && lease.expiry < now) || 
+        !is_alive(lease.req.owner)) 
+    {
+      LOG(WARNING) << "Lease of request " << lease.req.id << " from "
+                   << lease.req.pid << " has expired";
+      release(i);
+    }
+    else {
+      i++;
+    }
+  }
+  for (std::deque<SlotRequest>::iterator it = pending_.begin();
+       it != pending_.end(); ) {
+    if (!is_alive(it->pid)) {
+      it = pending_.erase(it);
+    }
+    else {
+      it++;
+    }
+  }
+}
+
+// grant pending requests in order while the first one fits, 
+// then let later requests fit in the gaps without delaying it
+void SlotBroker::schedule() {
+  while (!pending_.empty()) {
+    std::vector<int> free;
+    for (int i = 0; i < hosts_.size(); i++) {
+      free.push_back(hosts_[i].slots - hosts_[i].used);
+    }
+    Allocation alloc;
+    if (!place(pending_.front(), free, alloc)) {
+      break;
+    }
+    grant(pending_.front(), alloc);
+    pending_.pop_front();
+  }
+  uint64_t shadow = 0;
+  std::vector<int> extra;
+  if (pending_.size() < 2 || !reserve(pending_.front(), shadow, extra)) {
+    return;
+  }
+  uint64_t now = now_us();
+  std::deque<SlotRequest>::iterator it = pending_.begin() + 1;
+  while (it != pending_.end()) {
+    std::vector<int> free;
+    for (int i = 0; i < hosts_.size(); i++) {
+      free.push_back(hosts_[i].slots - hosts_[i].used);
+    }
+    Allocation alloc;
+    if (!place(*it, free, alloc)) {
+      it++;
+      continue;
+    }
+    // a request still running when the first one is due may
+    // only use the slots the first one leaves free
+    if (it->runtime <= 0 || now + (uint64_t)it->runtime * 1000000 > shadow) {
+      std::vector<int> left = extra;
+      bool fits = true;
+      for (int i = 0; i < alloc.size(); i++) {
+        left[alloc[i].first] -= alloc[i].second;
+        fits = fits && left[alloc[i].first] >= 0;
+      }
+      if (!fits) {
+        it++;
+        continue;
+      }
+      extra = left;
+    }
+    VLOG(1) << "Backfill request " << it->id << " from " << it->pid;
+    grant(*it, alloc);
+    it = pending_.erase(it);
+  }
+}
+
+static bool send_grant(std::string queue, SlotGrant &msg) {
+  try {
+    ipc::message_queue client_q(ipc::open_only, queue.c_str());
+
+    // never block on a client that stopped reading
+    return client_q.try_send(&msg, sizeof(msg), 0);
+  }
+  catch (ipc::interprocess_exception &e) {
+    return false;
+  }
+}
+
+void SlotBroker::refuse(SlotRequest &req) {
+  SlotGrant msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.id    = req.id;
+  msg.grant = -1;
+  send_grant(client_queue_name(name_, req.pid, req.client), msg);
+}
+
+bool SlotBroker::grant(SlotRequest &req, Allocation &alloc) {
+  SlotGrant msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.id    = req.id;
+  msg.grant = next_grant_++;
+
+  std::string hosts;
+  for (int i = 0; i < alloc.size(); i++) {
+    Host &host = hosts_[alloc[i].first];
+    for (int j = 0; j < alloc[i].second / weight(host, req); j++) {
+      hosts += (hosts.empty() ? "" : ",") + host.name;
+    }
+  }
+  strncpy(msg.hosts, hosts.c_str(), sizeof(msg.hosts) - 1);
+
+  if (!send_grant(client_queue_name(name_, req.pid, req.client), msg)) {
+    LOG(WARNING) << "Client " << req.pid << " is gone";
+    return false;
+  }
+  Lease lease;
+  lease.grant  = msg.grant;
+  lease.req    = req;
+  lease.alloc  = alloc;
+  lease.expiry = now_us() + (uint64_t)req.lease * 1000000;
+  lease.end    = req.runtime > 0 ?
+      now_us() + (uint64_t)req.runtime * 1000000 : UINT64_MAX;
+  leases_.push_back(lease);
+  for (int i = 0; i < alloc.size(); i++) {
+    hosts_[alloc[i].first].used += alloc[i].second;
+  }
+  VLOG(1) << "Allocate " << hosts << " for " << req.pid;
+  return true;
+}
+
+void SlotBroker::release(int idx) {
+  Allocation &alloc = leases_[idx].alloc;
+  for (int i = 0; i < alloc.size(); i++) {
+    hosts_[alloc[i].first].used -= alloc[i].second;
+  }
+  leases_.erase(leases_.begin() + idx);
+}
+
+SlotClient::SlotClient(std::string name, int lease, int owner):
+  name_(name), lease_(lease), owner_(owner ? owner : getpid()), 
+  next_id_(0), receiving_(false), stopping_(false)
+{
+  static boost::mutex mutex;
+  static int num_clients = 0;
+  {
+    boost::lock_guard<boost::mutex> guard(mutex);
+    client_ = num_clients++;
+  }
+  queue_.reset(new ipc::message_queue(ipc::open_only,
+        SlotBroker::queue_name(name).c_str()));
+
+  // the reply queue exists before any request is sent
+  reply_name_ = SlotBroker::client_queue_name(name, getpid(), client_);
+  ipc::message_queue::remove(reply_name_.c_str());
+  // room for a grant to every executor thread waiting at once
+  reply_queue_.reset(new ipc::message_queue(ipc::create_only,
+        reply_name_.c_str(), 256, sizeof(SlotGrant)));
+}
+
+SlotClient::~SlotClient() {
+  {
+    boost::lock_guard<boost::mutex> guard(mutex_);
+    stopping_ = true;
+    cond_.notify_all();
+  }
+  if (receiver_.joinable()) {
+    receiver_.join();
+  }
+  reply_queue_.reset();
+  ipc::message_queue::remove(reply_name_.c_str());
+}
+
+void SlotClient::send(SlotRequest req) {
+  req.pid    = getpid();
+  req.owner  = owner_;
+  req.client = client_;
+  req.lease  = lease_;
+  queue_->send(&req, sizeof(req), 0);
+}
+
+void SlotClient::request(int id, int slots, int cores, int memory, 
+    int runtime) 
+{
+  SlotRequest req;
+  memset(&req, 0, sizeof(req));
+  req.type    = SlotRequest::ACQUIRE;
+  req.id      = id;
+  req.slots   = slots;
+  req.cores   = cores;
+  req.memory  = memory;
+  req.runtime = runtime;
+  send(req);
+}
+
+// read one grant from the reply queue, with the lock held on entry
+// and on return but not while waiting; grants of acquire_async go
+// to their handlers, the others to the threads waiting in acquire();
+// returns false if the broker is gone
+bool SlotClient::receive(boost::unique_lock<boost::mutex> &lock) {
+  receiving_ = true;
+  lock.unlock();
+
+  // the broker wakes this up, the timeout only checks it is alive
+  SlotGrant msg;
+  unsigned int priority = 0;
+  ipc::message_queue::size_type recv_size = 0;
+  bool received = reply_queue_->timed_receive(&msg, sizeof(msg), 
+      recv_size, priority,
+      boost::posix_time::microsec_clock::universal_time() +
+      boost::posix_time::seconds(1));
+  bool alive = true;
+  if (!received) {
+    try {
+      ipc::message_queue check(ipc::open_only,
+          SlotBroker::queue_name(name_).c_str());
+    }
+    catch (ipc::interprocess_exception &e) {
+      alive = false;
+    }
+  }
+
+  lock.lock();
+  receiving_ = false;
+  if (received && recv_size == sizeof(msg)) {
+    std::map<int, Handler>::iterator it = handlers_.find(msg.id);
+    if (it != handlers_.end()) {
+      std::vector<std::string> hosts;
+      std::stringstream ss(msg.hosts);
+      std::string host;
+      while (std::getline(ss, host, ',')) {
+        hosts.push_back(host);
+      }
+      it->second(msg.grant, hosts);
+      handlers_.erase(it);
+    }
+    else if (cancelled_.erase(msg.id)) {
+      if (msg.grant >= 0) {
+        release(msg.grant);
+      }
+    }
+    else {
+      replies_[msg.id] = msg;
+    }
+  }
+  if (!alive) {
+    LOG(WARNING) << "Slot broker " << name_ << " is gone";
+    for (std::map<int, Handler>::iterator it = handlers_.begin();
+         it != handlers_.end(); it++) {
+      it->second(-1, std::vector<std::string>());
+    }
+    handlers_.clear();
+    cancelled_.clear();
+  }
+  cond_.notify_all();
+  return alive;
+}
+
+// the executor threads of a process share one client, one of
+// them at a time reads the reply queue and hands each grant to
+// the thread waiting for it
+int SlotClient::acquire(int slots, int cores, int memory, int runtime,
+    std::vector<std::string> &hosts)
+{
+  int id;
+  {
+    boost::lock_guard<boost::mutex> guard(mutex_);
+    id = next_id_++;
+  }
+  request(id, slots, cores, memory, runtime);
+
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (true) {
+    std::map<int, SlotGrant>::iterator it = replies_.find(id);
+    if (it != replies_.end()) {
+      hosts.clear();
+      std::stringstream ss(it->second.hosts);
+      std::string host;
+      while (std::getline(ss, host, ',')) {
+        hosts.push_back(host);
+      }
+      int grant = it->second.grant;
+      replies_.erase(it);
+      return grant;
+    }
+    if (receiving_) {
+      cond_.wait_for(lock, boost::chrono::seconds(1));
+      continue;
+    }
+    if (!receive(lock)) {
+      return -1;
+    }
+  }
+}
+
+int SlotClient::acquire_async(int slots, int cores, int memory, 
+    int runtime, Handler handler)
+{
+  int id;
+  {
+    // the handler is in place before the grant can arrive
+    boost::lock_guard<boost::mutex> guard(mutex_);
+    id = next_id_++;
+    handlers_[id] = handler;
+    if (!receiver_.joinable()) {
+      receiver_ = boost::thread(
+          boost::bind(&SlotClient::receiveGrants, this));
+    }
+  }
+  request(id, slots, cores, memory, runtime);
+  return id;
+}
+
+bool SlotClient::cancel(int id) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  if (!handlers_.erase(id)) {
+    return false;
+  }
+  cancelled_.insert(id);
+  return true;
+}
+
+// answer the requests of acquire_async until the client is gone
+void SlotClient::receiveGrants() {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (receiving_ || (handlers_.empty() && cancelled_.empty())) {
+      cond_.wait_for(lock, boost::chrono::seconds(1));
+      continue;
+    }
+    receive(lock);
+  }
+}
+
+int SlotClient::acquire(int cores, int memory, std::string &host) {
+  std::vector<std::string> hosts;
+  int grant = acquire(1, cores, memory, 0, hosts);
+  if (!hosts.empty()) {
+    host = hosts[0];
+  }
+  return grant;
+}
+
+void SlotClient::release(int grant) {
+  SlotRequest req;
+  memset(&req, 0, sizeof(req));
+  req.type = SlotRequest::RELEASE;
+  req.id   = grant;
+  send(req);
+}
+
+void SlotClient::renew() {
+  SlotRequest req;
+  memset(&req, 0, sizeof(req));
+  req.type = SlotRequest::RENEW;
+  send(req);
+}
+
+} // namespace fcsgenome
@@ -0,0 +1,143 @@
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <fstream>
+#include <glog/logging.h>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+
+#include "fcs-genome/common.h"
+#include "fcs-genome/TaskLedger.h"
+
+namespace fcsgenome {
+
+TaskLedger::TaskLedger(std::string path): path_(path) {
+  std::ifstream fin(path_);
+  std::string line;
+  Json::Reader reader;
+  int num_lines = 0;
+  while (std::getline(fin, line)) {
+    num_lines++;
+    Json::Value entry;
+    // a line cut short by a crash is dropped
+    if (!reader.parse(line, entry) || !entry.isMember("cmd")) {
+      continue;
+    }
+    entries_[entry["cmd"].asString()] = entry;
+  }
+  fin.close();
+
+  // every rerun of a task appends a new line, so drop the
+  // stale ones before the file keeps growing across runs
+  if (num_lines > entries_.size()) {
+    compact();
+  }
+}
+
+void TaskLedger::compact() {
+  std::string temp_path = path_ + ".tmp";
+  std::ofstream fout(temp_path);
+  Json::FastWriter writer;
+  for (std::map<std::string, Json::Value>::iterator it = entries_.begin();
+       it != entries_.end(); it++) {
+    fout << writer.write(it->second);
+  }
+  fout.close();
+  if (!fout || rename(temp_path.c_str(), path_.c_str())) {
+    LOG(WARNING) << "Failed to compact " << path_;
+    remove(temp_path.c_str());
+  }
+}
+
+// modification time in ns, so that a file rewritten within
+// the same second still looks different
+static uint64_t get_mtime(std::string path) {
+  struct stat st;
+  if (stat(path.c_str(), &st)) {
+    return 0;
+  }
+  return (uint64_t)st.st_mtim.tv_sec*1000000000 + st.st_mtim.tv_nsec;
+}
+
+// size and mtime of a file, or file count, total size and latest
+// mtime of a directory; empty if the path does not exist
+std::string TaskLedger::fingerprint(std::string path) {
+  namespace fs = boost::filesystem;
+  boost::system::error_code err;
+  if (!fs::exists(path, err)) {
+    return "";
+  }
+  std::stringstream ss;
+  if (fs::is_directory(path, err)) {
+    uint64_t num_files = 0;
+    uint64_t size = 0;
+    uint64_t mtime = get_mtime(path);
+    for (fs::recursive_directory_iterator it(path, err), end;
+         it != end; it.increment(err))
+    {
+      if (!fs::is_regular_file(it->path(), err)) continue;
+      num_files++;
+      size += fs::file_size(it->path(), err);
+      mtime = std::max(mtime, get_mtime(it->path().string()));
+    }
+    ss << num_files << ":" << size << ":" << mtime;
+  }
+  else {
+    ss << fs::file_size(path, err) << ":" << get_mtime(path);
+  }
+  return ss.str();
+}
+
+bool TaskLedger::check(std::string cmd,
+    std::vector<std::string> inputs,
+    std::vector<std::string> outputs)
+{
+  // a task without declared outputs cannot be verified
+  if (outputs.empty() || !entries_.count(cmd)) {
+    return false;
+  }
+  Json::Value &entry = entries_[cmd];
+
+  std::vector<std::string> paths(inputs);
+  paths.insert(paths.end(), outputs.begin(), outputs.end());
+  for (int i = 0; i < paths.size(); i++) {
+    std::string value = fingerprint(paths[i]);
+    if (i >= inputs.size() && value.empty()) {
+      return false;
+    }
+    if (!entry["files"].isMember(paths[i]) ||
+        entry["files"][paths[i]].asString() != value)
+    {
+      DLOG(INFO) << paths[i] << " changed since the last run";
+      return false;
+    }
+  }
+  return true;
+}
+
+void TaskLedger::record(std::string cmd,
+    std::vector<std::string> inputs,
+    std::vector<std::string> outputs)
+{
+  if (outputs.empty()) {
+    return;
+  }
+  Json::Value entry;
+  entry["cmd"] = cmd;
+  entry["files"] = Json::Value(Json::objectValue);
+
+  std::vector<std::string> paths(inputs);
+  paths.insert(paths.end(), outputs.begin(), outputs.end());
+  for (int i = 0; i < paths.size(); i++) {
+    entry["files"][paths[i]] = fingerprint(paths[i]);
+  }
+  entries_[cmd] = entry;
+
+  Json::FastWriter writer;
+  create_dir(boost::filesystem::path(path_).parent_path().string());
+  std::ofstream fout(path_, std::ios::out | std::ios::app);
+  fout << writer.write(entry);
+  fout.close();
+}
+
+} // namespace fcsgenome
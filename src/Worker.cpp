@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include "fcs-genome/ClassArchive.h"
+#include "fcs-genome/config.h"
+#include "fcs-genome/JvmPool.h"
+#include "fcs-genome/Worker.h"
+
+namespace fcsgenome {
+
+std::vector<std::string> Worker::hosts() {
+  return hosts_.empty() ? conf_host_list : hosts_;
+}
+
+// a single shell word of s, the task command runs under bash
+static std::string shell_quote(std::string s) {
+  std::string ret = "'";
+  for (int i = 0; i < s.size(); i++) {
+    if (s[i] == '\'') {
+      ret += "'\\''";
+    }
+    else {
+      ret += s[i];
+    }
+  }
+  return ret + "'";
+}
+
+std::string Worker::java_cmd(std::string jar, std::string key) {
+  std::stringstream cmd;
+  std::string opts = jvm_opts(key);
+
+  // the pool and the archives only serve tasks started on this host
+  bool local = !get_config<bool>("latency_mode");
+  JvmPool* pool = local ? JvmPool::get() : NULL;
+  if (pool) {
+    cmd << conf_bin_dir << "/fcs-genome jvm "
+        << "--socket " << pool->path() << " "
+        << "--memory " << memory_ << " ";
+    if (!opts.empty()) {
+      cmd << "--java-opts " << shell_quote(opts) << " ";
+    }
+    cmd << "--jar " << jar << " --";
+  }
+  else {
+    std::string java = get_config<std::string>("java_path");
+    cmd << java << " "
+        << "-Xmx" << memory_ << "g ";
+    if (!opts.empty()) {
+      cmd << opts << " ";
+    }
+
+    // shared class metadata cuts the startup and the memory of the
+    // jvms starting together in a stage
+    std::string archive;
+    if (local && get_config<bool>("gatk.cds")) {
+      archive = get_class_archive(java, jar);
+    }
+    if (!archive.empty()) {
+      cmd << "-XX:SharedArchiveFile=" << archive << " -Xshare:auto ";
+    }
+    cmd << "-jar " << jar;
+  }
+  return cmd.str();
+}
+
+std::string Worker::jvm_opts(std::string key) {
+  std::stringstream opts;
+
+  // options of the tool, which come last to override the ones below
+  std::string extra = get_config<std::string>("gatk." + key + ".jvm_opts",
+      "gatk.jvm_opts");
+
+  if (get_config<bool>("gatk.jvm_tuning")) {
+    // a jvm sizes its thread pools to all cpus of the host, while
+    // it only gets the cores of its task, or its share of the node
+    // when the tasks run one per process slot
+    int nprocs = get_config<int>("gatk." + key + ".nprocs", "gatk.nprocs");
+    int share = std::max(num_thread_, 
+        get_config<int>("executor.ncores") / std::max(nprocs, 1));
+    share = std::max(share, 1);
+
+    // ActiveProcessorCount is missing before java 8u191, and
+    // IgnoreUnrecognizedVMOptions would apply to the options of
+    // the user as well, so it is left out for older javas and
+    // for the ones whose version is unknown
+    std::string version = get_java_version(
+        get_config<std::string>("java_path"));
+    int major = get_java_major(version);
+    size_t update = version.find('_');
+    if (major > 8 || (major == 8 &&
+        update != std::string::npos &&
+        std::atoi(version.c_str() + update + 1) >= 191)) {
+      opts << "-XX:ActiveProcessorCount=" << share << " ";
+    }
+    opts << "-XX:ParallelGCThreads=" << share << " "
+         << "-XX:CICompilerCount=" << std::max(2, std::min(share / 2, 4));
+
+    // two collectors would keep the jvm from starting
+    std::string gc = get_config<std::string>("gatk.jvm_gc");
+    if (std::regex_search(extra, std::regex("-XX:\\+Use\\w+GC\\b"))) {
+      gc.clear();
+    }
+    else if (gc == "auto") {
+      // parallel threads do not pay off on a single core or a
+      // small heap, and a large heap collects better in regions
+      if (share == 1 || memory_ <= 2) {
+        gc = "serial";
+      }
+      else if (memory_ <= 16) {
+        gc = "parallel";
+      }
+      else {
+        gc = "g1";
+      }
+    }
+    if (gc == "serial") {
+      opts << " -XX:+UseSerialGC";
+    }
+    else if (gc == "parallel") {
+      opts << " -XX:+UseParallelGC";
+    }
+    else if (gc == "g1") {
+      opts << " -XX:+UseG1GC -XX:ConcGCThreads=" << std::max(1, (share + 2) / 4);
+    }
+    else if (!gc.empty()) {
+      LOG(WARNING) << "Unknown gatk.jvm_gc '" << gc 
+                   << "', keeping the default of java";
+    }
+  }
+
+  if (!extra.empty()) {
+    if (opts.tellp() > 0) opts << " ";
+    opts << extra;
+  }
+  return opts.str();
+}
+
+} // namespace fcsgenome
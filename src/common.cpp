@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <boost/crc.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/regex.hpp>
 #include <fstream>
@@ -77,6 +78,10 @@ std::string check_output(std::string path, bool &f, bool require_file) {
     if (require_file && boost::filesystem::is_directory(path)) {
       throw (fileNotFound("Output path " + path + " is not a file"));
     }
+    if (conf_resume) {
+      // the task ledger decides whether to reuse or overwrite it
+      return get_absolute_path(path);
+    }
     if (!f) {
       std::string user_input; 
       std::cout << "Output file or directory '" << path
@@ -232,6 +237,19 @@ std::string get_bucket_fname(std::string dir, int contig, std::string stem, std:
     return ss.str();
 }
 
+std::string get_file_checksum(std::string path) {
+  boost::crc_32_type crc;
+  std::ifstream fin(path, std::ios::binary);
+  std::vector<char> buf(1 << 20);
+  while (fin) {
+    fin.read(&buf[0], buf.size());
+    crc.process_bytes(&buf[0], fin.gcount());
+  }
+  std::stringstream ss;
+  ss << std::hex << std::setw(8) << std::setfill('0') << crc.checksum();
+  return ss.str();
+}
+
 int count_files_in_dir(std::string directory, std::string ext) {
   boost::filesystem::path Path(directory);
   int files_with_ext = 0;
@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <bits/stdc++.h>
 #include <boost/filesystem.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/algorithm/string/regex.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/thread.hpp>
@@ -9,8 +11,11 @@
 #include <string>
 #include <unistd.h>
 
+#include "fcs-genome/BamIndex.h"
 #include "fcs-genome/common.h"
 #include "fcs-genome/config.h"
+#include "fcs-genome/NumaTopology.h"
+#include "fcs-genome/RefPartition.h"
 
 namespace fcsgenome {
 
@@ -18,6 +23,7 @@ std::string conf_project_dir;
 std::string conf_bin_dir;
 std::string conf_root_dir;
 std::string conf_temp_dir;
+bool conf_resume = false;
 int main_tid = -1;
 
 boost::program_options::variables_map config_vtable;
@@ -26,6 +32,7 @@ std::vector<std::string> conf_host_list;
 std::set<std::string> config_list{
     "temp_dir",
     "log_dir",
+    "project_dir",
     "ref_genome"
     "bwa_path",
     "minimap_path",
@@ -240,7 +247,6 @@ int init(char** argv, int argc) {
   // static settings
   conf_bin_dir      = get_bin_dir();
   conf_root_dir     = conf_bin_dir + "/..";
-  conf_project_dir  = get_absolute_path(".fcs-genome");
   namespace po = boost::program_options;
 
   po::options_description conf_opt;
@@ -255,7 +261,14 @@ int init(char** argv, int argc) {
   int cpu_num     = boost::thread::hardware_concurrency();
   int memory_size = get_sys_memory();
 
+  // one gatk process per physical core, SMT siblings do not 
+  // add much to the throughput of a JVM
+  NumaTopology numa;
+  int core_num    = numa.num_cores();
+
   DLOG(INFO) << "System has " << cpu_num << " total threads on this node";
+  DLOG(INFO) << "System has " << core_num << " physical cores on " 
+             << numa.num_nodes() << " numa nodes";
   DLOG(INFO) << "System has " << memory_size << " gb memory";
 
   // calculate default num_cpu and memory
@@ -263,7 +276,9 @@ int init(char** argv, int argc) {
   int def_nprocs   = 32;
   int def_memory   = 4;
 
-  calc_gatk_default_config(def_nprocs, def_memory, cpu_num, memory_size);
+  calc_gatk_default_config(def_nprocs, def_memory, core_num, memory_size);
+
+  std::string home_dir = std::getenv("HOME") ? std::getenv("HOME") : "";
 
   DLOG(INFO) << "Default gatk.nprocs = " << def_nprocs;
   DLOG(INFO) << "Default gatk.memory = " << def_memory;
@@ -271,6 +286,7 @@ int init(char** argv, int argc) {
   common_opt.add_options()
     arg_decl_string_w_def("temp_dir",        "/tmp",      "temp dir for fast access")
     arg_decl_string_w_def("log_dir",         "./log",     "log dir")
+    arg_decl_string_w_def("project_dir",     "./.fcs-genome", "dir for the task ledger of --resume")
     arg_decl_string_w_def("ref_genome",      "",          "(deprecated) default reference genome path")
     arg_decl_string_w_def("java_path",       "java -d64", "java binary")
     arg_decl_string_w_def("mpi_path",        "/usr/lib64/openmpi",                  "path to mpi installation")
@@ -284,9 +300,28 @@ int init(char** argv, int argc) {
     arg_decl_string_w_def("genomicsdb_path", conf_root_dir+"/tools/bin/vcf2tiledb", "path to GenomicsDB")
     arg_decl_string_w_def("gatk_path",       conf_root_dir+"/tools/package/GenomeAnalysisTK.jar", "path to the GATK 3.x jar file")
     arg_decl_string_w_def("gatk4_path",      conf_root_dir+"/tools/package/GATK4.jar", "path to the GATK 4.x jar file")
+    arg_decl_string_w_def("jvm_runner_path", conf_root_dir+"/tools/package/jvm-runner.jar", "path to the command runner of the GATK jvm pool")
     arg_decl_string_w_def("hosts", "",       "host list for scale-out mode")
     arg_decl_bool_w_def("latency_mode", false, "enable sorting in bwa-mem")
     arg_decl_bool_w_def("use_gatk4", false, "enable GATK4 in fcs-genome")
+    arg_decl_int_w_def("executor.ncores", cpu_num,     "number of cores shared by concurrent tasks")
+    arg_decl_int_w_def("executor.memory", memory_size, "memory in gb shared by concurrent tasks")
+    arg_decl_bool_w_def("executor.trace", false, "write a chrome trace of task execution to log_dir")
+    arg_decl_bool_w_def("executor.numa", false, "pin each task to the cpus and memory of the numa node of its slot")
+    arg_decl_string_w_def("executor.cgroup", "", "delegated cgroup v2 directory to run each task in its own cgroup, limited by its declared cores and memory")
+    arg_decl_int_w_def("executor.cgroup_margin", 50, "percent of memory above the declared memory of a task before its cgroup kills it")
+    arg_decl_int_w_def("executor.output_buffer", 1024, "kb of the latest output of a task kept in memory and saved to its own log if it fails")
+    arg_decl_string_w_def("executor.failure_policy", "best-effort", "fail-fast to stop all tasks after the first failure, or best-effort to only skip the tasks depending on it")
+    arg_decl_int_w_def("executor.max_retries", 2, "times a task out of memory or with a transient error is started again")
+    arg_decl_int_w_def("executor.retry_delay", 5, "seconds before a task with a transient error is started again, doubled for each retry")
+    arg_decl_int_w_def("executor.speculation", 0, "split a task running longer than this percent of the median of its stage onto idle slots, 0 to disable")
+    arg_decl_string_w_def("executor.broker", "", "name of a node-wide fcs-genome broker to take the slots of each task from, shared with other fcs-genome processes")
+    arg_decl_int_w_def("executor.broker_lease", 30, "seconds a slot from the broker is kept by a process that stops renewing it")
+    arg_decl_int_w_def("executor.locality_wait", 5, "in latency_mode, seconds a task waits for the host holding its inputs before it goes to another host")
+    arg_decl_bool_w_def("agent.enabled", false, "in latency_mode, submit tasks to the fcs-genome agent on the least loaded host instead of ssh")
+    arg_decl_int_w_def("agent.port", 7790, "port of fcs-genome agent, for hosts given without one")
+    arg_decl_string_w_def("agent.address", "127.0.0.1", "address the fcs-genome agent listens on, set it to the address of the node to take tasks from other hosts")
+    arg_decl_string_w_def("agent.token_file", home_dir + "/.falcon-genome/agent.token", "file only readable by its owner with the token shared by the agents and their clients, created by the agent if missing")
     ;
 
   tools_opt.add_options()
@@ -320,36 +355,62 @@ int init(char** argv, int argc) {
     arg_decl_bool("gatk.scalout_mode", "enable scale-out mode for gatk")
     arg_decl_string_w_def("gatk.intv.path",    "", "default path to existing contig intervals")
     arg_decl_int_w_def("gatk.ncontigs", def_ncontigs, "default contig partition num in GATK steps")
+    arg_decl_int_w_def("gatk.intv.padding",  0, "bases added to each side of the intervals of an interval list before it is split")
+    arg_decl_string_w_def("gatk.partition", "length", "balance contig partitions by length, or by reads estimated from the bam index")
     arg_decl_int_w_def("gatk.nprocs",   def_nprocs,   "default process num in GATK steps")
     arg_decl_int_w_def("gatk.memory",   def_memory,   "default heap memory in GATK steps")
     arg_decl_int_w_def("gatk.nct",             1,  "default thread number in GATK steps (deprecated)")
     arg_decl_int("gatk.bqsr.nprocs",               "default process num in GATK BaseRecalibrator")
     arg_decl_int("gatk.bqsr.nct",                  "default thread num in  GATK BaseRecalibrator")
     arg_decl_int("gatk.bqsr.memory",               "default heap memory in GATK BaseRecalibrator")
+    arg_decl_string("gatk.bqsr.jvm_opts",          "jvm options of GATK BaseRecalibrator")
+    arg_decl_string("gatk.bqsr.partition",         "contig partitions of GATK BaseRecalibrator, length or reads")
     arg_decl_int("gatk.pr.nprocs",                 "default process num in GATK PrintReads")
     arg_decl_int("gatk.pr.nct",                    "default thread num in  GATK PrintReads")
     arg_decl_int("gatk.pr.memory",                 "default heap memory in GATK PrintReads")
+    arg_decl_string("gatk.pr.jvm_opts",            "jvm options of GATK PrintReads")
+    arg_decl_string("gatk.pr.partition",           "contig partitions of GATK PrintReads, length or reads")
     arg_decl_int("gatk.htc.nprocs",                "default process num in GATK HaplotypeCaller")
     arg_decl_int("gatk.htc.nct",                   "default thread num in  GATK HaplotypeCaller")
     arg_decl_int("gatk.htc.memory",                "default heap memory in GATK HaplotypeCaller")
+    arg_decl_string("gatk.htc.jvm_opts",           "jvm options of GATK HaplotypeCaller")
+    arg_decl_string("gatk.htc.partition",          "contig partitions of GATK HaplotypeCaller, length or reads")
     arg_decl_int("gatk.mutect2.nprocs",            "default process num in GATK Mutect2")
     arg_decl_int("gatk.mutect2.nct",               "default thread num in  GATK Mutect2")
     arg_decl_int("gatk.mutect2.memory",            "default heap memory in GATK Mutect2")
+    arg_decl_string("gatk.mutect2.jvm_opts",       "jvm options of GATK Mutect2")
+    arg_decl_string("gatk.mutect2.partition",      "contig partitions of GATK Mutect2, length or reads")
     arg_decl_int("gatk.indel.nprocs",              "default process num in GATK IndelRealigner")
     arg_decl_int("gatk.indel.memory",              "default heap memory in GATK IndelRealigner")
+    arg_decl_string("gatk.indel.jvm_opts",         "jvm options of GATK IndelRealigner")
+    arg_decl_string("gatk.indel.partition",        "contig partitions of GATK IndelRealigner, length or reads")
     arg_decl_int("gatk.ug.nprocs",                 "default process num in GATK UnifiedGenotyper")
     arg_decl_int("gatk.ug.nt",                     "default thread num in GATK UnifiedGenotyper")
     arg_decl_int("gatk.ug.memory",                 "default heap memory in GATK UnifiedGenotyper")
+    arg_decl_string("gatk.ug.jvm_opts",            "jvm options of GATK UnifiedGenotyper")
+    arg_decl_string("gatk.ug.partition",           "contig partitions of GATK UnifiedGenotyper, length or reads")
     arg_decl_int_w_def("gatk.rtc.nt",          (16 > cpu_num ? cpu_num : 16), "default thread num in GATK RealignerTargetCreator")
     arg_decl_int_w_def("gatk.rtc.memory",      (48 > memory_size ? memory_size: 48), "default heap memory in GATK RealignerTargetCreator")
+    arg_decl_string("gatk.rtc.jvm_opts",   "jvm options of GATK RealignerTargetCreator")
     arg_decl_int_w_def("gatk.joint.ncontigs",  32, "default contig partition num in joint genotyping")
     arg_decl_int_w_def("gatk.combine.nprocs",  def_nprocs, "default process num in GATK CombineGVCFs")
+    arg_decl_string("gatk.combine.jvm_opts",               "jvm options of GATK CombineGVCFs")
     arg_decl_int_w_def("gatk.genotype.nprocs", def_nprocs, "default process num in GATK GenotypeGVCFs")
     arg_decl_int_w_def("gatk.genotype.memory", def_memory, "default heap memory in GATK GenotypeGVCFs")
+    arg_decl_string("gatk.genotype.jvm_opts",              "jvm options of GATK GenotypeGVCFs")
     arg_decl_int("gatk.depth.nprocs",            "default process num in GATK DepthOfCoverage")
     arg_decl_int("gatk.depth.nct",               "default thread num in  GATK DepthOfCoverage")
     arg_decl_int("gatk.depth.memory",            "default heap memory in GATK DepthOfCoverage")
+    arg_decl_string("gatk.depth.jvm_opts",       "jvm options of GATK DepthOfCoverage")
+    arg_decl_string("gatk.depth.partition",      "contig partitions of GATK DepthOfCoverage, length or reads")
     arg_decl_bool_w_def("gatk.skip_pseudo_chr", true, "skip pseudo chromosome intervals")
+    arg_decl_bool_w_def("gatk.cds", false, "start GATK with a class-data-sharing archive of its jar, dumped before the tasks start (java 11 or later)")
+    arg_decl_string_w_def("gatk.cds_dir",      "", "dir of the class-data-sharing archives, default is temp_dir/fcs-genome-cds")
+    arg_decl_bool_w_def("gatk.jvm_tuning", false, "size the gc and jit threads of GATK jvms to the cores of their task")
+    arg_decl_string_w_def("gatk.jvm_gc",     "auto", "gc of GATK jvms: serial, parallel, g1, or auto to choose by heap and cores")
+    arg_decl_string_w_def("gatk.jvm_opts",   "", "jvm options of GATK tasks, after the ones set by fcs-genome")
+    arg_decl_int_w_def("gatk.jvm_pool",        0,  "idle jvms kept to run the next GATK tasks without starting a new jvm, 0 to disable")
+    arg_decl_int_w_def("gatk.jvm_pool_reuse",  20, "GATK tasks run by a pooled jvm before it is replaced")
     arg_decl_string_w_def("blaze.nam_path", conf_root_dir+"/blaze/bin/nam", "path to nam in blaze")
     arg_decl_string_w_def("blaze.conf_path",conf_root_dir+"/blaze/conf",    "path to nam configuration file")
     ;
@@ -367,6 +428,27 @@ int init(char** argv, int argc) {
 
   // Other starting procedures
   // create_dir(get_config<std::string>("log_dir"));
+
+  // a resumed run picks up the intermediate files of the
+  // previous run, which are kept if it failed
+  conf_project_dir = get_absolute_path(
+      get_config<std::string>("project_dir"));
+  if (conf_resume) {
+    std::string temp_record = conf_project_dir + "/temp_dir";
+    std::ifstream fin(temp_record);
+    std::string last_temp_dir;
+    if (fin >> last_temp_dir && 
+        boost::filesystem::is_directory(last_temp_dir)) {
+      conf_temp_dir = last_temp_dir;
+      LOG(INFO) << "Resuming with temp dir " << conf_temp_dir;
+    }
+    fin.close();
+
+    create_dir(conf_project_dir);
+    std::ofstream fout(temp_record);
+    fout << conf_temp_dir << std::endl;
+    fout.close();
+  }
   create_dir(conf_temp_dir);
 
   // set main thread pid
@@ -390,39 +472,10 @@ std::string contig_intv_dir() {
   return ss.str();
 }
 
-std::vector<std::string> init_contig_intv(std::string ref_path) {
-  int ncontigs = get_config<int>("gatk.ncontigs");
-
-  std::stringstream ss;
-  ss << conf_temp_dir << "/intv_" << ncontigs;
-  std::string intv_dir = ss.str();
-  create_dir(intv_dir);
-
-  // record the intv paths
-  std::vector<std::string> intv_paths(ncontigs);
-  for (int i = 0; i < ncontigs; i++) {
-    //intv_paths[i] = get_contig_fname(intv_dir, i, "list", "intv");
-    intv_paths[i] = get_contig_fname(intv_dir, i, "list", "part-");
-  }
-
-  // TODO: temporary to use old partition method, need to check
-  // if num_contigs = 32
-  std::string org_intv_dir = get_config<std::string>("gatk.intv.path");
-  if (ncontigs == 32 && !org_intv_dir.empty()) {
-    DLOG(INFO) << "Use original interval files";
-    // copy intv files
-    for (int i = 0; i < ncontigs; i++) {
-      //std::string org_intv = get_contig_fname(org_intv_dir, i, "list", "intv");
-      std::string org_intv = get_contig_fname(org_intv_dir, i, "list", "part-");
-      if (boost::filesystem::exists(intv_paths[i])) {
-        break;
-      }
-
-      boost::filesystem::copy_file(org_intv, intv_paths[i]);
-    }
-    return intv_paths;
-  }
-
+// contigs and their lengths in the .dict of the reference
+static std::vector<std::pair<std::string, uint64_t> > get_ref_dict(
+    std::string ref_path) 
+{
   // read ref.dict file to get contig lengths
   ref_path = check_input(ref_path);
   boost::filesystem::wpath path(ref_path);
@@ -432,7 +485,6 @@ std::vector<std::string> init_contig_intv(std::string ref_path) {
   // parse ref.dict files
   std::vector<std::string> dict_lines = get_lines(dict_path, "@SQ.*");
   std::vector<std::pair<std::string, uint64_t>> dict;
-  uint64_t dict_length = 0;
   for (int i = 0; i < dict_lines.size(); i++) {
     if (get_config<bool>("gatk.skip_pseudo_chr") && i >= 25) {
       break;
@@ -463,7 +515,288 @@ std::vector<std::string> init_contig_intv(std::string ref_path) {
       idx ++;
     }
     dict.push_back(std::make_pair(chr_name, chr_length));
-    dict_length += chr_length;
+  }
+  return dict;
+}
+
+// skip header and comment lines of bed and list files
+static inline bool is_intv_header(const std::string &line) {
+  return line.empty() || line[0] == '@' || line[0] == '#' ||
+         boost::starts_with(line, "track") || 
+         boost::starts_with(line, "browser");
+}
+
+// parse a chr:start-end or a bed line into 1-based inclusive 
+// bounds, returns false if it has none
+static bool parse_intv_line(std::string line, std::string &chr,
+    uint64_t &lbound, uint64_t &ubound)
+{
+  boost::trim_right(line);
+  char* end;
+  size_t sep = line.find_first_of(" \t");
+  if (sep != std::string::npos) {
+    // bed intervals are 0-based and half-open
+    const char* start = line.c_str() + sep;
+    lbound = strtoull(start, &end, 10) + 1;
+    if (end == start || !isspace(*end)) return false;
+    start = end;
+    ubound = strtoull(start, &end, 10);
+    if (end == start || (*end && !isspace(*end))) return false;
+  }
+  else {
+    sep = line.rfind(':');
+    size_t dash = line.find('-', sep);
+    if (sep == std::string::npos || dash == std::string::npos) {
+      return false;
+    }
+    lbound = strtoull(line.c_str() + sep + 1, &end, 10);
+    if (end != line.c_str() + dash || dash == sep + 1) return false;
+    ubound = strtoull(line.c_str() + dash + 1, &end, 10);
+    if (*end || dash + 1 == line.size()) return false;
+  }
+  chr = line.substr(0, sep);
+  return true;
+}
+
+// intervals of a bed or list file with 1-based inclusive bounds,
+// returns false if there is a line without bounds
+static bool read_intv(std::string intv_path,
+    std::vector<std::string> &chrs,
+    std::vector<std::pair<uint64_t, uint64_t> > &bounds)
+{
+  std::ifstream fin(intv_path);
+  std::string line;
+  while (std::getline(fin, line)) {
+    if (is_intv_header(line)) {
+      continue;
+    }
+    std::string chr;
+    uint64_t lbound, ubound;
+    if (!parse_intv_line(line, chr, lbound, ubound)) {
+      return false;
+    }
+    if (ubound < lbound) continue;
+
+    chrs.push_back(chr);
+    bounds.push_back(std::make_pair(lbound, ubound));
+  }
+  return true;
+}
+
+// estimated reads in each BamIndex::window of the contigs of dict, 
+// from the index of a bam; returns false if no reads could be estimated
+static bool get_read_load(std::string input_path,
+    std::vector<std::pair<std::string, uint64_t> > &dict,
+    std::vector<std::vector<double> > &load)
+{
+  const int window = BamIndex::window;
+
+  load.resize(dict.size());
+  for (int i = 0; i < dict.size(); i++) {
+    load[i].assign((dict[i].second + window - 1) / window, 0);
+  }
+
+  double total_load = 0;
+  try {
+    BamIndex index(input_path);
+    for (int i = 0; i < dict.size(); i++) {
+      std::vector<double> chr_load = index.load(dict[i].first);
+      for (int w = 0; w < chr_load.size() && w < load[i].size(); w++) {
+        load[i][w] = chr_load[w];
+        total_load += chr_load[w];
+      }
+    }
+  }
+  catch (std::runtime_error &e) {
+    LOG(WARNING) << e.what();
+    return false;
+  }
+  return total_load > 0;
+}
+
+// cut the windows of the contigs into parts of about the same load;
+// a cut within part_tolerance of a part's load from its target is 
+// moved to the nearest window without reads or to the start of a 
+// contig, so that partitions tend to end in gaps of the reference
+// or of the coverage rather than in the middle of a pileup
+static const double part_tolerance = 0.1;
+
+static bool write_intv_by_load(
+    std::vector<std::pair<std::string, uint64_t> > &dict,
+    std::vector<std::vector<double> > &load,
+    std::vector<std::string> &intv_paths)
+{
+  const int window = BamIndex::window;
+  int nparts = intv_paths.size();
+
+  // windows of all contigs one after another, boundary b is the 
+  // start of the b-th window, cum[b] the load of the ones before
+  std::vector<int> contig_start(dict.size() + 1, 0);
+  std::vector<double> cum(1, 0);
+  for (int i = 0; i < dict.size(); i++) {
+    contig_start[i+1] = contig_start[i] + load[i].size();
+    for (int w = 0; w < load[i].size(); w++) {
+      cum.push_back(cum.back() + load[i][w]);
+    }
+  }
+  // a gap is the start of a contig or next to an empty window
+  std::vector<bool> is_gap(cum.size(), false);
+  for (int i = 0; i <= dict.size(); i++) {
+    is_gap[contig_start[i]] = true;
+  }
+  for (int b = 1; b < cum.size(); b++) {
+    if (cum[b] == cum[b-1]) is_gap[b-1] = is_gap[b] = true;
+  }
+
+  int nwindows = cum.size() - 1;
+  double total_load = cum.back();
+  if (nwindows < nparts || total_load <= 0) {
+    return false;
+  }
+
+  double part_load = total_load / nparts;
+  std::vector<int> cuts(nparts + 1, 0);
+  cuts[nparts] = nwindows;
+  for (int k = 1; k < nparts; k++) {
+    double target = part_load * k;
+    double tolerance = part_load * part_tolerance;
+
+    // boundary closest to the target
+    int cut = std::lower_bound(cum.begin(), cum.end(), target) - cum.begin();
+    if (cut > 0 && target - cum[cut-1] < cum[cut] - target) cut--;
+
+    // nearest gap within the tolerance, the middle of a run of 
+    // empty windows if it has several
+    int lo = std::lower_bound(cum.begin(), cum.end(), target - tolerance) - cum.begin();
+    int hi = std::upper_bound(cum.begin(), cum.end(), target + tolerance) - cum.begin();
+    double best_diff = -1;
+    int first = -1;
+    int last = -1;
+    for (int b = lo; b < hi; b++) {
+      if (!is_gap[b]) continue;
+      double diff = std::abs(cum[b] - target);
+      if (best_diff < 0 || diff < best_diff) {
+        best_diff = diff;
+        first = last = b;
+      }
+      else if (diff == best_diff && last == b - 1) {
+        last = b;
+      }
+    }
+    if (first >= 0) {
+      cut = (first + last) / 2;
+    }
+
+    // every part keeps at least one window
+    cut = std::max(cut, cuts[k-1] + 1);
+    cut = std::min(cut, nwindows - (nparts - k));
+    cuts[k] = cut;
+  }
+
+  for (int k = 0; k < nparts; k++) {
+    DLOG(INFO) << "Partition " << k << ": windows [" << cuts[k] << ", " 
+               << cuts[k+1] << "), load = " << cum[cuts[k+1]] - cum[cuts[k]];
+
+    std::ofstream fout(intv_paths[k]);
+    for (int i = 0; i < dict.size(); i++) {
+      int lwin = std::max(cuts[k], contig_start[i]);
+      int uwin = std::min(cuts[k+1], contig_start[i+1]);
+      if (lwin >= uwin) continue;
+
+      uint64_t lbound = (uint64_t)(lwin - contig_start[i]) * window + 1;
+      uint64_t ubound = std::min((uint64_t)(uwin - contig_start[i]) * window,
+          dict[i].second);
+      write_contig_intv(fout, dict[i].first, lbound, ubound);
+    }
+    fout.close();
+  }
+  return true;
+}
+
+std::vector<std::string> init_contig_intv(std::string ref_path, 
+    std::string input_path,
+    std::string cmd) 
+{
+  int ncontigs = get_config<int>("gatk.ncontigs");
+
+  std::string partition = get_config<std::string>("gatk.partition");
+  if (!cmd.empty()) {
+    partition = get_config<std::string>("gatk." + cmd + ".partition", 
+        "gatk.partition");
+  }
+  if (partition != "length" && partition != "reads") {
+    LOG(WARNING) << "Unknown partition '" << partition 
+                 << "', partitioning by length";
+    partition = "length";
+  }
+
+  // read partitions differ by input, so that they do not 
+  // overwrite the ones of another input in the same run
+  if (partition == "reads" && !input_path.empty()) {
+    std::vector<std::pair<std::string, uint64_t> > dict = get_ref_dict(ref_path);
+    std::vector<std::vector<double> > load;
+
+    if (get_read_load(input_path, dict, load)) {
+      std::stringstream ss;
+      ss << contig_intv_dir() << "/" << get_basename(input_path) << "-"
+         << std::hex << std::hash<std::string>()(get_absolute_path(input_path));
+      std::string intv_dir = ss.str();
+      create_dir(intv_dir);
+
+      std::vector<std::string> intv_paths(ncontigs);
+      for (int i = 0; i < ncontigs; i++) {
+        intv_paths[i] = get_contig_fname(intv_dir, i, "list", "part-");
+      }
+      if (write_intv_by_load(dict, load, intv_paths)) {
+        DLOG(INFO) << "Partitioned by the reads of " << input_path 
+                   << " in " << intv_dir;
+        return intv_paths;
+      }
+    }
+    LOG(WARNING) << "Cannot estimate the reads of " << input_path 
+                 << ", partitioning by length";
+  }
+
+  std::stringstream ss;
+  ss << conf_temp_dir << "/intv_" << ncontigs;
+  std::string intv_dir = ss.str();
+  create_dir(intv_dir);
+
+  // record the intv paths
+  std::vector<std::string> intv_paths(ncontigs);
+  for (int i = 0; i < ncontigs; i++) {
+    //intv_paths[i] = get_contig_fname(intv_dir, i, "list", "intv");
+    intv_paths[i] = get_contig_fname(intv_dir, i, "list", "part-");
+  }
+
+  // TODO: temporary to use old partition method, need to check
+  // if num_contigs = 32
+  std::string org_intv_dir = get_config<std::string>("gatk.intv.path");
+  if (ncontigs == 32 && !org_intv_dir.empty()) {
+    DLOG(INFO) << "Use original interval files";
+    // copy intv files
+    for (int i = 0; i < ncontigs; i++) {
+      //std::string org_intv = get_contig_fname(org_intv_dir, i, "list", "intv");
+      std::string org_intv = get_contig_fname(org_intv_dir, i, "list", "part-");
+      if (boost::filesystem::exists(intv_paths[i])) {
+        break;
+      }
+
+      boost::filesystem::copy_file(org_intv, intv_paths[i]);
+    }
+    return intv_paths;
+  }
+
+  // balanced by callable bases if the reference has a .fai
+  std::vector<std::string> ref_paths = get_ref_partitions(ref_path, ncontigs);
+  if (!ref_paths.empty()) {
+    return ref_paths;
+  }
+
+  std::vector<std::pair<std::string, uint64_t>> dict = get_ref_dict(ref_path);
+  uint64_t dict_length = 0;
+  for (int i = 0; i < dict.size(); i++) {
+    dict_length += dict[i].second;
   }
 
   // generate intv.list
@@ -490,7 +823,10 @@ std::vector<std::string> init_contig_intv(std::string ref_path) {
     while (npos > remain_npos) {
       ubound = remain_npos + lbound - 1;
 
-      write_contig_intv(fout, chr_name, lbound, ubound);
+      // the part may have been filled up by the previous chr
+      if (remain_npos > 0) {
+        write_contig_intv(fout, chr_name, lbound, ubound);
+      }
 
       lbound = ubound + 1;
       npos -= remain_npos;
@@ -511,6 +847,33 @@ std::vector<std::string> init_contig_intv(std::string ref_path) {
   return intv_paths;
 }
 
+std::vector<std::string> init_folder_intv(std::string ref_path,
+    std::string input_dir)
+{
+  namespace fs = boost::filesystem;
+  int ncontigs = get_config<int>("gatk.ncontigs");
+
+  // the lists of a part can only be used along with the lists of
+  // all the others, folders of older versions have none of them and
+  // get the length partitions
+  std::vector<std::string> intv_paths(ncontigs);
+  for (int i = 0; i < ncontigs; i++) {
+    std::string ext[2] = {"list", "bed"};
+    for (int j = 0; j < 2 && intv_paths[i].empty(); j++) {
+      std::string path = get_contig_fname(input_dir, i, ext[j]);
+      if (fs::exists(path) && fs::file_size(path) > 0) {
+        intv_paths[i] = path;
+      }
+    }
+    if (intv_paths[i].empty()) {
+      DLOG(INFO) << "No region of part " << i << " in " << input_dir 
+                 << ", partitioning by length";
+      return init_contig_intv(ref_path);
+    }
+  }
+  return intv_paths;
+}
+
 int roundUp(int numToRound, int multiple){
     if (multiple == 0) return numToRound;
     int remainder = abs(numToRound) % multiple;
@@ -550,6 +913,11 @@ std::vector<std::string> split_ref_by_nprocs(std::string ref_path) {
     return intv_paths;
   }
 
+  std::vector<std::string> ref_paths = get_ref_partitions(ref_path, ncontigs);
+  if (!ref_paths.empty()) {
+    return ref_paths;
+  }
+
   // read ref.dict file to get contig lengths
   ref_path = check_input(ref_path);
   boost::filesystem::wpath path(ref_path);
@@ -705,6 +1073,8 @@ unsigned int CountLines(const std::vector <char> &buff, int sz) {
     return newlines;
 }
 
+// split the lines of a file, such as a gene list, into 
+// gatk.ncontigs files of about the same number of lines
 std::vector<std::string> split_by_nprocs(std::string intervalFile, std::string filetype) {
 
   intervalFile = check_input(intervalFile);
@@ -712,29 +1082,22 @@ std::vector<std::string> split_by_nprocs(std::string intervalFile, std::string f
   const int SZ = 1024*1024;
   std::vector <char> buff( SZ );
   std::ifstream ifs( intervalFile );
-  int n = 0;
+  uint64_t n = 0;
   while( int cc = FileRead( ifs, buff ) ) {
       n += CountLines( buff, cc );
   }
   DLOG(INFO) << "Number of Intervals : " << n << std::endl;
 
   int ncontigs = get_config<int>("gatk.ncontigs");
-  int chunk = int(n/ncontigs);
-  int nearest_multiple = roundUp(chunk,ncontigs);
 
   std::stringstream ss;
   ss << conf_temp_dir << "/intv_" << ncontigs;
   std::string intv_dir = ss.str();
   create_dir(intv_dir);
 
-  std::vector<std::string> inputData;
   std::ifstream in_file(intervalFile);
   std::string str;
-  int index=0;
-  while (std::getline(in_file, str)) {
-    inputData.push_back(str);
-    ++index;
-  }
+  uint64_t index = 0;
 
   std::ofstream myfile;
   // record the intv paths
@@ -742,35 +1105,310 @@ std::vector<std::string> split_by_nprocs(std::string intervalFile, std::string f
   for (int i = 0; i < ncontigs; i++) {
       if (filetype=="list") {
           intv_paths[i] = get_contig_fname(intv_dir, i, "list", "intv");
-          //DLOG(INFO) << "LIST: " << intv_paths[i] << std::endl;
       } else {
           intv_paths[i] = get_contig_fname(intv_dir, i, "bed", "intv");
-          //DLOG(INFO) << "BED: " << intv_paths[i] << std::endl;
       }
 
+      // the last part also takes a line without a newline
       myfile.open(intv_paths[i]);
-      int start = i*nearest_multiple;
-      int last  = start + nearest_multiple;
-      if (last > n) last = n;
-      for (int j = start; j < last; ++j) {
-           myfile <<  inputData[j] << std::endl;
+      uint64_t last = (i == ncontigs - 1) ? UINT64_MAX : n*(i+1)/ncontigs;
+      while (index < last && std::getline(in_file, str)) {
+           myfile << str << std::endl;
+           ++index;
       }
       myfile.close(); myfile.clear();
   }
+  return intv_paths;
+}
 
-  std::string org_intv_dir = get_config<std::string>("gatk.intv.path");
-  if (ncontigs == 32 && !org_intv_dir.empty()) {
-    DLOG(INFO) << "Use original interval files";
-    // copy intv files
-    for (int i = 0; i < ncontigs; i++) {
-      std::string org_intv = get_contig_fname(org_intv_dir, i, "list", "intv");
-      if (boost::filesystem::exists(intv_paths[i])) {
-        break;
+// (contig index, bounds) of an interval, so that target lists of
+// millions of lines take little memory
+typedef std::pair<int, std::pair<uint64_t, uint64_t> > intv_record;
+
+// intervals of a bed or list file, padded, sorted in the order of 
+// the contigs in dict and merged if they overlap or are adjacent; 
+// contigs not in dict are appended to it in the order of the file,
+// throws invalidParam if there is a line without bounds
+static std::vector<intv_record> read_merged_intv(std::string intv_path,
+    std::vector<std::pair<std::string, uint64_t> > &dict,
+    std::map<std::string, int> &contig_idx,
+    uint64_t padding)
+{
+  std::vector<intv_record> records;
+  std::ifstream fin(intv_path);
+  std::string line;
+  while (std::getline(fin, line)) {
+    if (is_intv_header(line)) {
+      continue;
+    }
+    std::string chr;
+    uint64_t lbound, ubound;
+    if (!parse_intv_line(line, chr, lbound, ubound)) {
+      throw invalidParam("Interval without bounds in " + intv_path + 
+          ": " + line);
+    }
+    if (ubound < lbound) continue;
+
+    if (!contig_idx.count(chr)) {
+      contig_idx[chr] = dict.size();
+      dict.push_back(std::make_pair(chr, (uint64_t)0));
+    }
+    lbound = lbound > padding ? lbound - padding : 1;
+    ubound = ubound + padding;
+    uint64_t length = dict[contig_idx[chr]].second;
+    if (length > 0 && ubound > length) ubound = length;
+
+    records.push_back(std::make_pair(contig_idx[chr], 
+        std::make_pair(lbound, ubound)));
+  }
+  std::sort(records.begin(), records.end());
+
+  std::vector<intv_record> merged;
+  for (int i = 0; i < records.size(); i++) {
+    if (!merged.empty() && merged.back().first == records[i].first &&
+        records[i].second.first <= merged.back().second.second + 1) {
+      merged.back().second.second = std::max(merged.back().second.second,
+          records[i].second.second);
+    }
+    else {
+      merged.push_back(records[i]);
+    }
+  }
+  return merged;
+}
+
+// contigs of the reference and their index, empty if it has no .dict
+static void get_contig_idx(std::string ref_path, std::string intv_path,
+    std::vector<std::pair<std::string, uint64_t> > &dict,
+    std::map<std::string, int> &contig_idx)
+{
+  try {
+    dict = get_ref_dict(ref_path);
+  }
+  catch (fileNotFound &e) {
+    DLOG(INFO) << e.what() << ", intervals keep the contig order of "
+               << intv_path;
+  }
+  for (int i = 0; i < dict.size(); i++) {
+    contig_idx[dict[i].first] = i;
+  }
+}
+
+std::vector<std::string> intersect_intv(std::string intv_path,
+    std::vector<std::string> part_paths,
+    std::string ref_path)
+{
+  if (part_paths.empty()) {
+    return part_paths;
+  }
+  intv_path = check_input(intv_path);
+
+  std::vector<std::pair<std::string, uint64_t> > dict;
+  std::map<std::string, int> contig_idx;
+  get_contig_idx(ref_path, intv_path, dict, contig_idx);
+  std::vector<intv_record> targets = read_merged_intv(intv_path, 
+      dict, contig_idx, 0);
+
+  // intersections of different lists or partitions in the same run
+  // do not overwrite each other
+  std::stringstream ss;
+  ss << contig_intv_dir() << "/isect-" << std::hex 
+     << std::hash<std::string>()(get_absolute_path(intv_path) + ":" +
+        get_absolute_path(part_paths[0]));
+  std::string intv_dir = ss.str();
+  create_dir(intv_dir);
+
+  std::vector<std::string> intv_paths(part_paths.size());
+  uint64_t total_npos = 0;
+  for (int k = 0; k < part_paths.size(); k++) {
+    std::vector<intv_record> part = read_merged_intv(
+        check_input(part_paths[k]), dict, contig_idx, 0);
+
+    // both are sorted, so one pass over each
+    std::vector<intv_record> isect;
+    int i = 0;
+    int j = 0;
+    while (i < targets.size() && j < part.size()) {
+      if (targets[i].first != part[j].first) {
+        if (targets[i].first < part[j].first) i++; else j++;
+        continue;
       }
-      boost::filesystem::copy_file(org_intv, intv_paths[i]);
+      uint64_t lbound = std::max(targets[i].second.first, part[j].second.first);
+      uint64_t ubound = std::min(targets[i].second.second, part[j].second.second);
+      if (lbound <= ubound) {
+        isect.push_back(std::make_pair(targets[i].first, 
+            std::make_pair(lbound, ubound)));
+      }
+      if (targets[i].second.second < part[j].second.second) i++; else j++;
+    }
+    if (isect.empty()) {
+      DLOG(INFO) << part_paths[k] << " does not overlap " << intv_path;
+      continue;
+    }
+
+    intv_paths[k] = get_contig_fname(intv_dir, k, "list", "part-");
+    std::ofstream fout(intv_paths[k]);
+    for (int n = 0; n < isect.size(); n++) {
+      write_contig_intv(fout, dict[isect[n].first].first,
+          isect[n].second.first, isect[n].second.second);
+      total_npos += isect[n].second.second - isect[n].second.first + 1;
+    }
+    fout.close();
+  }
+  if (total_npos == 0) {
+    throw invalidParam(intv_path + " does not overlap the reference " + 
+        ref_path);
+  }
+  DLOG(INFO) << "Intersected " << targets.size() << " intervals of "
+             << intv_path << " with the partitions in " << intv_dir;
+
+  return intv_paths;
+}
+
+std::vector<std::string> split_intv_by_nprocs(std::string intv_path,
+    std::string ref_path,
+    std::string ext,
+    std::string input_path,
+    std::string cmd)
+{
+  namespace fs = boost::filesystem;
+  const int window = BamIndex::window;
+
+  int ncontigs = get_config<int>("gatk.ncontigs");
+  uint64_t padding = std::max(get_config<int>("gatk.intv.padding"), 0);
+  intv_path = check_input(intv_path);
+
+  // contigs in the order of the reference, then of the file
+  std::vector<std::pair<std::string, uint64_t> > dict;
+  std::map<std::string, int> contig_idx;
+  get_contig_idx(ref_path, intv_path, dict, contig_idx);
+
+  std::vector<intv_record> records = read_merged_intv(intv_path,
+      dict, contig_idx, padding);
+  std::vector<Interval> intervals;
+  for (int i = 0; i < records.size(); i++) {
+    Interval intv = {dict[records[i].first].first, 
+        records[i].second.first, records[i].second.second, 0};
+    intervals.push_back(intv);
+  }
+  std::vector<intv_record>().swap(records);
+
+  // weighed by reads if there is a bam, otherwise by length
+  std::string partition = get_config<std::string>(
+      "gatk." + cmd + ".partition", "gatk.partition");
+  bool by_reads = false;
+  if (partition == "reads" && fs::is_regular_file(input_path)) {
+    try {
+      BamIndex index(input_path);
+      std::string chr;
+      std::vector<double> load;
+      for (int i = 0; i < intervals.size(); i++) {
+        if (intervals[i].chr != chr) {
+          chr = intervals[i].chr;
+          load = index.load(chr);
+        }
+        uint64_t lbound = intervals[i].lbound - 1;
+        uint64_t ubound = intervals[i].ubound;
+        while (lbound < ubound && lbound / window < load.size()) {
+          uint64_t w = lbound / window;
+          uint64_t next = std::min((w + 1) * window, ubound);
+          intervals[i].weight += load[w] * (next - lbound) / window;
+          lbound = next;
+        }
+      }
+      by_reads = true;
+    }
+    catch (std::runtime_error &e) {
+      LOG(WARNING) << e.what();
+      LOG(WARNING) << "Cannot estimate the reads of " << input_path 
+                   << ", splitting " << intv_path << " by length";
     }
-    return intv_paths;
   }
+  if (!by_reads) {
+    for (int i = 0; i < intervals.size(); i++) {
+      intervals[i].weight = intervals[i].ubound - intervals[i].lbound + 1;
+    }
+  }
+
+  std::vector<std::vector<Interval> > parts = split_intervals(
+      intervals, ncontigs);
+  if (parts.empty()) {
+    throw invalidParam(intv_path + " has fewer bases than gatk.ncontigs");
+  }
+
+  std::stringstream ss;
+  ss << conf_temp_dir << "/intv_" << ncontigs;
+  std::string intv_dir = ss.str();
+  create_dir(intv_dir);
+
+  std::vector<std::string> intv_paths(ncontigs);
+  for (int k = 0; k < ncontigs; k++) {
+    std::ofstream bed(get_contig_fname(intv_dir, k, "bed", "target-"));
+    std::ofstream list(get_contig_fname(intv_dir, k, "list", "target-"));
+    for (int i = 0; i < parts[k].size(); i++) {
+      bed << parts[k][i].chr << "\t" << parts[k][i].lbound - 1 << "\t"
+          << parts[k][i].ubound << std::endl;
+      list << parts[k][i].chr << ":" << parts[k][i].lbound << "-"
+           << parts[k][i].ubound << std::endl;
+    }
+    intv_paths[k] = get_contig_fname(intv_dir, k, ext, "target-");
+  }
+  DLOG(INFO) << "Split " << intervals.size() << " intervals of " 
+             << intv_path << " by " << (by_reads ? "reads" : "length");
+
+  return intv_paths;
+}
+
+// split the intervals in intv_path into at most nparts lists of 
+// about the same number of bases, written as prefix-<i>.list; 
+// intervals are read as chr:start-end or bed lines, returns an 
+// empty vector if there is a line without bounds
+std::vector<std::string> split_intv_by_length(std::string intv_path, 
+    int nparts, 
+    std::string prefix) 
+{
+  std::vector<std::string> chrs;
+  std::vector<std::pair<uint64_t, uint64_t> > bounds;
+  if (!read_intv(intv_path, chrs, bounds)) {
+    return std::vector<std::string>();
+  }
+  uint64_t total_npos = 0;
+  for (int i = 0; i < bounds.size(); i++) {
+    total_npos += bounds[i].second - bounds[i].first + 1;
+  }
+  if (total_npos == 0 || nparts < 1) {
+    return std::vector<std::string>();
+  }
+  if (nparts > total_npos) nparts = total_npos;
+
+  // positions per part
+  uint64_t part_npos = (total_npos + nparts - 1) / nparts;
+  uint64_t remain_npos = part_npos;
+
+  std::vector<std::string> intv_paths;
+  std::ofstream fout;
+  for (int i = 0; i < chrs.size(); i++) {
+    uint64_t lbound = bounds[i].first;
+    uint64_t npos = bounds[i].second - lbound + 1;
+    while (npos > 0) {
+      if (remain_npos == part_npos) {
+        // start a new part
+        fout.close();
+        intv_paths.push_back(prefix + "-" + 
+            std::to_string((long long)intv_paths.size()) + ".list");
+        fout.open(intv_paths.back());
+      }
+      uint64_t n = std::min(npos, remain_npos);
+      write_contig_intv(fout, chrs[i], lbound, lbound + n - 1);
+      lbound += n;
+      npos -= n;
+      remain_npos -= n;
+      if (remain_npos == 0) remain_npos = part_npos;
+    }
+  }
+  fout.close();
+
+  return intv_paths;
 }
 
 void check_vcf_index(std::string inputVCF){
@@ -799,7 +1437,7 @@ void check_vcf_index(std::string inputVCF){
     if (std::difftime(fs::last_write_time(vcf_file), fs::last_write_time(idx_file)) > 0) {
       boost::system::error_code err;
       fs::last_write_time(idx_file, std::time(NULL), err);
-      if (err != 0) {
+      if (err) {
         LOG(ERROR) << "Attempting to update the last modified time for " << idx_file
                    << ", but failed.";
         LOG(ERROR) << "Please fix it manually before running this command again, "
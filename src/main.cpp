@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <boost/thread/lockable_adapter.hpp>
 #include <boost/thread/mutex.hpp>
+#include <cstring>
 #include <iostream>
 #include <string>
 
@@ -36,6 +37,8 @@ int print_help() {
   print_cmd_col("gatk", "call GATK routines");
   print_cmd_col("depth", "Depth of Coverage");
   print_cmd_col("vcf_filter", "Variant Filtration");
+  print_cmd_col("agent", "run tasks of latency_mode submitted by other nodes");
+  print_cmd_col("broker", "share the slots of a node between fcs-genome runs");
 
   return 0;
 }
@@ -71,6 +74,9 @@ namespace fcsgenome {
   int mutect2_main(int argc, char** argv, po::options_description &opt_desc);
   int depth_main(int argc, char** argv, po::options_description &opt_desc);
   int variant_filtration_main(int argc, char** argv, po::options_description &opt_desc);
+  int agent_main(int argc, char** argv, po::options_description &opt_desc);
+  int broker_main(int argc, char** argv, po::options_description &opt_desc);
+  int jvm_main(int argc, char** argv, po::options_description &opt_desc);
 }
 
 int main(int argc, char** argv) {
@@ -92,6 +98,8 @@ int main(int argc, char** argv) {
   opt_desc.add_options()
     ("help,h", "print help messages")
     ("force,f", "overwrite output files if they exist")
+    ("resume", "record finished tasks, and skip those that finished "
+     "in a previous --resume run and whose files are unchanged")
     ("extra-options,O", po::value<std::vector<std::string> >(),
      "extra options for the command");
     //("checkpoint", "save the output of the command");
@@ -105,14 +113,34 @@ int main(int argc, char** argv) {
 
   int ret = 0;
   try {
-    // load configurations
-    init(argv, argc);
+    // resume needs to be known before the temp dir is set up
+    for (int i = 2; i < argc; i++) {
+      if (::strcmp(argv[i], "--resume") == 0) {
+        conf_resume = true;
+      }
+    }
+
+    // the output of a submitted task is its log, so the client
+    // stays quiet and runs without loading the configurations
+    bool submit = cmd == "jvm";
+    if (cmd == "agent") {
+      for (int i = 2; i < argc; i++) {
+        if (::strcmp(argv[i], "--submit") == 0) {
+          submit = true;
+        }
+      }
+    }
+
+    if (!submit) {
+      // load configurations
+      init(argv, argc);
 
-    std::stringstream cmd_log;
-    for (int i = 0; i < argc; i++) {
-      cmd_log << argv[i] << " ";
+      std::stringstream cmd_log;
+      for (int i = 0; i < argc; i++) {
+        cmd_log << argv[i] << " ";
+      }
+      LOG(INFO) << "Arguments: " << cmd_log.str();
     }
-    LOG(INFO) << "Arguments: " << cmd_log.str();
 
     // run command
     if (cmd == "align" | cmd == "al") {
@@ -160,6 +188,16 @@ int main(int argc, char** argv) {
     else if (cmd == "germline") {
       germline_main(argc-1, &argv[1], opt_desc);
     }
+    else if (cmd == "agent") {
+      ret = agent_main(argc-1, &argv[1], opt_desc);
+    }
+    else if (cmd == "broker") {
+      broker_main(argc-1, &argv[1], opt_desc);
+    }
+    else if (cmd == "jvm") {
+      // started by the tasks of GATK workers with gatk.jvm_pool
+      ret = jvm_main(argc-1, &argv[1], opt_desc);
+    }
     else if (cmd == "--version") {
       std::cout << VERSION << std::endl;
     }
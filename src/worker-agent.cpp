@@ -0,0 +1,99 @@
+#include <boost/program_options.hpp>
+
+#include <iostream>
+#include <iterator>
+#include <signal.h>
+#include <string>
+#include <sys/socket.h>
+
+#include "fcs-genome/Agent.h"
+#include "fcs-genome/common.h"
+#include "fcs-genome/config.h"
+
+namespace fcsgenome {
+
+static volatile int submit_sock = -1;
+static volatile sig_atomic_t submit_signal = 0;
+
+// dropping the connection makes the agent kill the task
+static void submit_sig_handler(int sig) {
+  submit_signal = sig;
+  if (submit_sock >= 0) {
+    ::shutdown(submit_sock, SHUT_RDWR);
+  }
+}
+
+int agent_main(int argc, char** argv,
+    boost::program_options::options_description &opt_desc)
+{
+  namespace po = boost::program_options;
+
+  // Define arguments
+  po::variables_map cmd_vm;
+
+  opt_desc.add_options()
+    ("port,p", po::value<int>(), "port to listen on, default is agent.port, "
+     "or of the agent to submit to")
+    ("submit", po::value<std::string>(), "run the command read from stdin "
+     "on the agent at host[:port] and wait for it")
+    ("token-file", po::value<std::string>(), "file with the agent token "
+     "for --submit, default is agent.token_file when serving")
+    ("cores", po::value<int>()->default_value(1), "cores taken by the submitted command")
+    ("memory", po::value<int>()->default_value(0), "memory in gb taken by the submitted command");
+
+  // Parse arguments
+  po::store(po::parse_command_line(argc, argv, opt_desc),
+      cmd_vm);
+
+  if (cmd_vm.count("help")) {
+    throw helpRequest();
+  }
+  po::notify(cmd_vm);
+
+  if (!cmd_vm.count("submit")) {
+    int port = cmd_vm.count("port") ? cmd_vm["port"].as<int>() :
+               get_config<int>("agent.port");
+    std::string token_file = cmd_vm.count("token-file") ?
+        cmd_vm["token-file"].as<std::string>() :
+        get_config<std::string>("agent.token_file");
+    Agent agent(Agent::readToken(token_file, true),
+        get_config<std::string>("agent.address"), port);
+    agent.run();
+    return 0;
+  }
+
+  // the configurations are not loaded for a submit
+  std::string name;
+  int port = 0;
+  Agent::parseHost(cmd_vm["submit"].as<std::string>(), 
+      cmd_vm.count("port") ? cmd_vm["port"].as<int>() : 0, 
+      name, port);
+  if (port <= 0) {
+    throw invalidParam("--submit needs host:port or --port");
+  }
+  if (!cmd_vm.count("token-file")) {
+    throw invalidParam("--submit needs --token-file");
+  }
+  std::string token = Agent::readToken(
+      cmd_vm["token-file"].as<std::string>());
+
+  std::string cmd((std::istreambuf_iterator<char>(std::cin)),
+      std::istreambuf_iterator<char>());
+
+  signal(SIGINT,  submit_sig_handler);
+  signal(SIGTERM, submit_sig_handler);
+  signal(SIGHUP,  submit_sig_handler);
+  if (submit_signal) {
+    return 128 + submit_signal;
+  }
+
+  int ret = Agent::submit(name, port, token, cmd,
+      cmd_vm["cores"].as<int>(), cmd_vm["memory"].as<int>(),
+      std::cout, &submit_sock);
+
+  if (submit_signal) {
+    ret = 128 + submit_signal;
+  }
+  return ret;
+}
+} // namespace fcsgenome
@@ -39,7 +39,8 @@ int align_main(int argc, char** argv,
     arg_decl_string_w_def("pl,P", "illumina", "platform id ('PL' in BAM header)")
     arg_decl_string_w_def("lb,L", "sample",   "library id ('LB' in BAM header)")
     ("align-only,l", "skip mark duplicates")
-    ("disable-merge", "give bucket bams instead of the whole bam");
+    ("disable-merge", "give bucket bams instead of the whole bam")
+    ("cohort", "schedule all samples in the sample sheet together so that their stages overlap");
 
   // Parse arguments
   po::store(po::parse_command_line(argc, argv, opt_desc), cmd_vm);
@@ -52,6 +53,7 @@ int align_main(int argc, char** argv,
   bool flag_f          = get_argument<bool>(cmd_vm, "force", "f");
   bool flag_align_only = get_argument<bool>(cmd_vm, "align-only", "l");
   bool flag_disable_merge  = get_argument<bool>(cmd_vm, "disable-merge");
+  bool flag_cohort     = get_argument<bool>(cmd_vm, "cohort");
 
   std::string ref_path    = get_argument<std::string>(cmd_vm, "ref", "r");
   std::string sampleList  = get_argument<std::string>(cmd_vm, "sample_sheet", "F");
@@ -248,9 +250,16 @@ int align_main(int argc, char** argv,
       }
     }
 
-    executor.run();
+    // in cohort mode the tasks of a sample only wait for 
+    // the files they read, not for the previous samples
+    if (!flag_cohort) {
+      executor.run();
+    }
   } //for (auto pair : SampleData)
 
+  if (flag_cohort) {
+    executor.run();
+  }
   return 0;
 }
 } // namespace fcsgenome
@@ -37,14 +37,23 @@ static void baserecalAddWorkers(Executor &executor,
 
   std::vector<std::string> temp_intv;
   if (boost::filesystem::is_regular_file(input_path)){
-    temp_intv=init_contig_intv(ref_path);
+    temp_intv=init_contig_intv(ref_path, input_path, "bqsr");
+    // each task gets the part of the interval list in its partition
+    if (!intv_list.empty()) {
+      temp_intv = intersect_intv(intv_list, temp_intv, ref_path);
+      intv_paths.clear();
+    }
   }
 
-  std::vector<std::string> bqsr_paths(get_config<int>("gatk.ncontigs"));
+  std::vector<std::string> bqsr_paths;
   // compute bqsr for each contigs
   for (int contig = 0; contig < get_config<int>("gatk.ncontigs"); contig++) {
 
     if (boost::filesystem::is_regular_file(input_path)){
+      if (temp_intv[contig].empty()) {
+        DLOG(INFO) << "Skip task " << contig << " without any interval";
+        continue;
+      }
       intv_paths.push_back(temp_intv[contig]);
     }
 
@@ -52,21 +61,22 @@ static void baserecalAddWorkers(Executor &executor,
     std::stringstream ss;
     ss << temp_dir << "/" << get_basename(output_path) << "." << contig;
 
-    bqsr_paths[contig] = ss.str();
-    DLOG(INFO) << "Task " << contig << " bqsr: " << bqsr_paths[contig];
+    std::string bqsr_path = ss.str();
+    DLOG(INFO) << "Task " << contig << " bqsr: " << bqsr_path;
 
     Worker_ptr worker(new BQSRWorker(ref_path, 
        known_sites,
        intv_paths,
        input_path,
-       bqsr_paths[contig],
+       bqsr_path,
        extra_opts,
        contig, 
        flag_f, 
        flag_gatk)
     );
 
-    executor.addTask(worker, sample_id, contig == 0);
+    executor.addTask(worker, sample_id, bqsr_paths.empty());
+    bqsr_paths.push_back(bqsr_path);
     // Clean the vector for the next worker:
     if (boost::filesystem::is_regular_file(input_path)){
       intv_paths.pop_back();
@@ -104,14 +114,32 @@ static void prAddWorkers(Executor &executor,
   }
 
   std::vector<std::string> temp_intv;
+  std::vector<std::string> part_intv;
   if (boost::filesystem::is_regular_file(input_path)){
-    temp_intv=init_contig_intv(ref_path);
+    temp_intv=init_contig_intv(ref_path, input_path, "pr");
+    part_intv = temp_intv;
+    if (!intv_list.empty()) {
+      temp_intv = intersect_intv(intv_list, temp_intv, ref_path);
+      intv_paths.clear();
+    }
   }
 
   for (int contig = 0; contig < get_config<int>("gatk.ncontigs"); contig++) {
 
+    // the steps after read every part of the folder, so a part 
+    // without any interval gets an empty bam, with its partition
+    // as the region
+    bool empty_region = false;
     if (boost::filesystem::is_regular_file(input_path)){
-      intv_paths.push_back(temp_intv[contig]);
+      if (temp_intv[contig].empty()) {
+        DLOG(INFO) << "Task " << contig << " without any interval "
+                   << "writes an empty bam";
+        empty_region = true;
+        intv_paths.push_back(part_intv[contig]);
+      }
+      else {
+        intv_paths.push_back(temp_intv[contig]);
+      }
     }
 
     std::string gatk_method;
@@ -130,7 +158,8 @@ static void prAddWorkers(Executor &executor,
     	extra_opts,
     	contig,
     	flag_f,
-        flag_gatk)
+        flag_gatk,
+        empty_region)
     );
 
     executor.addTask(worker, sample_id, contig == 0);
@@ -0,0 +1,74 @@
+#include <boost/program_options.hpp>
+
+#include <signal.h>
+#include <string>
+
+#include "fcs-genome/common.h"
+#include "fcs-genome/config.h"
+#include "fcs-genome/SlotBroker.h"
+
+namespace fcsgenome {
+
+static std::string broker_name;
+
+static void broker_sig_handler(int sig) {
+  LOG(INFO) << "Caught interrupt, removing queue";
+  // the queue needs to be removed so that a new broker can start
+  SlotBroker::remove(broker_name);
+  exit(0);
+}
+
+int broker_main(int argc, char** argv,
+    boost::program_options::options_description &opt_desc)
+{
+  namespace po = boost::program_options;
+
+  // Define arguments
+  po::variables_map cmd_vm;
+
+  opt_desc.add_options()
+    ("name,n", po::value<std::string>()->default_value("default"), 
+     "name of the broker, set as executor.broker in the clients")
+    ("slots,s", po::value<int>(), "slots of the node, default is executor.ncores")
+    ("memory,m", po::value<int>(), "memory in gb of the node, default is executor.memory")
+    ("remove,r", "remove the queue of a broker that was killed and exit");
+
+  // Parse arguments
+  po::store(po::parse_command_line(argc, argv, opt_desc),
+      cmd_vm);
+
+  if (cmd_vm.count("help")) {
+    throw helpRequest();
+  }
+  po::notify(cmd_vm);
+
+  std::string name = cmd_vm["name"].as<std::string>();
+  if (cmd_vm.count("remove")) {
+    SlotBroker::remove(name);
+    return 0;
+  }
+  int slots  = cmd_vm.count("slots") ? cmd_vm["slots"].as<int>() :
+               get_config<int>("executor.ncores");
+  int memory = cmd_vm.count("memory") ? cmd_vm["memory"].as<int>() :
+               get_config<int>("executor.memory");
+
+  try {
+    SlotBroker broker(name);
+    broker.addHost("localhost", slots, memory);
+
+    broker_name = name;
+    signal(SIGINT,  broker_sig_handler);
+    signal(SIGTERM, broker_sig_handler);
+
+    LOG(INFO) << "Slot broker '" << name << "' is serving " << slots
+              << " slots and " << memory << "GB memory";
+    broker.run();
+  }
+  catch (boost::interprocess::interprocess_exception &e) {
+    LOG(ERROR) << "Cannot start slot broker '" << name << "': " << e.what()
+               << ", use --remove if a previous broker was killed";
+    throw silentExit();
+  }
+  return 0;
+}
+} // namespace fcsgenome
@@ -95,7 +95,7 @@ int depth_main(int argc, char** argv,
   }
 
   if (!intv_list.empty()) {
-    intv_paths = split_by_nprocs(intv_list, "bed");
+    intv_paths = split_intv_by_nprocs(intv_list, ref_path, "bed", input_path, "depth");
   }
   else {
     intv_paths = split_ref_by_nprocs(ref_path);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/program_options.hpp>
@@ -41,6 +42,8 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
     arg_decl_string_w_def("platform,P", "illumina", "platform id ('PL' in BAM header)")
     arg_decl_string_w_def("library,l", "sample",   "library id ('LB' in BAM header)")
     ("produce-bam, b", "select to produce sorted BAM file after alignment")
+    ("cohort", "schedule all samples in the sample sheet together so that the alignment "
+               "of one sample overlaps with variant calling of another")
 
     // HaplotypeCaller Options:
     ("output,o", po::value<std::string>()->required(), "output GVCF/VCF file")
@@ -69,6 +72,7 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
   std::string platform_id = get_argument<std::string>(cmd_vm, "platform", "P");
   std::string library_id  = get_argument<std::string>(cmd_vm, "library", "l");
   bool flag_produce_bam   = get_argument<bool>(cmd_vm, "produce-bam", "b");
+  bool flag_cohort        = get_argument<bool>(cmd_vm, "cohort");
   
   // Extra Options for Aligner:
   std::vector<std::string> extra_opts = get_argument<std::vector<std::string>>(cmd_vm, "extra-options", "O");
@@ -139,6 +143,16 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
   // The BAM file used for HTC:
   std::string input_htc;
 
+  // In cohort mode the tasks of all samples go into one executor and 
+  // only wait for the files they read, the lower ids of the earlier 
+  // samples let their calling go ahead of the alignment of later ones
+  boost::shared_ptr<Executor> cohort_executor;
+  if (flag_cohort) {
+    cohort_executor.reset(new Executor("Falcon Fast Germline",
+        std::max(get_config<int>("sort.nprocs", "gatk.nprocs"),
+                 get_config<int>("gatk.htc.nprocs", "gatk.nprocs"))));
+  }
+
   // Going through each line in the Sample Sheet:
   for (auto pair : sample_data) {
     std::string sample_id = pair.first;
@@ -158,7 +172,11 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
     std::string read_tag;
     for (int i = 0; i < list.size(); ++i) {
 
-      Executor executor("Falcon Fast Germline", get_config<int>("sort.nprocs", "gatk.nprocs"));
+      boost::shared_ptr<Executor> executor = cohort_executor;
+      if (!executor) {
+        executor.reset(new Executor("Falcon Fast Germline", 
+            get_config<int>("sort.nprocs", "gatk.nprocs")));
+      }
 
       std::string fq1_path    = list[i].fastqR1;
       std::string fq2_path    = list[i].fastqR2;
@@ -195,7 +213,7 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
             sample_id, read_group, platform_id, library_id, 
             flag_produce_bam, flag_f));
 
-      executor.addTask(worker, sample_id, true);
+      executor->addTask(worker, sample_id, true);
 
       // perform sambamba sort for each part BAM if not producing bam
       if (!flag_produce_bam) {
@@ -209,7 +227,7 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
                 input, "",
                 SambambaWorker::SORT,
                 "", flag)); 
-          executor.addTask(worker, sample_id, i == 0);
+          executor->addTask(worker, sample_id, i == 0);
         };
       }
       else {
@@ -219,12 +237,14 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
               output, "",
               SambambaWorker::INDEX,
               "", flag)); 
-        executor.addTask(worker, sample_id, true);
+        executor->addTask(worker, sample_id, true);
         // The single BAM used for HTC:
         input_htc=output;
       }
 
-      executor.run();
+      if (!flag_cohort) {
+        executor->run();
+      }
 
     } // END for (int i = 0; i < list.size(); ++i)
 
@@ -238,26 +258,49 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
  
     DLOG(INFO) << " VCF dir : " << temp_vcf_dir;
  
-    // start an executor for NAM
-    Worker_ptr blaze_worker(new BlazeWorker(
-          get_config<std::string>("blaze.nam_path"),
-          get_config<std::string>("blaze.conf_path")));
+    // start an executor for NAM, one for the whole cohort is 
+    // started before it runs
+    boost::shared_ptr<BackgroundExecutor> bg_executor;
+    if (!flag_cohort) {
+      Worker_ptr blaze_worker(new BlazeWorker(
+            get_config<std::string>("blaze.nam_path"),
+            get_config<std::string>("blaze.conf_path")));
  
-    BackgroundExecutor bg_executor(
-          sample_id.empty() ? "blaze-nam" : "blaze-nam-" + sample_id,
-          blaze_worker);
+      bg_executor.reset(new BackgroundExecutor(
+            sample_id.empty() ? "blaze-nam" : "blaze-nam-" + sample_id,
+            blaze_worker));
+    }
  
     std::string file_ext = flag_vcf ? "vcf" : "g.vcf";
-    std::vector<std::string> output_files(get_config<int>("gatk.ncontigs"));
+    std::vector<std::string> output_files;
     std::vector<std::string> intv_paths;
     // If user defines an interval list, then that list will be the first 
-    // element of intv_paths and will be a common file for all HTC process.
+    // element of intv_paths and will be a common file for all HTC process,
+    // unless it is intersected with the partitions of a merged BAM below.
     if (!intv_list.empty()) {
       intv_paths.push_back(intv_list);
     }
 
-    Executor executor("Falcon Fast Germline", 
-        get_config<int>("gatk.htc.nprocs", "gatk.nprocs"));
+    boost::shared_ptr<Executor> executor = cohort_executor;
+    if (!executor) {
+      executor.reset(new Executor("Falcon Fast Germline", 
+          get_config<int>("gatk.htc.nprocs", "gatk.nprocs")));
+    }
+
+    // the input BAM of HTC may not exist yet in cohort mode
+    bool is_merged_bam = flag_produce_bam;
+
+    // the merged BAM and its index are there unless the alignment
+    // runs in the cohort executor, then the partitions are by length
+    std::vector<std::string> htc_intv = temp_intv;
+    if (is_merged_bam && fs::exists(input_htc)) {
+      htc_intv = init_contig_intv(ref_path, input_htc, "htc");
+    }
+    // each task gets the part of the interval list in its partition
+    if (is_merged_bam && !intv_list.empty()) {
+      htc_intv = intersect_intv(intv_list, htc_intv, ref_path);
+      intv_paths.clear();
+    }
  
     for (int contig = 0; contig < get_config<int>("gatk.ncontigs"); contig++) {
       std::string output_file = get_contig_fname(temp_vcf_dir, contig, file_ext);
@@ -265,8 +308,12 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
       // If input BAM is a regular file and not a folder, then each java process will use 
       // the corresponding region from the reference genome.  The folder BAM has the parts BAM with their
       // corresponding region list
-      if (boost::filesystem::is_regular_file(input_htc)){
-        intv_paths.push_back(temp_intv[contig]);
+      if (is_merged_bam){
+        if (htc_intv[contig].empty()) {
+          DLOG(INFO) << "Skip task " << contig << " without any interval";
+          continue;
+        }
+        intv_paths.push_back(htc_intv[contig]);
       }
 
       Worker_ptr worker(new HTCWorker(ref_path,
@@ -284,12 +331,12 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
       // will have two elements (0: interval list and 1: part reference list) in this case.  If interval list not
       // not defined, then intv_paths has 1 element (part reference list). 
       // In the case of a BAM folder, the BAMInput Class will use the parts list from its component (check HTCWorker.cpp):       
-      if (boost::filesystem::is_regular_file(input_htc)){
+      if (is_merged_bam){
         intv_paths.pop_back();
       }
 
-      output_files[contig] = output_file;
-      executor.addTask(worker, sample_id, contig == 0);
+      executor->addTask(worker, sample_id, output_files.empty());
+      output_files.push_back(output_file);
  
     } // END of for (int contig = 0; contig < get_config<int>("gatk.ncontigs"); contig++)
    
@@ -314,7 +361,7 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
          flag_bgzip,
          flag_f)
       );
-      executor.addTask(worker, sample_id, true);
+      executor->addTask(worker, sample_id, true);
     }
     { // bgzip gvcf
       Worker_ptr worker(new ZIPWorker(
@@ -322,17 +369,27 @@ int germline_main(int argc, char** argv, boost::program_options::options_descrip
          output_vcf + ".gz",
          flag_f)
       );
-      executor.addTask(worker, sample_id, true);
+      executor->addTask(worker, sample_id, true);
     }
     { // tabix gvcf
       Worker_ptr worker(new TabixWorker(
          output_vcf + ".gz")
       );
-      executor.addTask(worker, sample_id, true);
+      executor->addTask(worker, sample_id, true);
+    }
+    if (!flag_cohort) {
+      executor->run();
     }
-    executor.run();
    }; //for (auto pair : SampleData)
 
+  if (flag_cohort) {
+    Worker_ptr blaze_worker(new BlazeWorker(
+          get_config<std::string>("blaze.nam_path"),
+          get_config<std::string>("blaze.conf_path")));
+    BackgroundExecutor bg_executor("blaze-nam", blaze_worker);
+
+    cohort_executor->run();
+  }
   return 0;
 }
 } // namespace fcsgenome
@@ -82,7 +82,7 @@ int htc_main(int argc, char** argv,
   std::string temp_gvcf_path = output_dir + "/" + get_basename(output_path);
 
   create_dir(output_dir);
-  std::vector<std::string> output_files(get_config<int>("gatk.ncontigs"));
+  std::vector<std::string> output_files;
 
   // Defining Interval File : 
   std::vector<std::string> intv_paths;
@@ -93,7 +93,12 @@ int htc_main(int argc, char** argv,
   // If BAM input is a regular file, post the intervals from Reference:
   std::vector<std::string> temp_intv;
   if (boost::filesystem::is_regular_file(input_path)){
-    temp_intv=init_contig_intv(ref_path);
+    temp_intv=init_contig_intv(ref_path, input_path, "htc");
+    // each task gets the part of the interval list in its partition
+    if (!intv_list.empty()) {
+      temp_intv = intersect_intv(intv_list, temp_intv, ref_path);
+      intv_paths.clear();
+    }
   }
 
   // start an executor for NAM
@@ -121,6 +126,10 @@ int htc_main(int argc, char** argv,
     }                             
 
     if (boost::filesystem::is_regular_file(input_path)){
+      if (temp_intv[contig].empty()) {
+        DLOG(INFO) << "Skip task " << contig << " without any interval";
+        continue;
+      }
       intv_paths.push_back(temp_intv[contig]);
     } 
 
@@ -136,7 +145,7 @@ int htc_main(int argc, char** argv,
        flag_gatk)
     );
  
-    output_files[contig] = output_file;
+    output_files.push_back(output_file);
     executor.addTask(worker,sample_id);
     if (boost::filesystem::is_regular_file(input_path)){
       intv_paths.pop_back();
@@ -83,10 +83,15 @@ int ir_main(int argc, char** argv,
 
   std::vector<std::string> intv_paths;
   if (!intv_list.empty()) {
-    intv_paths = split_by_nprocs(intv_list, "bed");
+    intv_paths = split_intv_by_nprocs(intv_list, ref_path, "bed", input_path, "indel");
+  }
+  else if (boost::filesystem::is_directory(input_path)) {
+    // the contig bams of a folder follow the partitions they were
+    // written with
+    intv_paths = init_folder_intv(ref_path, input_path);
   }
   else {
-    intv_paths = init_contig_intv(ref_path);
+    intv_paths = init_contig_intv(ref_path, input_path, "indel");
   }
 
   for (int contig = 0; contig < get_config<int>("gatk.ncontigs"); contig++) {
@@ -0,0 +1,84 @@
+#include <boost/program_options.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <signal.h>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+#include "fcs-genome/common.h"
+#include "fcs-genome/JvmPool.h"
+
+namespace fcsgenome {
+
+static volatile int jvm_sock = -1;
+static volatile sig_atomic_t jvm_signal = 0;
+
+// dropping the connection makes the pool kill the jvm
+static void jvm_sig_handler(int sig) {
+  jvm_signal = sig;
+  if (jvm_sock >= 0) {
+    ::shutdown(jvm_sock, SHUT_RDWR);
+  }
+}
+
+int jvm_main(int argc, char** argv,
+    boost::program_options::options_description &opt_desc)
+{
+  namespace po = boost::program_options;
+
+  // Define arguments
+  po::variables_map cmd_vm;
+
+  opt_desc.add_options()
+    ("socket,s", po::value<std::string>()->required(), "socket of the jvm pool")
+    ("jar,j", po::value<std::string>()->required(), "jar whose main class runs the arguments after --")
+    ("memory,m", po::value<int>()->default_value(0), "heap memory in gb of the jvm")
+    ("java-opts", po::value<std::string>()->default_value(""), "options of the jvm");
+
+  // the arguments of the tool are not parsed
+  int nopts = argc;
+  for (int i = 1; i < argc; i++) {
+    if (::strcmp(argv[i], "--") == 0) {
+      nopts = i;
+      break;
+    }
+  }
+
+  // Parse arguments
+  po::store(po::parse_command_line(nopts, argv, opt_desc),
+      cmd_vm);
+
+  if (cmd_vm.count("help")) {
+    throw helpRequest();
+  }
+  po::notify(cmd_vm);
+
+  std::vector<std::string> args;
+  for (int i = nopts + 1; i < argc; i++) {
+    // the runner reads the arguments as one line split on tabs
+    if (::strpbrk(argv[i], "\t\n")) {
+      throw invalidParam(argv[i]);
+    }
+    args.push_back(argv[i]);
+  }
+
+  signal(SIGINT,  jvm_sig_handler);
+  signal(SIGTERM, jvm_sig_handler);
+  signal(SIGHUP,  jvm_sig_handler);
+  if (jvm_signal) {
+    return 128 + jvm_signal;
+  }
+
+  int ret = JvmPool::submit(cmd_vm["socket"].as<std::string>(),
+      cmd_vm["jar"].as<std::string>(), cmd_vm["memory"].as<int>(),
+      cmd_vm["java-opts"].as<std::string>(), args,
+      std::cout, std::cerr, &jvm_sock);
+
+  if (jvm_signal) {
+    ret = 128 + jvm_signal;
+  }
+  return ret;
+}
+} // namespace fcsgenome
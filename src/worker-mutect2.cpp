@@ -134,8 +134,9 @@ int mutect2_main(int argc, char** argv,
 
   create_dir(output_dir);
 
-  std::vector<std::string> output_files(get_config<int>("gatk.ncontigs"));
-  std::vector<std::string> filtered_files(get_config<int>("gatk.ncontigs"));
+  std::vector<std::string> output_files;
+  std::vector<std::string> filtered_files;
+  std::vector<int> contigs;
 
   // Defining Interval File :
   std::vector<std::string> intv_paths;
@@ -146,7 +147,13 @@ int mutect2_main(int argc, char** argv,
   // If BAM input is a regular file, post the intervals from Reference: 
   std::vector<std::string> temp_intv;
   if (boost::filesystem::is_regular_file(normal_path) && boost::filesystem::is_regular_file(tumor_path)){
-    temp_intv=init_contig_intv(ref_path);
+    // the tumor usually has the deeper coverage
+    temp_intv=init_contig_intv(ref_path, tumor_path, "mutect2");
+    // each task gets the part of the interval list in its partition
+    if (!intv_list.empty()) {
+      temp_intv = intersect_intv(intv_list, temp_intv, ref_path);
+      intv_paths.clear();
+    }
   }
 
   // start an executor for NAM
@@ -170,6 +177,10 @@ int mutect2_main(int argc, char** argv,
   for (int contig = 0; contig < get_config<int>("gatk.ncontigs"); contig++) {
 
     if (boost::filesystem::is_regular_file(normal_path) && boost::filesystem::is_regular_file(tumor_path)){
+      if (temp_intv[contig].empty()) {
+        DLOG(INFO) << "Skip task " << contig << " without any interval";
+        continue;
+      }
       intv_paths.push_back(temp_intv[contig]);
     }
  
@@ -192,8 +203,9 @@ int mutect2_main(int argc, char** argv,
         flag_mutect2_f,
 	flag_gatk)
     );
-    output_files[contig] = output_file;
-    executor.addTask(mutect2_worker, sample_id, contig == 0);
+    executor.addTask(mutect2_worker, sample_id, output_files.empty());
+    output_files.push_back(output_file);
+    contigs.push_back(contig);
 
     if (boost::filesystem::is_regular_file(normal_path) && boost::filesystem::is_regular_file(tumor_path)){
       intv_paths.pop_back();
@@ -202,19 +214,24 @@ int mutect2_main(int argc, char** argv,
 
   if (flag_gatk || get_config<bool>("use_gatk4") ) {
     std::string filtered_ext = "vcf";
-    for (int contig = 0; contig < get_config<int>("gatk.ncontigs"); contig++) {
-       std::string filtered_file = get_contig_fname(filtered_dir, contig, filtered_ext);
+    for (int i = 0; i < contigs.size(); i++) {
+       std::string filtered_file = get_contig_fname(filtered_dir, contigs[i], filtered_ext);
+       // the intersected list of the task replaces the interval list
+       std::vector<std::string> filter_intv = intv_paths;
+       if (!intv_list.empty() && !temp_intv.empty()) {
+         filter_intv.assign(1, temp_intv[contigs[i]]);
+       }
        Worker_ptr mutect2Filter_worker(new Mutect2FilterWorker(
-    	  intv_paths,
-    	  output_files[contig],
+    	  filter_intv,
+    	  output_files[i],
     	  tumor_table,
     	  filtered_file,
     	  filtering_extra_opts,
           flag_f,
     	  flag_gatk)
        );
-       filtered_files[contig] = filtered_file;
-       executor.addTask(mutect2Filter_worker, sample_id, contig == 0);
+       filtered_files.push_back(filtered_file);
+       executor.addTask(mutect2Filter_worker, sample_id, i == 0);
     }
   }
 
@@ -84,10 +84,15 @@ int ug_main(int argc, char** argv,
   std::vector<std::string> output_files(get_config<int>("gatk.ncontigs"));
   std::vector<std::string> intv_paths;
   if (!intv_list.empty()) {
-    intv_paths = split_by_nprocs(intv_list, "bed");
+    intv_paths = split_intv_by_nprocs(intv_list, ref_path, "bed", input_path, "ug");
+  }
+  else if (boost::filesystem::is_directory(input_path)) {
+    // the contig bams of a folder follow the partitions they were
+    // written with
+    intv_paths = init_folder_intv(ref_path, input_path);
   }
   else {
-    intv_paths = init_contig_intv(ref_path);
+    intv_paths = init_contig_intv(ref_path, input_path, "ug");
   }
 
   Executor executor("Unified Genotyper",get_config<int>("gatk.ug.nprocs", "gatk.nprocs"));
@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 
+#include <boost/filesystem.hpp>
 #include <boost/regex.hpp>
 
 #include "fcs-genome/common.h"
@@ -20,6 +21,7 @@ BQSRWorker::BQSRWorker(std::string ref_path,
       bool &flag_f,
       bool flag_gatk):
   Worker(1, get_config<int>("gatk.bqsr.nct", "gatk.nct"), extra_opts, "Base Recalibration"),
+  split_part_(false),
   ref_path_(ref_path),
   intv_path_(intv_path),
   input_path_(input_path),
@@ -33,10 +35,15 @@ BQSRWorker::BQSRWorker(std::string ref_path,
     << "Current version does not support nct > 1 in BaseRecalibrator, "
     << "resetting it to 1";
   num_thread_ = 1;
+  memory_ = get_config<int>("gatk.bqsr.memory", "gatk.memory");
   output_path_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(input_path);
+  outputs_.push_back(output_path_);
 }
 
 void BQSRWorker::check() {
+  if (split_part_) return;
   namespace fs = boost::filesystem;
   ref_path_   = check_input(ref_path_);
   if (intv_path_.size()>0){
@@ -56,13 +63,10 @@ void BQSRWorker::check() {
 void BQSRWorker::setup() {
   // create cmd
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.bqsr.memory", "gatk.memory") << "g ";
-
   if (flag_gatk_ || get_config<bool>("use_gatk4")) {
-      cmd << "-jar " << get_config<std::string>("gatk4_path") << " BaseRecalibrator ";
+      cmd << java_cmd(get_config<std::string>("gatk4_path"), "bqsr") << " BaseRecalibrator ";
   } else {
-      cmd << "-jar " << get_config<std::string>("gatk_path") << " -T BaseRecalibrator ";
+      cmd << java_cmd(get_config<std::string>("gatk_path"), "bqsr") << " -T BaseRecalibrator ";
   }
 
   cmd << "-R " << ref_path_ << " ";
@@ -108,11 +112,52 @@ void BQSRWorker::setup() {
   DLOG(INFO) << cmd_;
 }
 
+// split the last interval list and gather the reports of each part
+bool BQSRWorker::split(int n, 
+    std::vector<Worker_ptr> &parts, 
+    Worker_ptr &merge) 
+{
+  if (intv_path_.empty()) {
+    return false;
+  }
+  boost::filesystem::path output(output_path_);
+  std::string prefix = (output.parent_path() / 
+                        ("spec." + output.filename().string())).string();
+
+  std::vector<std::string> intv_parts = split_intv_by_length(
+      intv_path_.back(), n, prefix);
+  if (intv_parts.size() < 2) {
+    return false;
+  }
+
+  std::vector<std::string> part_outputs;
+  for (int i = 0; i < intv_parts.size(); i++) {
+    BQSRWorker* part = new BQSRWorker(*this);
+    part->split_part_  = true;
+    part->output_path_ = (output.parent_path() / ("spec-" + 
+        std::to_string((long long)i) + "." + output.filename().string())).string();
+    part->intv_path_.push_back(intv_parts[i]);
+    part->outputs_ = std::vector<std::string>(1, part->output_path_);
+    part_outputs.push_back(part->output_path_);
+    parts.push_back(Worker_ptr(part));
+  }
+
+  bool flag_f = true;
+  merge.reset(new BQSRGatherWorker(part_outputs, prefix, 
+      flag_f, flag_gatk_));
+
+  return true;
+}
+
 BQSRGatherWorker::BQSRGatherWorker(std::vector<std::string> &input_files,
   std::string output_file, bool &flag_f, bool flag_gatk): Worker(1, 1, std::vector<std::string>(),"Gathering BQSR Reports"),
   input_files_(input_files),flag_gatk_(flag_gatk)
 {
   output_file_ = check_output(output_file, flag_f);
+  memory_ = get_config<int>("gatk.bqsr.memory", "gatk.memory");
+
+  inputs_ = input_files;
+  outputs_.push_back(output_file_);
 }
 
 void BQSRGatherWorker::check() {
@@ -125,9 +170,7 @@ void BQSRGatherWorker::setup() {
   // create cmd
   std::stringstream cmd;
   if (flag_gatk_ || get_config<bool>("use_gatk4")){
-      cmd << get_config<std::string>("java_path") << " "
-          << "-Xmx" << get_config<int>("gatk.bqsr.memory", "gatk.memory") << "g "
-          << "-jar " << get_config<std::string>("gatk4_path") << " "
+      cmd << java_cmd(get_config<std::string>("gatk4_path"), "bqsr") << " "
           << "GatherBQSRReports ";
       for (int i = 0; i < input_files_.size(); i++) {
           cmd << "-I " << input_files_[i] << " ";
@@ -156,14 +199,16 @@ PRWorker::PRWorker(std::string ref_path,
       std::string output_path,
       std::vector<std::string> extra_opts,
       int  contig,
-      bool &flag_f, bool flag_gatk):
+      bool &flag_f, bool flag_gatk,
+      bool empty_region):
   Worker(1, get_config<int>("gatk.pr.nct", "gatk.nct"), extra_opts, "PrintReads"),
   ref_path_(ref_path),
   intv_path_(intv_path),
   bqsr_path_(bqsr_path),
   input_path_(input_path),
   contig_(contig),
-  flag_gatk_(flag_gatk)
+  flag_gatk_(flag_gatk),
+  empty_region_(empty_region)
 {
   LOG_IF_EVERY_N(WARNING,  
                  get_config<int>("gatk.bqsr.nct", "gatk.nct") > 1,
@@ -172,9 +217,14 @@ PRWorker::PRWorker(std::string ref_path,
     << ((flag_gatk_ || get_config<bool>("use_gatk4")) ? "ApplyBQSR" : "PrintReads")
     << ", resetting it to 1";
   num_thread_ = 1;
+  memory_ = get_config<int>("gatk.pr.memory", "gatk.memory");
 
   // check output files
   output_path_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(bqsr_path);
+  inputs_.push_back(input_path);
+  outputs_.push_back(output_path_);
 }
 
 void PRWorker::check() {
@@ -209,8 +259,8 @@ void PRWorker::check() {
         // In this approach, these cases are possible: 
         // 1) Interval file from the splitting of the reference. It has part-XXXXX.list as format. 
         //    Always present if BAM input is a single file.
-        // 2) If defined Interval capture file defined by user, it will be always element 0, and 
-        //    interval file from reference will be element 1. 
+        // 2) If defined Interval capture file defined by user, it is intersected with the
+        //    interval file from reference beforehand, the result keeps the part-XXXXX.list format.
 	for (auto a: intv_path_){
 	  if (boost::filesystem::exists(a)) {
 	    for (int k=0; k<2; k++){
@@ -230,13 +280,21 @@ void PRWorker::check() {
 void PRWorker::setup() {
   // create cmd
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.pr.memory", "gatk.memory") << "g ";
-
+  if (empty_region_) {
+    // the header alone, since gatk fails on an empty interval set
+    std::string samtools = get_config<std::string>("samtools_path");
+    cmd << samtools << " view -b -H -o " << output_path_ << " "
+        << input_path_.getInfo().bam_name << " && "
+        << samtools << " index " << output_path_ << " "
+        << get_fname_by_ext(output_path_, "bai");
+    cmd_ = cmd.str();
+    DLOG(INFO) << cmd_;
+    return;
+  }
   if (flag_gatk_ || get_config<bool>("use_gatk4")) {
-      cmd << "-jar " << get_config<std::string>("gatk4_path") << " ApplyBQSR ";
+      cmd << java_cmd(get_config<std::string>("gatk4_path"), "pr") << " ApplyBQSR ";
   } else {
-      cmd << "-jar " << get_config<std::string>("gatk_path") << " -T PrintReads ";
+      cmd << java_cmd(get_config<std::string>("gatk_path"), "pr") << " -T PrintReads ";
   }
 
   cmd << "-R " << ref_path_ << " ";
@@ -1,4 +1,5 @@
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 #include <string>
 #include <sys/statvfs.h>
 #include <bits/stdc++.h> 
@@ -28,7 +29,9 @@ BWAWorker::BWAWorker(std::string ref_path,
   Worker(get_config<bool>("bwa.scaleout_mode") || 
          get_config<bool>("latency_mode") 
          ? conf_host_list.size() : 1, 
-         1, extra_opts, "bwa mem"),
+         get_config<int>("bwa.nt") > 0 ? get_config<int>("bwa.nt") :
+         boost::thread::hardware_concurrency(),
+         extra_opts, "bwa mem"),
   ref_path_(ref_path),
   fq1_path_(fq1_path),
   fq2_path_(fq2_path),
@@ -42,7 +45,12 @@ BWAWorker::BWAWorker(std::string ref_path,
   flag_merge_bams_(flag_merge_bams),
   flag_f_(flag_f)
 {
-  ;
+  inputs_.push_back(fq1_path);
+  inputs_.push_back(fq2_path);
+  outputs_.push_back(partdir_path);
+  if (flag_merge_bams) {
+    outputs_.push_back(output_path);
+  }
 }
 
 void BWAWorker::check() {
@@ -112,15 +120,16 @@ void BWAWorker::setup() {
          * Source: 
          * http://users.open-mpi.narkive.com/7efFnJXR/ompi-users-device-failed-to-appear-connection-timed-out
          */
+    std::vector<std::string> host_list = hosts();
     cmd << "--mca pml ob1 "
         << "--allow-run-as-root "
-        << "-np " << conf_host_list.size() << " ";
+        << "-np " << host_list.size() << " ";
 
     // set host list
     cmd << "--host ";
-    for (int i = 0; i < conf_host_list.size(); i++) {
-      cmd << conf_host_list[i];
-      if (i < conf_host_list.size() - 1) {
+    for (int i = 0; i < host_list.size(); i++) {
+      cmd << host_list[i];
+      if (i < host_list.size() - 1) {
         cmd << ",";
       }
       else {
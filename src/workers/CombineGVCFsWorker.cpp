@@ -45,6 +45,15 @@ CombineGVCFsWorker::CombineGVCFsWorker(
 
   temp_dir_ = conf_temp_dir + "/joint";
   create_dir(temp_dir_);
+
+  inputs_.push_back(input_path_);
+  if (flag_gatk_ || get_config<bool>("use_gatk4")) {
+    memory_ = 64;
+    outputs_.push_back(database_name_);
+  }
+  else {
+    outputs_.push_back(output_path_);
+  }
 }
 
 void CombineGVCFsWorker::genVid() {
@@ -317,10 +326,7 @@ void CombineGVCFsWorker::setup() {
   // create cmd
   std::stringstream cmd;
   if (flag_gatk_ || get_config<bool>("use_gatk4")) {
-    cmd << get_config<std::string>("java_path") << " "
-	<< "-Xmx" << 64 << "g ";
-
-    cmd << "-jar " << get_config<std::string>("gatk4_path") << " GenomicsDBImport ";
+    cmd << java_cmd(get_config<std::string>("gatk4_path"), "combine") << " GenomicsDBImport ";
     for (auto file : input_files_) {
        cmd << " -V " << file; 
     }
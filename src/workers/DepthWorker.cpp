@@ -27,8 +27,13 @@ DepthWorker::DepthWorker(std::string ref_path,
   flag_intervalCoverage_(flag_intervalCoverage),
   flag_sampleSummary_(flag_sampleSummary)
 {
+  memory_ = get_config<int>("gatk.depth.memory", "gatk.memory");
+
   // check input/output files
   output_path_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(input_path);
+  outputs_.push_back(output_path_);
 }
 
 void DepthWorker::check() {
@@ -46,9 +51,7 @@ void DepthWorker::check() {
 void DepthWorker::setup() {
   // create cmd
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.depth.memory", "gatk.memory") << "g "
-      << "-jar " << get_config<std::string>("gatk_path") << " "
+  cmd << java_cmd(get_config<std::string>("gatk_path"), "depth") << " "
       << "-T DepthOfCoverage "
       << "-R " << ref_path_ << " "
       << "-I " << input_path_ << " ";
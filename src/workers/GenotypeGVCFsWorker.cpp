@@ -18,7 +18,14 @@ GenotypeGVCFsWorker::GenotypeGVCFsWorker(
   input_path_(input_path),
   flag_gatk_(flag_gatk)
 {
+  memory_ = get_config<int>("gatk.genotype.memory");
   output_path_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(input_path);
+  if (boost::ends_with(input_path, ".gz")) {
+    inputs_.push_back(input_path + ".tbi");
+  }
+  outputs_.push_back(output_path_);
 }
 
 void GenotypeGVCFsWorker::check() {
@@ -29,18 +36,15 @@ void GenotypeGVCFsWorker::check() {
 void GenotypeGVCFsWorker::setup() {
   // create cmd
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.genotype.memory") << "g ";
-
   if (flag_gatk_ || get_config<bool>("use_gatk4")) {
-    cmd << "-jar " << get_config<std::string>("gatk4_path") << " "
+    cmd << java_cmd(get_config<std::string>("gatk4_path"), "genotype") << " "
         << " GenotypeGVCFs "
         << " -R " << ref_path_ << " " 
         << " -V gendb://" << input_path_ << " -G StandardAnnotation " 
         << " -O " << output_path_ ; 
   }
   else{
-    cmd << "-jar " << get_config<std::string>("gatk_path") << " "
+    cmd << java_cmd(get_config<std::string>("gatk_path"), "genotype") << " "
         << "-T GenotypeGVCFs "
         << "-R " << ref_path_ << " "
         << "--variant " << input_path_ << " "
@@ -1,3 +1,5 @@
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -6,6 +8,7 @@
 #include "fcs-genome/common.h"
 #include "fcs-genome/config.h"
 #include "fcs-genome/workers/HTCWorker.h"
+#include "fcs-genome/workers/VCFUtilsWorker.h"
 
 namespace fcsgenome {
 
@@ -22,6 +25,7 @@ HTCWorker::HTCWorker(std::string ref_path,
   Worker(1, get_config<int>("gatk.htc.nct", "gatk.nct"), 
       extra_opts, 
       "HaplotypeCaller"),
+  split_part_(false),
   contig_(contig),
   produce_vcf_(flag_vcf),
   flag_gatk_(flag_gatk),
@@ -30,10 +34,19 @@ HTCWorker::HTCWorker(std::string ref_path,
   input_paths_(input_paths),
   output_path_(output_path)
 {
+  memory_ = get_config<int>("gatk.htc.memory", "gatk.memory");
   output_path_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(input_paths);
+  if (boost::ends_with(input_paths, ".bam")) {
+    // wait for the index of a bam produced in the same run
+    inputs_.push_back(input_paths + ".bai");
+  }
+  outputs_.push_back(output_path_);
 }
 
 void HTCWorker::check() {
+  if (split_part_) return;
   ref_path_  = check_input(ref_path_);
   if (intv_paths_.size()>0){  
     for (auto path : intv_paths_){
@@ -48,13 +61,10 @@ void HTCWorker::check() {
 void HTCWorker::setup() {
   // create cmd
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.htc.memory", "gatk.memory") << "g ";
-
   if (flag_gatk_ || get_config<bool>("use_gatk4") ) {
-    cmd << "-jar " << get_config<std::string>("gatk4_path") << " HaplotypeCaller ";
+    cmd << java_cmd(get_config<std::string>("gatk4_path"), "htc") << " HaplotypeCaller ";
   } else {
-    cmd << "-jar " << get_config<std::string>("gatk_path") << " -T HaplotypeCaller ";
+    cmd << java_cmd(get_config<std::string>("gatk_path"), "htc") << " -T HaplotypeCaller ";
   }
 
   cmd << " -R " << ref_path_    << " ";
@@ -112,4 +122,45 @@ void HTCWorker::setup() {
   DLOG(INFO) << cmd_;
 }
 
+// split the last interval list, which is the partition when the
+// input is a single bam, and concat the vcf of each part
+bool HTCWorker::split(int n, 
+    std::vector<Worker_ptr> &parts, 
+    Worker_ptr &merge) 
+{
+  // bcftools concat is only used for uncompressed parts
+  if (intv_paths_.empty() || boost::ends_with(output_path_, ".gz")) {
+    return false;
+  }
+  boost::filesystem::path output(output_path_);
+  std::string prefix = (output.parent_path() / 
+                        ("spec." + output.filename().string())).string();
+
+  std::vector<std::string> intv_parts = split_intv_by_length(
+      intv_paths_.back(), n, prefix);
+  if (intv_parts.size() < 2) {
+    return false;
+  }
+
+  std::vector<std::string> part_outputs;
+  for (int i = 0; i < intv_parts.size(); i++) {
+    HTCWorker* part = new HTCWorker(*this);
+    part->split_part_  = true;
+    part->output_path_ = (output.parent_path() / ("spec-" + 
+        std::to_string((long long)i) + "." + output.filename().string())).string();
+    part->intv_paths_.push_back(intv_parts[i]);
+    part->outputs_ = std::vector<std::string>(1, part->output_path_);
+    part_outputs.push_back(part->output_path_);
+    parts.push_back(Worker_ptr(part));
+  }
+
+  bool flag_a = false;
+  bool flag_bgzip = false;
+  bool flag_f = true;
+  merge.reset(new VCFConcatWorker(part_outputs, prefix,
+      flag_a, flag_bgzip, flag_f));
+
+  return true;
+}
+
 } // namespace fcsgenome
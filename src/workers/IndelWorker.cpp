@@ -17,7 +17,11 @@ RTCWorker::RTCWorker(std::string ref_path,
   input_path_(input_path)
 {
   bool flag = true;
+  memory_ = get_config<int>("gatk.rtc.memory");
   output_path_ = check_output(output_path, flag);
+
+  inputs_.push_back(input_path);
+  outputs_.push_back(output_path_);
 }
 
 void RTCWorker::check() {
@@ -39,9 +43,7 @@ void RTCWorker::check() {
 void RTCWorker::setup() {
   // create cmd
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.rtc.memory") << "g "
-      << "-jar " << get_config<std::string>("gatk_path") << " "
+  cmd << java_cmd(get_config<std::string>("gatk_path"), "rtc") << " "
       << "-T RealignerTargetCreator "
       << "-R " << ref_path_ << " "
       << "-nt " << get_config<int>("gatk.rtc.nt") << " "
@@ -75,7 +77,12 @@ IndelWorker::IndelWorker(std::string ref_path,
   input_path_(input_path),
   target_path_(target_path)
 {
+  memory_ = get_config<int>("gatk.indel.memory", "gatk.memory");
   output_path_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(input_path);
+  inputs_.push_back(target_path);
+  outputs_.push_back(output_path_);
 }
 
 void IndelWorker::check() {
@@ -92,9 +99,7 @@ void IndelWorker::check() {
 void IndelWorker::setup() {
   
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.indel.memory", "gatk.memory") << "g "
-      << "-jar " << get_config<std::string>("gatk_path") << " "
+  cmd << java_cmd(get_config<std::string>("gatk_path"), "indel") << " "
       << "-T IndelRealigner "
       << "-R " << ref_path_ << " "
       << "-L " << intv_path_ << " "
@@ -15,6 +15,10 @@ MarkdupWorker::MarkdupWorker(std::string input_path,
   output_file_ = check_output(output_path, flag_f, true);
   std::string bai_file = check_output(output_path + ".bai", flag_f, true);
   input_path_ = input_path;
+
+  inputs_.push_back(input_path_);
+  outputs_.push_back(output_file_);
+  outputs_.push_back(bai_file);
 }
 
 void MarkdupWorker::check() {
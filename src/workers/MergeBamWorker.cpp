@@ -15,6 +15,9 @@ MergeBamWorker::MergeBamWorker(std::string inputPartsBAM, std::string outputBAM,
   output_file_   = check_output(outputBAM, flag_f, true);
   inputPartsBAM_ = inputPartsBAM;
   check_parts_ = check_parts;
+
+  inputs_.push_back(inputPartsBAM_);
+  outputs_.push_back(output_file_);
 }
 
 void MergeBamWorker::setup() {
@@ -1,4 +1,5 @@
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 #include <string>
 #include <sys/statvfs.h>
 #include <bits/stdc++.h> 
@@ -25,7 +26,9 @@ Minimap2Worker::Minimap2Worker(std::string ref_path,
       std::string library_id,
       bool flag_merge_bams,
       bool &flag_f):
-  Worker(1, 1, extra_opts, "minimap-flow"),
+  Worker(1, get_config<int>("minimap.nt") > 0 ? get_config<int>("minimap.nt") :
+         boost::thread::hardware_concurrency(),
+         extra_opts, "minimap-flow"),
   ref_path_(ref_path),
   fq1_path_(fq1_path),
   fq2_path_(fq2_path),
@@ -46,6 +49,12 @@ Minimap2Worker::Minimap2Worker(std::string ref_path,
       library_id.empty()) {
     throw invalidParam("Invalid @RG info");
   }
+  inputs_.push_back(fq1_path);
+  inputs_.push_back(fq2_path);
+  outputs_.push_back(partdir_path);
+  if (flag_merge_bams) {
+    outputs_.push_back(output_path);
+  }
 }
 
 void Minimap2Worker::check() {
@@ -24,8 +24,16 @@ Mutect2FilterWorker::Mutect2FilterWorker(
   output_path_(output_path),
   flag_gatk_(flag_gatk)
 {
+  memory_ = get_config<int>("gatk.mutect2.memory", "gatk.memory");
+
   // check input/output files
   output_path_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(input_path);
+  if (!tumor_table.empty()) {
+    inputs_.push_back(tumor_table);
+  }
+  outputs_.push_back(output_path_);
 }
 
 void Mutect2FilterWorker::check() {
@@ -39,9 +47,7 @@ void Mutect2FilterWorker::check() {
 void Mutect2FilterWorker::setup() {
   // create cmd
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.mutect2.memory", "gatk.memory") << "g " 
-      << "-jar " << get_config<std::string>("gatk4_path") << " FilterMutectCalls "
+  cmd << java_cmd(get_config<std::string>("gatk4_path"), "mutect2") << " FilterMutectCalls "
       << "-V "   << input_path_   << " "  ;
   
   std::string test = input_path_;
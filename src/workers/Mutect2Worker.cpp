@@ -39,8 +39,14 @@ Mutect2Worker::Mutect2Worker(std::string ref_path,
   contig_(contig),
   flag_gatk_(flag_gatk)
 {
+  memory_ = get_config<int>("gatk.mutect2.memory", "gatk.memory");
+
   // check input/output files
   output_path_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(normal_path);
+  inputs_.push_back(tumor_path);
+  outputs_.push_back(output_path_);
 }
 
 void Mutect2Worker::check() {
@@ -70,11 +76,12 @@ void Mutect2Worker::check() {
   }
 
   BamInputInfo normal_data_ = normal_path_.getInfo();
-  normal_data_ = normal_path_.merge_region(contig_);
+  // both folders are grouped alike so that their regions match
+  normal_data_ = normal_path_.merge_region(contig_, &tumor_path_);
   normal_data_.bam_name = check_input(normal_data_.bam_name);
 
   BamInputInfo tumor_data_ = tumor_path_.getInfo();
-  tumor_data_ = tumor_path_.merge_region(contig_);
+  tumor_data_ = tumor_path_.merge_region(contig_, &normal_path_);
   tumor_data_.bam_name = check_input(tumor_data_.bam_name);
 
   // Compare if sets of part BED files are the same:
@@ -110,14 +117,11 @@ void Mutect2Worker::setup() {
 
   // create cmd
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.mutect2.memory", "gatk.memory") << "g ";
-
   if (flag_gatk_ || get_config<bool>("use_gatk4") ) {
-    cmd << "-jar " << get_config<std::string>("gatk4_path") << " Mutect2 ";
+    cmd << java_cmd(get_config<std::string>("gatk4_path"), "mutect2") << " Mutect2 ";
   }
   else{
-    cmd << "-jar " << get_config<std::string>("gatk_path") << " -T MuTect2 ";
+    cmd << java_cmd(get_config<std::string>("gatk_path"), "mutect2") << " -T MuTect2 ";
   }
 
   cmd << "-R " << ref_path_ << " ";
@@ -35,7 +35,27 @@ SambambaWorker::SambambaWorker(std::string input_path,
        flag_f_(flag_f), input_files_(files), output_file_(output_path),
        input_path_(input_path), action_(action), common_(common)
 {
-  ;
+  inputs_ = files;
+  inputs_.push_back(input_path_);
+  switch (action_) {
+  case INDEX:
+    outputs_.push_back(input_path_ + ".bai");
+    break;
+  case SORT:
+    // sorting without an output path replaces the input
+    if (output_file_.empty()) {
+      outputs_.push_back(input_path_);
+      outputs_.push_back(get_fname_by_ext(input_path_, "bai"));
+    }
+    else {
+      outputs_.push_back(output_file_);
+      outputs_.push_back(get_fname_by_ext(output_file_, "bai"));
+    }
+    break;
+  default:
+    outputs_.push_back(output_file_);
+    outputs_.push_back(output_file_ + ".bai");
+  }
 }
 
 void SambambaWorker::check() {
@@ -18,7 +18,11 @@ UGWorker::UGWorker(std::string ref_path,
   input_path_(input_path),
   intv_path_(intv_path)
 {
+  memory_ = get_config<int>("gatk.ug.memory");
   output_path_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(input_path);
+  outputs_.push_back(output_path_);
 }
 
 void UGWorker::check() {
@@ -30,9 +34,7 @@ void UGWorker::check() {
 void UGWorker::setup() {
   // create cmd
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.ug.memory") << "g "
-      << "-jar " << get_config<std::string>("gatk_path") << " "
+  cmd << java_cmd(get_config<std::string>("gatk_path"), "ug") << " "
       << "-T UnifiedGenotyper "
       << "-R " << ref_path_ << " "
       << "-L " << intv_path_ << " "
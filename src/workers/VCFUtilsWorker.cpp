@@ -16,6 +16,22 @@ VCFConcatWorker::VCFConcatWorker(
 {
   // check output files
   output_file_ = check_output(output_path, flag_f);
+
+  for (int i = 0; i < input_files.size(); i++) {
+    if (flag_bgzip_) {
+      // inputs are compressed and indexed in place
+      outputs_.push_back(input_files[i]);
+      outputs_.push_back(input_files[i] + ".gz");
+      outputs_.push_back(input_files[i] + ".gz.tbi");
+    }
+    else {
+      inputs_.push_back(input_files[i]);
+      if (boost::ends_with(input_files[i], ".gz")) {
+        inputs_.push_back(input_files[i] + ".tbi");
+      }
+    }
+  }
+  outputs_.push_back(output_file_);
 }
 
 void VCFConcatWorker::check() {
@@ -58,6 +74,9 @@ ZIPWorker::ZIPWorker(
 {
   input_file_  = input_path;
   output_file_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(input_file_);
+  outputs_.push_back(output_file_);
 }
 
 void ZIPWorker::check() {
@@ -83,6 +102,9 @@ TabixWorker::TabixWorker(
  ): Worker(1, 1, std::vector<std::string>(), "Generating VCF Index")
 {
   path_  = path;
+
+  inputs_.push_back(path_);
+  outputs_.push_back(path_ + ".tbi");
 }
 
 void TabixWorker::check() {
@@ -26,8 +26,13 @@ VariantsFilterWorker::VariantsFilterWorker(std::string ref_path,
   filter_par_(filter_par),
   filter_name_(filter_name)
 {
+  memory_ = get_config<int>("gatk.htc.memory", "gatk.memory");
+
   // check input/output files
   output_path_ = check_output(output_path, flag_f);
+
+  inputs_.push_back(input_path);
+  outputs_.push_back(output_path_);
 }
 
 void VariantsFilterWorker::check() {
@@ -40,13 +45,10 @@ void VariantsFilterWorker::setup() {
 
   // create cmd
   std::stringstream cmd;
-  cmd << get_config<std::string>("java_path") << " "
-      << "-Xmx" << get_config<int>("gatk.htc.memory", "gatk.memory") << "g ";
-
   if (flag_gatk_ || get_config<bool>("use_gatk4") ) {
-      cmd << "-jar " << get_config<std::string>("gatk4_path") << " VariantFiltration ";
+      cmd << java_cmd(get_config<std::string>("gatk4_path"), "htc") << " VariantFiltration ";
   } else {
-      cmd << "-jar " << get_config<std::string>("gatk_path") << " -T VariantFiltration ";
+      cmd << java_cmd(get_config<std::string>("gatk_path"), "htc") << " -T VariantFiltration ";
   }
 
   cmd << "-R " << ref_path_ << " " 
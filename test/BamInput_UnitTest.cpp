@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "fcs-genome/BamInput.h"
+#include "fcs-genome/config.h"
 #include "BamInput_UnitTest.h"
 
 namespace fcs = fcsgenome;
@@ -27,7 +28,22 @@ class QuickTest : public testing::Test {
 };
 
 class TestBamInputClass : public QuickTest {
-
+ protected:
+  // the tests set their own partitions, and the ones of the other
+  // tests are restored after
+  virtual void SetUp() {
+    QuickTest::SetUp();
+    if (fcs::config_vtable.count("gatk.ncontigs")) {
+      ncontigs_ = fcs::config_vtable.at("gatk.ncontigs");
+    }
+  }
+  virtual void TearDown() {
+    fcs::config_vtable.erase("gatk.ncontigs");
+    if (!ncontigs_.empty()) {
+      fcs::config_vtable.insert(std::make_pair("gatk.ncontigs", ncontigs_));
+    }
+  }
+  boost::program_options::variable_value ncontigs_;
 };
 
 // Assuming the input is a BAM file: 
@@ -64,8 +80,76 @@ TEST_F(TestBamInputClass, CheckBamInputAsFolder) {
   EXPECT_STREQ(BamInputPath.c_str(), BamData.bam_name.c_str());
   ASSERT_TRUE(BamData.bam_isdir);
 
-  remove_string(BamInputPath);
+  remove_folder(BamInputPath);
   BamInputPath.clear();
+}
+
+// Buckets are grouped by size into ncontigs contiguous groups:
+TEST_F(TestBamInputClass, GroupBucketsBySize) {
+  namespace po = boost::program_options;
+  fcs::config_vtable.erase("gatk.ncontigs");
+  fcs::config_vtable.insert(std::make_pair("gatk.ncontigs",
+      po::variable_value(boost::any(2), false)));
+
+  std::stringstream ss;
+  ss << "/tmp/BamInput_UnitTest." << fcs::getTid();
+  std::string BamInputPath = ss.str();
+  create_bamdir(BamInputPath);
+
+  // the last bucket is as large as the others together
+  int sizes[5] = {100, 100, 100, 100, 400};
+  for (int i = 0; i < 5; i++) {
+    std::ofstream outfile(fcs::get_bucket_fname(BamInputPath, i));
+    outfile << std::string(sizes[i], 'x');
+    outfile.close();
+    outfile.open(fcs::get_bucket_fname(BamInputPath, i, "part", ".bed"));
+    outfile << "chr1\t" << i * 100 << "\t" << (i + 1) * 100 << std::endl;
+    outfile.close();
+  }
+
+  fcs::BamInput MyBam(BamInputPath);
+  fcs::BamInputInfo BamData = MyBam.merge_region(0);
+  ASSERT_EQ(4, BamData.partsBAM[0].size());
+  ASSERT_EQ(1, BamData.mergedREGION.size());
+  std::vector<std::string> expected = {"chr1\t0\t100", "chr1\t100\t200",
+      "chr1\t200\t300", "chr1\t300\t400"};
+  ASSERT_EQ(expected, fcs::get_lines(BamData.mergedREGION[0]));
+
+  // no bucket is left out, and the manifest records each of them
+  std::vector<fcs::BamBucket> buckets = MyBam.getBuckets();
+  ASSERT_EQ(5, buckets.size());
+  EXPECT_EQ(400, buckets[4].bytes);
+  EXPECT_EQ(-1, buckets[4].reads);
+
+  fcs::BamInput OtherBam(BamInputPath);
+  BamData = OtherBam.merge_region(1);
+  ASSERT_EQ(1, BamData.partsBAM[1].size());
+  EXPECT_EQ(fcs::get_bucket_fname(BamInputPath, 4), BamData.partsBAM[1][0]);
+  EXPECT_EQ(fcs::get_bucket_fname(BamInputPath, 4, "part", ".bed"), 
+      BamData.mergedREGION[0]);
+
+  // the merged region of group 0 is reused, not written again
+  std::string merged = MyBam.getInfo().mergedREGION[0];
+  std::ofstream outfile(merged, std::ofstream::app);
+  outfile << "chr2\t0\t100" << std::endl;
+  outfile.close();
+  fcs::BamInput SameBam(BamInputPath);
+  ASSERT_EQ(merged, SameBam.merge_region(0).mergedREGION[0]);
+  ASSERT_EQ(5, fcs::get_lines(merged).size());
+
+  // new contents get a new manifest, and the old one is removed
+  outfile.open(fcs::get_bucket_fname(BamInputPath, 0));
+  outfile << std::string(300, 'x');
+  outfile.close();
+  fcs::BamInput NewBam(BamInputPath);
+  BamData = NewBam.merge_region(0);
+  ASSERT_EQ(3, BamData.partsBAM[0].size());
+  ASSERT_NE(merged, BamData.mergedREGION[0]);
+  std::vector<std::string> manifests;
+  fcs::get_input_list(BamInputPath + "/.fcs-buckets", manifests, 
+      ".*/manifest", true);
+  ASSERT_EQ(1, manifests.size());
+
   remove_folder(BamInputPath);
 }
 
@@ -1,9 +1,13 @@
 #include <iostream>
 #include <fstream>
 #include <gtest/gtest.h>
+#include <zlib.h>
 
+#include "fcs-genome/BamIndex.h"
 #include "fcs-genome/common.h"
 #include "fcs-genome/config.h"
+#include "fcs-genome/NumaTopology.h"
+#include "fcs-genome/RefPartition.h"
 
 namespace fcs = fcsgenome;
 class TestConfig : public ::testing::Test {
@@ -34,6 +38,12 @@ TEST_F(TestConfig, DefaultValues) {
   ASSERT_TRUE(fcs::config_vtable.count("temp_dir"));
   ASSERT_TRUE(fcs::config_vtable.count("log_dir"));
   ASSERT_TRUE(fcs::config_vtable.count("gatk.nprocs"));
+
+  // partitions of existing runs do not change unless asked for
+  ASSERT_EQ("length", fcs::get_config<std::string>("gatk.partition"));
+
+  // tasks are not pinned to numa nodes unless asked for
+  ASSERT_FALSE(fcs::get_config<bool>("executor.numa"));
 }
 
 TEST_F(TestConfig, GATKNprocs) {
@@ -100,6 +110,382 @@ TEST_F(TestConfig, AutoTuneNprocsMemory) {
   ASSERT_EQ(8, memory);
 }
 
+TEST_F(TestConfig, SplitIntervalsByLength) {
+
+  std::stringstream prefix;
+  prefix << "/tmp/TestConfig." << fcs::getTid();
+  std::string intv_path = prefix.str() + ".bed";
+
+  // 300 bases in two bed intervals
+  std::ofstream fout(intv_path);
+  fout << "chr1\t0\t100" << std::endl;
+  fout << "chr2\t100\t300" << std::endl;
+  fout.close();
+
+  std::vector<std::string> parts = fcs::split_intv_by_length(
+      intv_path, 3, prefix.str());
+  ASSERT_EQ(3, parts.size());
+
+  std::vector<std::string> expected = {"chr1:1-100", "chr2:101-200", "chr2:201-300"};
+  for (int i = 0; i < parts.size(); i++) {
+    std::ifstream fin(parts[i]);
+    std::string line;
+    std::getline(fin, line);
+    ASSERT_EQ(expected[i], line);
+    fcs::remove_path(parts[i]);
+  }
+
+  // intervals without bounds cannot be split
+  fout.open(intv_path);
+  fout << "chr1" << std::endl;
+  fout.close();
+  ASSERT_TRUE(fcs::split_intv_by_length(intv_path, 3, prefix.str()).empty());
+
+  fcs::remove_path(intv_path);
+}
+
+TEST_F(TestConfig, SplitIntervalsByNprocs) {
+  namespace po = boost::program_options;
+  fcs::config_vtable.insert(std::make_pair("gatk.ncontigs",
+      po::variable_value(boost::any(2), false)));
+  fcs::config_vtable.insert(std::make_pair("gatk.partition",
+      po::variable_value(boost::any(std::string("length")), false)));
+  fcs::config_vtable.insert(std::make_pair("gatk.intv.padding",
+      po::variable_value(boost::any(0), false)));
+
+  std::stringstream prefix;
+  prefix << "/tmp/TestConfig." << fcs::getTid();
+  std::string ref_path = prefix.str() + ".fasta";
+  std::string intv_path = prefix.str() + ".bed";
+
+  std::ofstream fout(ref_path);
+  fout.close();
+  fout.open(prefix.str() + ".dict");
+  fout << "@SQ\tSN:chr1\tLN:1000" << std::endl;
+  fout << "@SQ\tSN:chr2\tLN:1000" << std::endl;
+  fout.close();
+
+  // unsorted, overlapping and adjacent, 500 bases once merged
+  fout.open(intv_path);
+  fout << "track name=targets" << std::endl;
+  fout << "chr2\t0\t100" << std::endl;
+  fout << "chr1:1-50" << std::endl;
+  fout << "chr1\t40\t300" << std::endl;
+  fout << "chr1:301-400" << std::endl;
+  fout.close();
+
+  std::vector<std::string> parts = fcs::split_intv_by_nprocs(
+      intv_path, ref_path, "bed");
+  ASSERT_EQ(2, parts.size());
+  std::vector<std::vector<std::string> > expected = {
+      {"chr1\t0\t250"}, {"chr1\t250\t400", "chr2\t0\t100"}};
+  for (int i = 0; i < parts.size(); i++) {
+    ASSERT_EQ(expected[i], fcs::get_lines(parts[i]));
+  }
+  std::string list_path = fcs::get_fname_by_ext(parts[1], "list");
+  expected[1] = {"chr1:251-400", "chr2:1-100"};
+  ASSERT_EQ(expected[1], fcs::get_lines(list_path));
+
+  // padding is clipped to the contig
+  fcs::config_vtable.at("gatk.intv.padding").value() = 900;
+  parts = fcs::split_intv_by_nprocs(intv_path, ref_path, "list");
+  expected = {{"chr1:1-1000"}, {"chr2:1-1000"}};
+  for (int i = 0; i < parts.size(); i++) {
+    ASSERT_EQ(expected[i], fcs::get_lines(parts[i]));
+  }
+
+  fcs::remove_path(fcs::contig_intv_dir());
+  fcs::remove_path(ref_path);
+  fcs::remove_path(prefix.str() + ".dict");
+  fcs::remove_path(intv_path);
+}
+
+TEST_F(TestConfig, IntersectIntervals) {
+  namespace po = boost::program_options;
+  fcs::config_vtable.insert(std::make_pair("gatk.ncontigs",
+      po::variable_value(boost::any(3), false)));
+
+  std::stringstream prefix;
+  prefix << "/tmp/TestConfig." << fcs::getTid();
+  std::string ref_path = prefix.str() + ".fasta";
+  std::string intv_path = prefix.str() + ".bed";
+
+  std::ofstream fout(ref_path);
+  fout.close();
+  fout.open(prefix.str() + ".dict");
+  fout << "@SQ\tSN:chr1\tLN:1000" << std::endl;
+  fout << "@SQ\tSN:chr2\tLN:1000" << std::endl;
+  fout.close();
+
+  fout.open(intv_path);
+  fout << "chr2\t0\t100" << std::endl;
+  fout << "chr1:101-200" << std::endl;
+  fout << "chr1\t150\t600" << std::endl;
+  fout.close();
+
+  std::vector<std::string> part_paths;
+  std::vector<std::vector<std::string> > part_lines = {
+      {"chr1:1-500"}, {"chr1:501-1000", "chr2:1-50"}, {"chr2:501-1000"}};
+  for (int i = 0; i < part_lines.size(); i++) {
+    part_paths.push_back(fcs::get_contig_fname(prefix.str() + ".parts", i, 
+        "list", "part-"));
+    fcs::create_dir(prefix.str() + ".parts");
+    fout.open(part_paths.back());
+    for (auto line : part_lines[i]) fout << line << std::endl;
+    fout.close();
+  }
+
+  std::vector<std::string> parts = fcs::intersect_intv(
+      intv_path, part_paths, ref_path);
+  ASSERT_EQ(3, parts.size());
+  std::vector<std::vector<std::string> > expected = {
+      {"chr1:101-500"}, {"chr1:501-600", "chr2:1-50"}};
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(expected[i], fcs::get_lines(parts[i]));
+  }
+  // no task for a partition without targets
+  ASSERT_TRUE(parts[2].empty());
+
+  // no partition has any target
+  part_paths.resize(1);
+  fout.open(part_paths[0]);
+  fout << "chr2:501-1000" << std::endl;
+  fout.close();
+  ASSERT_THROW(fcs::intersect_intv(intv_path, part_paths, ref_path),
+      fcs::invalidParam);
+
+  fcs::remove_path(fcs::contig_intv_dir());
+  fcs::remove_path(prefix.str() + ".parts");
+  fcs::remove_path(ref_path);
+  fcs::remove_path(prefix.str() + ".dict");
+  fcs::remove_path(intv_path);
+}
+
+TEST_F(TestConfig, NumaTopology) {
+
+  std::stringstream sysfs;
+  sysfs << "/tmp/TestConfig." << fcs::getTid() << ".sysfs";
+  std::string sysfs_dir = sysfs.str();
+
+  // two sockets of two cores, each with two SMT siblings
+  const char* cpulists[] = {"0-1,4-5", "2-3,6-7"};
+  for (int node = 0; node < 2; node++) {
+    std::string node_dir = sysfs_dir + "/node/node" + std::to_string((long long)node);
+    fcs::create_dir(node_dir);
+    std::ofstream fout(node_dir + "/cpulist");
+    fout << cpulists[node] << std::endl;
+  }
+  for (int cpu = 0; cpu < 8; cpu++) {
+    std::string topology = sysfs_dir + "/cpu/cpu" + 
+        std::to_string((long long)cpu) + "/topology";
+    fcs::create_dir(topology);
+    std::ofstream package(topology + "/physical_package_id");
+    package << (cpu / 2) % 2 << std::endl;
+    std::ofstream core(topology + "/core_id");
+    core << cpu % 2 << std::endl;
+  }
+
+  fcs::NumaTopology numa(sysfs_dir);
+  ASSERT_EQ(2, numa.num_nodes());
+  ASSERT_EQ(4, numa.num_cpus(0));
+  ASSERT_EQ(2, numa.num_cores(1));
+  ASSERT_EQ(4, numa.num_cores());
+
+  std::vector<int> cpus = {0, 1, 4, 5};
+  ASSERT_EQ(cpus, fcs::NumaTopology::parse_cpulist("0-1,4-5"));
+  ASSERT_TRUE(fcs::NumaTopology::parse_cpulist("0-x").empty());
+
+  fcs::remove_path(sysfs_dir);
+}
+
+TEST_F(TestConfig, PartitionByReads) {
+  namespace po = boost::program_options;
+  fcs::config_vtable.insert(std::make_pair("gatk.ncontigs",
+      po::variable_value(boost::any(2), false)));
+  fcs::config_vtable.insert(std::make_pair("gatk.partition",
+      po::variable_value(boost::any(std::string("reads")), false)));
+  fcs::config_vtable.insert(std::make_pair("gatk.intv.path",
+      po::variable_value(boost::any(std::string()), false)));
+
+  std::stringstream prefix;
+  prefix << "/tmp/TestConfig." << fcs::getTid();
+  std::string ref_path = prefix.str() + ".fasta";
+  std::string bam_path = prefix.str() + ".bam";
+
+  // two contigs of four 16kb windows
+  std::ofstream fout(ref_path);
+  fout.close();
+  fout.open(prefix.str() + ".dict");
+  fout << "@SQ\tSN:chr1\tLN:65536" << std::endl;
+  fout << "@SQ\tSN:chr2\tLN:65536" << std::endl;
+  fout.close();
+
+  gzFile bam = gzopen(bam_path.c_str(), "wb");
+  int32_t header[] = {0, 2};
+  int32_t l_name = 5;
+  int32_t l_ref = 65536;
+  gzwrite(bam, "BAM\1", 4);
+  gzwrite(bam, header, sizeof(header));
+  for (int i = 1; i <= 2; i++) {
+    std::string name = "chr" + std::to_string((long long)i);
+    gzwrite(bam, &l_name, 4);
+    gzwrite(bam, name.c_str(), l_name);
+    gzwrite(bam, &l_ref, 4);
+  }
+  gzclose(bam);
+
+  // chr1 has 100, 90, 0 and 110 bytes in its windows, chr2 25 in 
+  // each and 100 mapped reads
+  std::vector<int32_t> chr1_bin = {1, 4681, 1};
+  std::vector<uint64_t> chr1_chunk = {0, 300 << 16};
+  std::vector<uint64_t> chr1_intv = {0, 100 << 16, 190 << 16, 190 << 16};
+  std::vector<int32_t> chr2_bin = {2, 4681, 1};
+  std::vector<uint64_t> chr2_chunk = {300 << 16, 400 << 16};
+  std::vector<int32_t> chr2_meta = {37450, 2};
+  std::vector<uint64_t> chr2_counts = {300 << 16, 400 << 16, 100, 0};
+  std::vector<uint64_t> chr2_intv = {300 << 16, 325 << 16, 350 << 16, 375 << 16};
+  int32_t n_ref = 2;
+  int32_t n_intv = 4;
+
+  fout.open(bam_path + ".bai", std::ios::binary);
+  fout.write("BAI\1", 4);
+  fout.write((char*)&n_ref, 4);
+  fout.write((char*)&chr1_bin[0], 12);
+  fout.write((char*)&chr1_chunk[0], 16);
+  fout.write((char*)&n_intv, 4);
+  fout.write((char*)&chr1_intv[0], 32);
+  fout.write((char*)&chr2_bin[0], 12);
+  fout.write((char*)&chr2_chunk[0], 16);
+  fout.write((char*)&chr2_meta[0], 8);
+  fout.write((char*)&chr2_counts[0], 32);
+  fout.write((char*)&n_intv, 4);
+  fout.write((char*)&chr2_intv[0], 32);
+  fout.close();
+
+  fcs::BamIndex index(bam_path);
+  std::vector<double> load = {100, 90, 0, 110};
+  ASSERT_EQ(load, index.load("chr1"));
+  ASSERT_EQ(4, index.load("chr2").size());
+  ASSERT_EQ(25, index.load("chr2")[3]);
+
+  // the cut in the middle moves to the empty window of chr1
+  std::vector<std::string> parts = fcs::init_contig_intv(ref_path, bam_path, "htc");
+  ASSERT_EQ(2, parts.size());
+  std::vector<std::vector<std::string> > expected = {
+      {"chr1:1-32768"}, {"chr1:32769-65536", "chr2:1-65536"}};
+  for (int i = 0; i < parts.size(); i++) {
+    ASSERT_EQ(expected[i], fcs::get_lines(parts[i]));
+  }
+
+  // a folder of parts keeps the partitions written next to them,
+  // and gets the length ones if a part has none
+  std::string dir_path = prefix.str() + ".parts";
+  fcs::create_dir(dir_path);
+  for (int i = 0; i < parts.size(); i++) {
+    boost::filesystem::copy_file(parts[i], 
+        fcs::get_contig_fname(dir_path, i, "list"));
+  }
+  std::vector<std::string> folder_parts = fcs::init_folder_intv(ref_path, dir_path);
+  ASSERT_EQ(fcs::get_contig_fname(dir_path, 1, "list"), folder_parts[1]);
+  for (int i = 0; i < folder_parts.size(); i++) {
+    ASSERT_EQ(expected[i], fcs::get_lines(folder_parts[i]));
+  }
+  fcs::remove_path(fcs::get_contig_fname(dir_path, 1, "list"));
+  folder_parts = fcs::init_folder_intv(ref_path, dir_path);
+  ASSERT_EQ(std::vector<std::string>(1, "chr1:1-65536"), 
+      fcs::get_lines(folder_parts[0]));
+  ASSERT_EQ(std::vector<std::string>(1, "chr2:1-65536"), 
+      fcs::get_lines(folder_parts[1]));
+  fcs::remove_path(dir_path);
+
+  // without the index, the same length each
+  fcs::remove_path(bam_path + ".bai");
+  parts = fcs::init_contig_intv(ref_path, bam_path, "htc");
+  expected = {{"chr1:1-65536"}, {"chr2:1-65536"}};
+  for (int i = 0; i < parts.size(); i++) {
+    ASSERT_EQ(expected[i], fcs::get_lines(parts[i]));
+  }
+
+  fcs::remove_path(fcs::contig_intv_dir());
+  fcs::remove_path(ref_path);
+  fcs::remove_path(prefix.str() + ".dict");
+  fcs::remove_path(bam_path);
+}
+
+TEST_F(TestConfig, PartitionByGaps) {
+  namespace po = boost::program_options;
+  fcs::config_vtable.insert(std::make_pair("gatk.ncontigs",
+      po::variable_value(boost::any(2), false)));
+  fcs::config_vtable.insert(std::make_pair("gatk.partition",
+      po::variable_value(boost::any(std::string("length")), false)));
+  fcs::config_vtable.insert(std::make_pair("gatk.intv.path",
+      po::variable_value(boost::any(std::string()), false)));
+
+  std::stringstream prefix;
+  prefix << "/tmp/TestConfig." << fcs::getTid();
+  std::string ref_path = prefix.str() + ".fasta";
+
+  // chr1 has a gap of 2000 N and a short run of 10, in lines of 60
+  std::vector<std::pair<std::string, std::string> > seqs = {
+      {"chr1", std::string(4800, 'A') + std::string(2000, 'N') + 
+               std::string(1000, 'C') + std::string(10, 'n') + 
+               std::string(1990, 'G')},
+      {"chr2", std::string(2200, 'T')}};
+  std::ofstream fasta(ref_path);
+  std::ofstream fai(ref_path + ".fai");
+  for (int i = 0; i < seqs.size(); i++) {
+    fasta << ">" << seqs[i].first << std::endl;
+    fai << seqs[i].first << "\t" << seqs[i].second.size() << "\t" 
+        << fasta.tellp() << "\t60\t61" << std::endl;
+    for (int j = 0; j < seqs[i].second.size(); j += 60) {
+      fasta << seqs[i].second.substr(j, 60) << std::endl;
+    }
+  }
+  fasta.close();
+  fai.close();
+
+  std::vector<fcs::RefContig> contigs = fcs::scan_ref_gaps(ref_path, 1000);
+  ASSERT_EQ(2, contigs.size());
+  ASSERT_EQ(9800, contigs[0].length);
+  ASSERT_EQ(1, contigs[0].gaps.size());
+  ASSERT_EQ(std::make_pair((uint64_t)4801, (uint64_t)6800), contigs[0].gaps[0]);
+  ASSERT_TRUE(contigs[1].gaps.empty());
+
+  // 10000 callable bases, the cut at 5000 moves to the gap
+  std::vector<std::string> parts = fcs::init_contig_intv(ref_path);
+  ASSERT_EQ(2, parts.size());
+  std::vector<std::vector<std::string> > expected = {
+      {"chr1:1-4800"}, {"chr1:6801-9800", "chr2:1-2200"}};
+  for (int i = 0; i < parts.size(); i++) {
+    ASSERT_EQ(expected[i], fcs::get_lines(parts[i]));
+  }
+
+  // the partitions are cached next to the reference
+  ASSERT_EQ(0, parts[0].find(ref_path + ".fcs-intv/"));
+  ASSERT_EQ(parts, fcs::split_ref_by_nprocs(ref_path));
+
+  // filling the gap keeps the index, but not the cached partitions
+  std::time_t mtime = boost::filesystem::last_write_time(ref_path);
+  std::fstream fio(ref_path);
+  fio.seekp(6 + 4800 / 60 * 61);
+  for (int j = 4800; j < 6800; j += 60) {
+    fio << std::string(60, 'A') << std::endl;
+  }
+  fio.close();
+  boost::filesystem::last_write_time(ref_path, mtime + 1);
+  std::vector<std::string> filled = fcs::init_contig_intv(ref_path);
+  ASSERT_NE(parts[0], filled[0]);
+  expected = {{"chr1:1-6000"}, {"chr1:6001-9800", "chr2:1-2200"}};
+  for (int i = 0; i < filled.size(); i++) {
+    ASSERT_EQ(expected[i], fcs::get_lines(filled[i]));
+  }
+
+  fcs::remove_path(ref_path + ".fcs-intv");
+  fcs::remove_path(ref_path + ".fai");
+  fcs::remove_path(ref_path);
+  fcs::remove_path(fcs::contig_intv_dir());
+}
+
 TEST_F(TestConfig, CheckNprocsAndMemory) {
 
   // set values through env
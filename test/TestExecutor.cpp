@@ -1,14 +1,24 @@
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/future.hpp>
 
 #include<bits/stdc++.h> 
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <gtest/gtest.h>
 
+#include "fcs-genome/Agent.h"
 #include "fcs-genome/BackgroundExecutor.h"
 #include "fcs-genome/common.h"
 #include "fcs-genome/config.h"
+#include "fcs-genome/Executor.h"
+#include "fcs-genome/JvmPool.h"
+#include "fcs-genome/SlotBroker.h"
+#include "fcs-genome/TaskLedger.h"
 #include "fcs-genome/Worker.h"
 #include "fcs-genome/workers/BlazeWorker.h"
 
@@ -18,6 +28,18 @@ class TestExecutor : public ::testing::Test {
   ;
 };
 
+// executor with a fixed resource budget regardless of the host
+class TestBudgetExecutor : public fcs::Executor {
+  public:
+    TestBudgetExecutor(std::string name, int cores, int memory, 
+        int num_slots = 2): 
+      Executor(name, num_slots) 
+    {
+      cores_budget_  = cores;
+      memory_budget_ = memory;
+    }
+};
+
 TEST_F(TestExecutor, TestBackgroundExecutor) {
 
   bool check_done = false;
@@ -86,3 +108,1243 @@ TEST_F(TestExecutor, TestBackgroundExecutor) {
   // shouldn't create this file since the executor is killed
   ASSERT_FALSE(boost::filesystem::exists(fname.str()));
 }
+
+TEST_F(TestExecutor, TestTaskDependency) {
+
+  class TouchWorker : public fcs::Worker {
+    public:
+      TouchWorker(std::string cmd,
+          std::string input, 
+          std::string output): Worker(1, 1, 
+            std::vector<std::string>(), "Touch") 
+      {
+        cmd_ = cmd;
+        if (!input.empty()) inputs_.push_back(input);
+        outputs_.push_back(output);
+      }
+  };
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor." << fcs::getTid();
+  fcs::create_dir(dir.str());
+
+  std::string slow = dir.str() + "/slow";
+  std::string fast = dir.str() + "/fast";
+  std::string next = dir.str() + "/next";
+
+  TestBudgetExecutor executor("Test Dependency", 2, 0);
+
+  // stage 1: one slow and one fast task
+  fcs::Worker_ptr worker1(new TouchWorker(
+        "sleep 1; touch " + slow, "", slow));
+  executor.addTask(worker1, "", true);
+
+  fcs::Worker_ptr worker2(new TouchWorker(
+        "touch " + fast, "", fast));
+  executor.addTask(worker2, "", false);
+
+  // stage 2: only depends on the fast task, so it should 
+  // start before the slow task of stage 1 finishes
+  fcs::Worker_ptr worker3(new TouchWorker(
+        "test -f " + slow + " || touch " + next, 
+        fast, next));
+  executor.addTask(worker3, "", true);
+
+  executor.run();
+  boost::this_thread::sleep_for(boost::chrono::milliseconds(100)); 
+
+  ASSERT_TRUE(boost::filesystem::exists(slow));
+  ASSERT_TRUE(boost::filesystem::exists(next));
+
+  fcs::remove_path(dir.str());
+}
+
+TEST_F(TestExecutor, TestCohortOverlap) {
+
+  // logs when it starts and ends, and writes its outputs
+  class StepWorker : public fcs::Worker {
+    public:
+      StepWorker(std::string name, std::string log, double sleep,
+          std::vector<std::string> inputs, 
+          std::vector<std::string> outputs): Worker(1, 1, 
+            std::vector<std::string>(), name) 
+      {
+        std::stringstream cmd;
+        cmd << "echo " << name << " start $(date +%s%N) >> " << log << "; "
+            << "sleep " << sleep << "; ";
+        for (int i = 0; i < outputs.size(); i++) {
+          cmd << "touch " << outputs[i] << "; ";
+        }
+        cmd << "echo " << name << " end $(date +%s%N) >> " << log;
+        cmd_ = cmd.str();
+        inputs_ = inputs;
+        outputs_ = outputs;
+      }
+  };
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor." << fcs::getTid();
+  fcs::create_dir(dir.str());
+  std::string log = dir.str() + "/steps";
+
+  // the tasks of two samples in one executor as in --cohort: 
+  // alignment, calling on two contigs and concat for each sample,
+  // every step a new stage
+  TestBudgetExecutor executor("Test Cohort", 3, 0, 3);
+  std::string samples[2] = {"A", "B"};
+  double align_sleep[2] = {0.2, 1};
+  for (int i = 0; i < 2; i++) {
+    std::string s = samples[i];
+    std::string fq  = dir.str() + "/" + s + ".fq";
+    std::string bam = dir.str() + "/" + s + ".bam";
+    std::ofstream(fq) << "reads";
+
+    executor.addTask(fcs::Worker_ptr(new StepWorker("align" + s, log, 
+          align_sleep[i], std::vector<std::string>(1, fq),
+          std::vector<std::string>(1, bam))), s, true);
+
+    std::vector<std::string> vcfs;
+    for (int contig = 0; contig < 2; contig++) {
+      std::string n = std::to_string((long long)contig);
+      vcfs.push_back(dir.str() + "/" + s + "." + n + ".vcf");
+      executor.addTask(fcs::Worker_ptr(new StepWorker("call" + s + n, log, 
+            1, std::vector<std::string>(1, bam),
+            std::vector<std::string>(1, vcfs.back()))), s, contig == 0);
+    }
+
+    executor.addTask(fcs::Worker_ptr(new StepWorker("concat" + s, log, 
+          0, vcfs, std::vector<std::string>(1, 
+            dir.str() + "/" + s + ".vcf"))), s, true);
+  }
+  executor.run();
+
+  std::map<std::string, std::pair<uint64_t, uint64_t> > steps;
+  std::vector<std::string> lines = fcs::get_lines(log);
+  for (int i = 0; i < lines.size(); i++) {
+    std::stringstream ss(lines[i]);
+    std::string name, event;
+    uint64_t ts;
+    ss >> name >> event >> ts;
+    if (event == "start") steps[name].first = ts;
+    else steps[name].second = ts;
+  }
+  ASSERT_EQ(8, steps.size());
+
+  // the alignment of B runs while A is being called
+  ASSERT_LT(steps["alignB"].first, steps["callA0"].second);
+  ASSERT_LT(steps["callA0"].first, steps["alignB"].second);
+
+  // while the steps of each sample still run in order
+  for (int i = 0; i < 2; i++) {
+    std::string s = samples[i];
+    for (int contig = 0; contig < 2; contig++) {
+      std::string call = "call" + s + std::to_string((long long)contig);
+      ASSERT_LE(steps["align" + s].second, steps[call].first);
+      ASSERT_LE(steps[call].second, steps["concat" + s].first);
+    }
+  }
+
+  fcs::remove_path(dir.str());
+}
+
+TEST_F(TestExecutor, TestResourceBudget) {
+
+  class MemoryWorker : public fcs::Worker {
+    public:
+      MemoryWorker(std::string cmd, int memory): Worker(1, 1) {
+        cmd_ = cmd;
+        memory_ = memory;
+      }
+  };
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor." << fcs::getTid();
+  fcs::create_dir(dir.str());
+
+  std::string first  = dir.str() + "/first";
+  std::string second = dir.str() + "/second";
+
+  // two threads but only enough memory for one task at a time,
+  // so the second task should only start after the first one
+  TestBudgetExecutor executor("Test Budget", 2, 4);
+
+  fcs::Worker_ptr worker1(new MemoryWorker(
+        "touch " + first + "; sleep 0.2", 4));
+  executor.addTask(worker1, "", true);
+
+  fcs::Worker_ptr worker2(new MemoryWorker(
+        "test -f " + first + " || touch " + second, 4));
+  executor.addTask(worker2, "", false);
+
+  executor.run();
+  boost::this_thread::sleep_for(boost::chrono::milliseconds(100)); 
+
+  ASSERT_TRUE(boost::filesystem::exists(first));
+  ASSERT_FALSE(boost::filesystem::exists(second));
+
+  fcs::remove_path(dir.str());
+}
+
+TEST_F(TestExecutor, TestFailedTask) {
+
+  class ShellWorker : public fcs::Worker {
+    public:
+      ShellWorker(std::string cmd, 
+          std::string input, 
+          std::string output): Worker(1, 1) 
+      {
+        cmd_ = cmd;
+        if (!input.empty()) inputs_.push_back(input);
+        outputs_.push_back(output);
+      }
+  };
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor." << fcs::getTid();
+  fcs::create_dir(dir.str());
+
+  std::string bad   = dir.str() + "/bad";
+  std::string good  = dir.str() + "/good";
+  std::string after = dir.str() + "/after";
+
+  TestBudgetExecutor executor("Test Failure", 2, 0);
+
+  fcs::Worker_ptr worker1(new ShellWorker("exit 3", "", bad));
+  executor.addTask(worker1, "", true);
+
+  fcs::Worker_ptr worker2(new ShellWorker("touch " + good, "", good));
+  executor.addTask(worker2, "", false);
+
+  // depends on the failed task and should be skipped
+  fcs::Worker_ptr worker3(new ShellWorker("touch " + after, bad, after));
+  executor.addTask(worker3, "", true);
+
+  ASSERT_THROW(executor.run(), fcs::failedCommand);
+
+  ASSERT_TRUE(boost::filesystem::exists(good));
+  ASSERT_FALSE(boost::filesystem::exists(after));
+
+  fcs::remove_path(dir.str());
+}
+
+TEST_F(TestExecutor, TestTaskCheck) {
+
+  // records the threads checking it, and if its input was there
+  class CheckWorker : public fcs::Worker {
+    public:
+      CheckWorker(std::string cmd, 
+          std::string input, 
+          std::string output,
+          std::vector<boost::thread::id>* threads,
+          bool quit = false): Worker(1, 1), 
+            threads_(threads), quit_(quit), found_(false)
+      {
+        cmd_ = cmd;
+        if (!input.empty()) inputs_.push_back(input);
+        outputs_.push_back(output);
+      }
+      void check() {
+        threads_->push_back(boost::this_thread::get_id());
+        found_ = !inputs_.empty() && boost::filesystem::exists(inputs_[0]);
+        if (quit_) throw fcs::silentExit();
+      }
+      bool found() { return found_; }
+    private:
+      std::vector<boost::thread::id>* threads_;
+      bool quit_;
+      bool found_;
+  };
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor." << fcs::getTid();
+  fcs::create_dir(dir.str());
+
+  std::string first  = dir.str() + "/first";
+  std::string second = dir.str() + "/second";
+  std::vector<boost::thread::id> threads;
+
+  // a task is checked on the thread of run() once its inputs are 
+  // written, before it starts
+  {
+    TestBudgetExecutor executor("Test Check", 2, 0);
+    fcs::Worker_ptr worker1(new CheckWorker("touch " + first, 
+          "", first, &threads));
+    executor.addTask(worker1, "", true);
+    boost::shared_ptr<CheckWorker> worker2(new CheckWorker(
+          "touch " + second, first, second, &threads));
+    executor.addTask(worker2, "", true);
+
+    executor.run();
+    ASSERT_TRUE(worker2->found());
+    ASSERT_TRUE(boost::filesystem::exists(second));
+    ASSERT_EQ(2, threads.size());
+    for (int i = 0; i < threads.size(); i++) {
+      ASSERT_EQ(boost::this_thread::get_id(), threads[i]);
+    }
+  }
+  fcs::remove_path(first);
+  fcs::remove_path(second);
+
+  // a check that exits stops the run without starting the task
+  {
+    TestBudgetExecutor executor("Test Check", 2, 0);
+    fcs::Worker_ptr worker1(new CheckWorker("touch " + first, 
+          "", first, &threads, true));
+    executor.addTask(worker1, "", true);
+    fcs::Worker_ptr worker2(new CheckWorker("touch " + second, 
+          first, second, &threads));
+    executor.addTask(worker2, "", true);
+
+    ASSERT_THROW(executor.run(), fcs::silentExit);
+    ASSERT_FALSE(boost::filesystem::exists(first));
+    ASSERT_FALSE(boost::filesystem::exists(second));
+  }
+
+  fcs::remove_path(dir.str());
+}
+
+TEST_F(TestExecutor, TestRetryOutOfMemory) {
+
+  // fails like a jvm with a heap smaller than 2gb
+  class HeapWorker : public fcs::Worker {
+    public:
+      HeapWorker(std::string output): Worker(1, 1), output_(output) {
+        memory_ = 1;
+        outputs_.push_back(output);
+      }
+      void setup() {
+        std::stringstream cmd;
+        cmd << "if [ " << memory_ << " -lt 2 ]; then "
+            << "echo java.lang.OutOfMemoryError: Java heap space; exit 1; "
+            << "fi; echo " << memory_ << " > " << output_;
+        cmd_ = cmd.str();
+      }
+    private:
+      std::string output_;
+  };
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor." << fcs::getTid();
+  fcs::create_dir(dir.str());
+
+  std::string output = dir.str() + "/heap";
+
+  TestBudgetExecutor executor("Test Retry", 2, 4);
+
+  fcs::Worker_ptr worker(new HeapWorker(output));
+  executor.addTask(worker, "", true);
+
+  ASSERT_NO_THROW(executor.run());
+
+  std::ifstream fin(output);
+  int memory = 0;
+  fin >> memory;
+  ASSERT_EQ(2, memory);
+
+  fcs::remove_path(dir.str());
+}
+
+TEST_F(TestExecutor, TestCgroup) {
+
+  class ShellWorker : public fcs::Worker {
+    public:
+      ShellWorker(std::string cmd): Worker(1, 1) {
+        cmd_ = cmd;
+        memory_ = 1;
+      }
+  };
+
+  // needs a writable cgroup v2 hierarchy
+  std::string cgroup_root;
+  const char* candidates[] = {"/sys/fs/cgroup/unified", "/sys/fs/cgroup"};
+  for (int i = 0; i < 2 && cgroup_root.empty(); i++) {
+    std::string dir = std::string(candidates[i]) + "/fcs-genome-test";
+    if (boost::filesystem::exists(std::string(candidates[i]) + "/cgroup.procs") &&
+        !mkdir(dir.c_str(), 0755)) {
+      rmdir(dir.c_str());
+      cgroup_root = candidates[i];
+    }
+  }
+  if (cgroup_root.empty()) {
+    DLOG(WARNING) << "Skipping TestCgroup without a writable cgroup v2 hierarchy";
+    return;
+  }
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor." << fcs::getTid();
+  fcs::create_dir(dir.str());
+  std::string output = dir.str() + "/cgroup";
+
+  fcs::config_vtable.at("executor.cgroup").value() = cgroup_root;
+  {
+    TestBudgetExecutor executor("Test Cgroup", 2, 4);
+    fcs::Worker_ptr worker(new ShellWorker("cat /proc/self/cgroup > " + output));
+    executor.addTask(worker, "", true);
+    executor.run();
+  }
+  fcs::config_vtable.at("executor.cgroup").value() = std::string();
+
+  std::ifstream fin(output);
+  std::string content((std::istreambuf_iterator<char>(fin)),
+      std::istreambuf_iterator<char>());
+  ASSERT_NE(std::string::npos, content.find("/fcs-genome-"));
+  ASSERT_NE(std::string::npos, content.find("/task-0"));
+
+  fcs::remove_path(dir.str());
+}
+
+TEST_F(TestExecutor, TestOutputCapture) {
+
+  class EchoWorker : public fcs::Worker {
+    public:
+      EchoWorker(std::string cmd): 
+        Worker(1, 1, std::vector<std::string>(), "Output Capture") 
+      {
+        cmd_ = cmd;
+      }
+  };
+
+  {
+    TestBudgetExecutor executor("Test Output", 2, 0);
+    fcs::Worker_ptr worker1(new EchoWorker("echo first; echo second >&2"));
+    executor.addTask(worker1, "", true);
+    fcs::Worker_ptr worker2(new EchoWorker("printf partial; exit 5"));
+    executor.addTask(worker2, "", false);
+    ASSERT_THROW(executor.run(), fcs::failedCommand);
+  }
+
+  // output goes to the stage log as it comes, a task only 
+  // gets its own log if it fails
+  namespace fs = boost::filesystem;
+  std::string stage_log;
+  std::vector<std::string> task_logs;
+  for (fs::directory_iterator it(fcs::get_config<std::string>("log_dir")), end;
+       it != end; it++) {
+    std::string fname = it->path().filename().string();
+    if (fname.compare(0, 15, "output-capture-")) continue;
+    if (boost::ends_with(fname, ".log")) stage_log = it->path().string();
+    else task_logs.push_back(it->path().string());
+  }
+  ASSERT_FALSE(stage_log.empty());
+  ASSERT_EQ(1, task_logs.size());
+
+  std::ifstream fin(stage_log);
+  std::string content((std::istreambuf_iterator<char>(fin)),
+      std::istreambuf_iterator<char>());
+  ASSERT_NE(std::string::npos, content.find("[task 0] first\n"));
+  ASSERT_NE(std::string::npos, content.find("[task 0] second\n"));
+  ASSERT_NE(std::string::npos, content.find("[task 1] partial\n"));
+
+  std::ifstream task_fin(task_logs[0]);
+  std::string task_output;
+  std::getline(task_fin, task_output);
+  ASSERT_EQ("partial", task_output);
+
+  fcs::remove_path(stage_log);
+  fcs::remove_path(task_logs[0]);
+}
+
+TEST_F(TestExecutor, TestFailFast) {
+
+  class ShellWorker : public fcs::Worker {
+    public:
+      ShellWorker(std::string cmd, std::string output): Worker(1, 1) {
+        cmd_ = cmd;
+        outputs_.push_back(output);
+      }
+  };
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor." << fcs::getTid();
+  fcs::create_dir(dir.str());
+
+  std::string bad     = dir.str() + "/bad";
+  std::string sibling = dir.str() + "/sibling";
+  std::string queued  = dir.str() + "/queued";
+
+  fcs::config_vtable.at("executor.failure_policy").value() = std::string("fail-fast");
+  uint64_t start_ts = fcs::getTs();
+  {
+    TestBudgetExecutor executor("Test Fail Fast", 2, 0);
+
+    // reports an error but keeps running like a JVM with live threads
+    fcs::Worker_ptr worker1(new ShellWorker(
+          "echo '##### ERROR MESSAGE: bad index'; sleep 5; touch " + bad, bad));
+    executor.addTask(worker1, "", true);
+
+    fcs::Worker_ptr worker2(new ShellWorker("sleep 5; touch " + sibling, sibling));
+    executor.addTask(worker2, "", false);
+
+    fcs::Worker_ptr worker3(new ShellWorker("touch " + queued, queued));
+    executor.addTask(worker3, "", false);
+
+    ASSERT_THROW(executor.run(), fcs::failedCommand);
+  }
+  fcs::config_vtable.at("executor.failure_policy").value() = std::string("best-effort");
+
+  ASSERT_LT(fcs::getTs() - start_ts, 4);
+  ASSERT_FALSE(boost::filesystem::exists(bad));
+  ASSERT_FALSE(boost::filesystem::exists(sibling));
+  ASSERT_FALSE(boost::filesystem::exists(queued));
+
+  fcs::remove_path(dir.str());
+}
+
+TEST_F(TestExecutor, TestAgent) {
+
+  // the token is created by the agent and only readable by its owner
+  std::stringstream token_file;
+  token_file << "/tmp/TestExecutor.agent." << fcs::getTid() << "/token";
+  std::string token = fcs::Agent::readToken(token_file.str(), true);
+  ASSERT_EQ(32, token.size());
+  ASSERT_EQ(token, fcs::Agent::readToken(token_file.str()));
+  chmod(token_file.str().c_str(), 0644);
+  ASSERT_THROW(fcs::Agent::readToken(token_file.str()), fcs::invalidParam);
+  fcs::remove_path(token_file.str());
+  ASSERT_THROW(fcs::Agent::readToken(token_file.str()), fcs::fileNotFound);
+
+  fcs::Agent agent(token);
+  int port = agent.port();
+  boost::thread server(boost::bind(&fcs::Agent::run, &agent));
+
+  // requests without the token are refused
+  std::stringstream refused_out;
+  ASSERT_EQ(255, fcs::Agent::submit("localhost", port, "wrong",
+      "touch " + token_file.str(), 1, 0, refused_out));
+  ASSERT_FALSE(boost::filesystem::exists(token_file.str()));
+
+  // output and exit code come back to the submitter
+  std::stringstream out;
+  int ret = fcs::Agent::submit("localhost", port, token,
+      "echo hello; echo error >&2; exit 3", 1, 0, out);
+  ASSERT_EQ(3, ret);
+  ASSERT_NE(std::string::npos, out.str().find("hello\n"));
+  ASSERT_NE(std::string::npos, out.str().find("error\n"));
+
+  // a running task holds its cores until it is killed
+  std::stringstream sleep_out;
+  boost::packaged_task<int> sleep_task(boost::bind(&fcs::Agent::submit,
+        std::string("localhost"), port, token, std::string("sleep 30"), 
+        2, 1, boost::ref(sleep_out), (volatile int*)NULL));
+  boost::unique_future<int> sleep_ret = sleep_task.get_future();
+  boost::thread sleeper(boost::move(sleep_task));
+
+  Json::Value req;
+  req["type"] = "status";
+  Json::Value status;
+  for (int i = 0; i < 100; i++) {
+    status = fcs::Agent::request("localhost", port, token, req);
+    if (status["tasks"].asInt() == 1) break;
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+  }
+  ASSERT_EQ(1, status["tasks"].asInt());
+  ASSERT_EQ(agent.status()["cores"].asInt(), status["cores"].asInt());
+
+  // another agent with nothing running is less loaded, and
+  // an unreachable one is ignored
+  {
+    fcs::Agent idle(token);
+    boost::thread idle_server(boost::bind(&fcs::Agent::run, &idle));
+    std::vector<std::string> hosts;
+    hosts.push_back("localhost:1");
+    hosts.push_back("localhost:" + std::to_string((long long)port));
+    hosts.push_back("localhost:" + std::to_string((long long)idle.port()));
+    ASSERT_EQ(2, fcs::Agent::findLeastLoaded(hosts, port, token));
+    ASSERT_EQ(-1, fcs::Agent::findLeastLoaded(hosts, port, "wrong"));
+    idle.stop();
+    idle_server.join();
+  }
+
+  // only tasks of the agent can be killed
+  Json::Value kill;
+  kill["type"] = "kill";
+  kill["task"] = 3;
+  ASSERT_FALSE(fcs::Agent::request("localhost", port, token, kill)["ok"].asBool());
+  kill["task"] = 2;
+  ASSERT_TRUE(fcs::Agent::request("localhost", port, token, kill)["ok"].asBool());
+  ASSERT_EQ(128 + SIGTERM, sleep_ret.get());
+  sleeper.join();
+
+  agent.stop();
+  server.join();
+  fcs::remove_path(boost::filesystem::path(token_file.str()).parent_path().string());
+}
+
+TEST_F(TestExecutor, TestLocality) {
+
+  class InputWorker : public fcs::Worker {
+    public:
+      InputWorker(std::string input): Worker(1, 1) {
+        inputs_.push_back(input);
+      }
+  };
+
+  class PlacementExecutor : public TestBudgetExecutor {
+    public:
+      PlacementExecutor(): TestBudgetExecutor("Test Locality", 2, 0) {;}
+      int place(fcs::Worker_ptr worker) {
+        bool use_agent;
+        return placeTask(worker, 0, use_agent);
+      }
+      void hold(std::string path, int host) { locations_[path] = host; }
+      void busy(int host, int num_tasks) { host_tasks_[host] = num_tasks; }
+  };
+
+  std::vector<std::string> host_list = fcs::conf_host_list;
+  fcs::conf_host_list.clear();
+  fcs::conf_host_list.push_back("node-a");
+  fcs::conf_host_list.push_back("node-b");
+  fcs::config_vtable.at("executor.locality_wait").value() = 1;
+  {
+    PlacementExecutor executor;
+    fcs::Worker_ptr worker(new InputWorker("/tmp/locality/part-3/sorted.bam"));
+
+    // nothing is known about the input yet
+    ASSERT_EQ(0, executor.place(worker));
+
+    // the partition dir was produced on node-b
+    executor.hold("/tmp/locality/part-3", 1);
+    ASSERT_EQ(1, executor.place(worker));
+
+    // node-b stays saturated, so the task goes elsewhere after waiting
+    executor.busy(1, 1);
+    uint64_t start_ts = fcs::getTs();
+    ASSERT_EQ(0, executor.place(worker));
+    ASSERT_GE(fcs::getTs() - start_ts, 1);
+  }
+  fcs::config_vtable.at("executor.locality_wait").value() = 5;
+  fcs::conf_host_list = host_list;
+}
+
+TEST_F(TestExecutor, TestSlotBroker) {
+
+  std::string name = "test-" + std::to_string((long long)getpid());
+  fcs::SlotBroker::remove(name);
+
+  // 2 slots and 4gb, so 2gb weighs as much as a core
+  fcs::SlotBroker broker(name);
+  broker.addHost("localhost", 2, 4);
+  boost::thread server(boost::bind(&fcs::SlotBroker::run, &broker));
+
+  std::string host;
+  fcs::SlotClient large(name);
+  int large_id = large.acquire(1, 4, host);
+  ASSERT_EQ("localhost", host);
+
+  // the host is full until the large request is released
+  fcs::SlotClient small(name);
+  boost::packaged_task<int> small_task(boost::bind(&fcs::SlotClient::acquire,
+        &small, 1, 0, boost::ref(host)));
+  boost::unique_future<int> small_id = small_task.get_future();
+  boost::thread small_thread(boost::move(small_task));
+  ASSERT_FALSE(small_id.wait_for(boost::chrono::milliseconds(300)) == 
+      boost::future_status::ready);
+
+  large.release(large_id);
+  ASSERT_TRUE(small_id.wait_for(boost::chrono::seconds(5)) == 
+      boost::future_status::ready);
+  small_thread.join();
+
+  // slots of a client that stops renewing are taken back
+  {
+    fcs::SlotClient stale(name, 1);
+    std::string stale_host;
+    stale.acquire(1, 0, stale_host);
+
+    fcs::SlotClient waiting(name);
+    std::string waiting_host;
+    boost::packaged_task<int> waiting_task(boost::bind(&fcs::SlotClient::acquire,
+          &waiting, 1, 0, boost::ref(waiting_host)));
+    boost::unique_future<int> waiting_id = waiting_task.get_future();
+    boost::thread waiting_thread(boost::move(waiting_task));
+    ASSERT_FALSE(waiting_id.wait_for(boost::chrono::milliseconds(300)) == 
+        boost::future_status::ready);
+    ASSERT_TRUE(waiting_id.wait_for(boost::chrono::seconds(5)) == 
+        boost::future_status::ready);
+    waiting_thread.join();
+    waiting.release(waiting_id.get());
+  }
+
+  // tasks of an executor take their slots from the broker too
+  class ShellWorker : public fcs::Worker {
+    public:
+      ShellWorker(std::string cmd, int num_process = 1): 
+        Worker(num_process, 1) { cmd_ = cmd; }
+  };
+  fcs::config_vtable.at("executor.broker").value() = name;
+  {
+    TestBudgetExecutor executor("Test Slot Broker", 2, 0);
+    for (int i = 0; i < 3; i++) {
+      fcs::Worker_ptr worker(new ShellWorker("true"));
+      executor.addTask(worker, "", i == 0);
+    }
+    executor.run();
+  }
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor." << fcs::getTid();
+  fcs::create_dir(dir.str());
+  std::string refused = dir.str() + "/refused";
+  std::string waiting = dir.str() + "/waiting";
+
+  small.release(small_id.get());
+
+  // a task larger than the hosts fails instead of running unaccounted
+  {
+    TestBudgetExecutor executor("Test Slot Broker", 2, 0);
+    fcs::Worker_ptr worker(new ShellWorker("touch " + refused, 3));
+    executor.addTask(worker, "", true);
+    ASSERT_THROW(executor.run(), fcs::internalError);
+    ASSERT_FALSE(boost::filesystem::exists(refused));
+  }
+
+  // a task waiting for its slots is cancelled by a failure in 
+  // fail-fast mode, without holding the other tasks back
+  fcs::config_vtable.at("executor.failure_policy").value() = std::string("fail-fast");
+  {
+    fcs::SlotClient holder(name);
+    std::string holder_host;
+    int holder_id = holder.acquire(1, 0, holder_host);
+
+    TestBudgetExecutor executor("Test Slot Broker", 2, 0);
+    fcs::Worker_ptr worker1(new ShellWorker("sleep 0.2; exit 1"));
+    executor.addTask(worker1, "", true);
+    fcs::Worker_ptr worker2(new ShellWorker("touch " + waiting));
+    executor.addTask(worker2, "", false);
+
+    boost::packaged_task<bool> run_task([&executor]() {
+        try {
+          executor.run();
+        }
+        catch (fcs::failedCommand &e) {
+          return true;
+        }
+        return false;
+    });
+    boost::unique_future<bool> failed = run_task.get_future();
+    boost::thread run_thread(boost::move(run_task));
+    bool finished = failed.wait_for(boost::chrono::seconds(5)) == 
+        boost::future_status::ready;
+    holder.release(holder_id);
+    run_thread.join();
+
+    ASSERT_TRUE(finished);
+    ASSERT_TRUE(failed.get());
+    ASSERT_FALSE(boost::filesystem::exists(waiting));
+  }
+  fcs::config_vtable.at("executor.failure_policy").value() = std::string("best-effort");
+  fcs::config_vtable.at("executor.broker").value() = std::string("");
+  fcs::remove_path(dir.str());
+
+  broker.stop();
+  server.join();
+}
+
+TEST_F(TestExecutor, TestSlotBackfill) {
+
+  std::string name = "backfill-" + std::to_string((long long)getpid());
+  fcs::SlotBroker::remove(name);
+
+  fcs::SlotBroker broker(name);
+  broker.addHost("node-a", 2, 0);
+  broker.addHost("node-b", 2, 0);
+  boost::thread server(boost::bind(&fcs::SlotBroker::run, &broker));
+
+  // each pending request needs its own client
+  std::vector<boost::shared_ptr<fcs::SlotClient> > clients;
+  std::vector<boost::shared_ptr<std::vector<std::string> > > hosts;
+  std::vector<boost::shared_ptr<boost::unique_future<int> > > grants;
+  std::vector<boost::shared_ptr<boost::thread> > threads;
+  auto request_on = [&](boost::shared_ptr<fcs::SlotClient> client,
+      int slots, int runtime) {
+    clients.push_back(client);
+    hosts.push_back(boost::make_shared<std::vector<std::string> >());
+    boost::packaged_task<int> task(boost::bind(
+          static_cast<int (fcs::SlotClient::*)(int, int, int, int, 
+            std::vector<std::string>&)>(&fcs::SlotClient::acquire),
+          clients.back().get(), slots, 1, 0, runtime, 
+          boost::ref(*hosts.back())));
+    grants.push_back(boost::make_shared<boost::unique_future<int> >(
+          task.get_future()));
+    threads.push_back(boost::make_shared<boost::thread>(boost::move(task)));
+    return grants.size() - 1;
+  };
+  auto request = [&](int slots, int runtime) {
+    return request_on(boost::make_shared<fcs::SlotClient>(name), 
+        slots, runtime);
+  };
+  auto granted = [&](int i, int ms) {
+    return grants[i]->wait_for(boost::chrono::milliseconds(ms)) == 
+        boost::future_status::ready;
+  };
+
+  // a gang larger than all hosts is refused
+  int too_large = request(5, 0);
+  ASSERT_TRUE(granted(too_large, 5000));
+  ASSERT_EQ(-1, grants[too_large]->get());
+
+  // 3 of the 4 slots run for a while
+  int gang = request(2, 2);
+  ASSERT_TRUE(granted(gang, 5000));
+  ASSERT_EQ(2, hosts[gang]->size());
+  int longer = request(1, 60);
+  ASSERT_TRUE(granted(longer, 5000));
+
+  // the full gang waits for both to end, a request on the free 
+  // slot ending after that would delay it, a short one does not
+  int full = request(4, 10);
+  ASSERT_FALSE(granted(full, 300));
+  int slow = request(1, 120);
+  ASSERT_FALSE(granted(slow, 300));
+  int quick = request(1, 5);
+  ASSERT_TRUE(granted(quick, 5000));
+  ASSERT_FALSE(granted(full, 0));
+
+  // the gang is granted at once when all slots are free
+  clients[gang]->release(grants[gang]->get());
+  clients[longer]->release(grants[longer]->get());
+  ASSERT_FALSE(granted(full, 300));
+  clients[quick]->release(grants[quick]->get());
+  ASSERT_TRUE(granted(full, 5000));
+  ASSERT_EQ(4, hosts[full]->size());
+  ASSERT_FALSE(granted(slow, 300));
+
+  clients[full]->release(grants[full]->get());
+  ASSERT_TRUE(granted(slow, 5000));
+
+  // threads sharing a client do not wait for each other's grants
+  boost::shared_ptr<fcs::SlotClient> shared = 
+      boost::make_shared<fcs::SlotClient>(name);
+  int shared_gang = request_on(shared, 4, 10);
+  ASSERT_FALSE(granted(shared_gang, 300));
+  int shared_quick = request_on(shared, 1, 5);
+  ASSERT_TRUE(granted(shared_quick, 5000));
+  ASSERT_FALSE(granted(shared_gang, 0));
+  shared->release(grants[shared_quick]->get());
+  clients[slow]->release(grants[slow]->get());
+  ASSERT_TRUE(granted(shared_gang, 5000));
+  ASSERT_EQ(4, hosts[shared_gang]->size());
+  shared->release(grants[shared_gang]->get());
+
+  for (int i = 0; i < threads.size(); i++) {
+    threads[i]->join();
+  }
+  broker.stop();
+  server.join();
+}
+
+TEST_F(TestExecutor, TestJvmPool) {
+  std::string dir = "/tmp/fcs-genome-test-jvm-" + 
+      std::to_string((long long)getpid());
+  fcs::create_dir(dir);
+
+  // stub of the runner: prints its pid and the arguments, and 
+  // exits the task with the second argument, or hangs
+  std::string java = dir + "/java";
+  std::ofstream stub(java);
+  stub << "#!/bin/bash\n"
+       << "printf '%s\\n' \"$@\" > " << dir << "/argv.$$\n"
+       << "while IFS= read -r line; do\n"
+       << "  IFS=$'\\t' read -r -a args <<< \"$line\"\n"
+       << "  if [ \"${args[0]}\" = hang ]; then echo $$ > " << dir << "/hang.pid; sleep 30; fi\n"
+       << "  echo \"pid $$ ${args[*]}\"\n"
+       << "  echo \"log ${args[0]}\" >&2\n"
+       << "  printf '\\001fcs-exit %s\\n' \"${args[1]:-0}\"\n"
+       << "done\n";
+  stub.close();
+  chmod(java.c_str(), 0755);
+
+  fcs::JvmPool pool(dir + "/pool.sock", java, dir + "/runner.jar", 1, 3);
+  boost::thread server(boost::bind(&fcs::JvmPool::run, &pool));
+
+  // run a task and return the pid of the jvm that ran it
+  struct Submit {
+    static int run(fcs::JvmPool &pool, std::string jar, 
+        std::string tool, std::string ret, int &pid) 
+    {
+      std::vector<std::string> args;
+      args.push_back(tool);
+      args.push_back(ret);
+      std::stringstream out, err;
+      int exit = fcs::JvmPool::submit(pool.path(), jar, 2, "", 
+          args, out, err);
+      std::string word;
+      out >> word >> pid;
+      EXPECT_EQ("log " + tool + "\n", err.str());
+      return exit;
+    }
+  };
+
+  int first, pid;
+  ASSERT_EQ(0, Submit::run(pool, "a.jar", "HaplotypeCaller", "0", first));
+
+  // the jvm is reused for the same jar and heap, also after a 
+  // failed task, which replaces it though
+  ASSERT_EQ(3, Submit::run(pool, "a.jar", "PrintReads", "3", pid));
+  ASSERT_EQ(first, pid);
+  ASSERT_EQ(0, Submit::run(pool, "a.jar", "HaplotypeCaller", "0", pid));
+  ASSERT_NE(first, pid);
+
+  // and replaced after the number of tasks to reuse it for
+  first = pid;
+  ASSERT_EQ(0, Submit::run(pool, "a.jar", "HaplotypeCaller", "0", pid));
+  ASSERT_EQ(first, pid);
+  ASSERT_EQ(0, Submit::run(pool, "a.jar", "HaplotypeCaller", "0", pid));
+  ASSERT_EQ(first, pid);
+  ASSERT_EQ(0, Submit::run(pool, "a.jar", "HaplotypeCaller", "0", pid));
+  ASSERT_NE(first, pid);
+
+  // another jar needs another jvm
+  first = pid;
+  ASSERT_EQ(0, Submit::run(pool, "b.jar", "HaplotypeCaller", "0", pid));
+  ASSERT_NE(first, pid);
+
+  // the jvm of a task whose submitter goes away is killed
+  volatile int sock = -1;
+  std::stringstream out, err;
+  std::vector<std::string> args(1, "hang");
+  boost::packaged_task<int> hang_task(boost::bind(&fcs::JvmPool::submit,
+        pool.path(), std::string("b.jar"), 2, std::string(""), args, 
+        boost::ref(out), boost::ref(err), &sock));
+  boost::unique_future<int> hang_ret = hang_task.get_future();
+  boost::thread hanging(boost::move(hang_task));
+
+  std::string pid_file = dir + "/hang.pid";
+  for (int i = 0; i < 100 && !boost::filesystem::exists(pid_file); i++) {
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+  }
+  std::ifstream fin(pid_file);
+  int hang_pid = 0;
+  ASSERT_TRUE(fin >> hang_pid);
+  ASSERT_EQ(pid, hang_pid);
+
+  ::shutdown(sock, SHUT_RDWR);
+  ASSERT_EQ(255, hang_ret.get());
+  hanging.join();
+  for (int i = 0; i < 100 && ::kill(hang_pid, 0) == 0; i++) {
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+  }
+  ASSERT_NE(0, ::kill(hang_pid, 0));
+
+  // the options reach the jvm as words, without a shell
+  {
+    std::vector<std::string> args(1, "HaplotypeCaller");
+    std::stringstream out, err;
+    std::string opts = "-Dname='a b' \"-Dcmd=$(touch " + dir + "/pwned);x\"";
+    ASSERT_EQ(0, fcs::JvmPool::submit(pool.path(), "c.jar", 2, opts,
+          args, out, err));
+    std::string word;
+    out >> word >> pid;
+    std::vector<std::string> argv = fcs::get_lines(
+        dir + "/argv." + std::to_string((long long)pid));
+    ASSERT_EQ(7, argv.size());
+    ASSERT_EQ("-Dname=a b", argv[0]);
+    ASSERT_EQ("-Dcmd=$(touch " + dir + "/pwned);x", argv[1]);
+    ASSERT_EQ("-Xmx2g", argv[2]);
+    ASSERT_FALSE(boost::filesystem::exists(dir + "/pwned"));
+  }
+
+  pool.stop();
+  server.join();
+  fcs::remove_path(dir);
+}
+
+TEST_F(TestExecutor, TestTraceExport) {
+
+  class SleepWorker : public fcs::Worker {
+    public:
+      SleepWorker(): Worker(1, 1, std::vector<std::string>(), "Sleep") {
+        cmd_ = "sleep 0.1";
+      }
+  };
+
+  fcs::config_vtable.at("executor.trace").value() = true;
+
+  std::string trace_fname;
+  {
+    TestBudgetExecutor executor("Test Trace", 2, 0);
+    for (int i = 0; i < 2; i++) {
+      fcs::Worker_ptr worker(new SleepWorker());
+      executor.addTask(worker, "sample", i == 0);
+    }
+    executor.run();
+
+    boost::filesystem::path path(executor.log());
+    trace_fname = path.replace_extension(".trace.json").string();
+  }
+  fcs::config_vtable.at("executor.trace").value() = false;
+
+  ASSERT_TRUE(boost::filesystem::exists(trace_fname));
+
+  Json::Value trace;
+  std::ifstream fin(trace_fname);
+  fin >> trace;
+
+  // one span per task on two different slots
+  int num_tasks = 0;
+  std::set<int> slots;
+  for (int i = 0; i < trace["traceEvents"].size(); i++) {
+    Json::Value &event = trace["traceEvents"][i];
+    if (event["ph"].asString() == "X") {
+      ASSERT_EQ("Sleep", event["name"].asString());
+      ASSERT_EQ("sample", event["args"]["sample_id"].asString());
+      slots.insert(event["tid"].asInt());
+      num_tasks++;
+    }
+  }
+  ASSERT_EQ(2, num_tasks);
+  ASSERT_EQ(2, slots.size());
+}
+
+TEST_F(TestExecutor, TestReport) {
+
+  // a stage label with a separator and quotes of its own
+  class LabelWorker : public fcs::Worker {
+    public:
+      LabelWorker(): Worker(1, 1, std::vector<std::string>(), 
+          "Sort \"fast\", part") {
+        cmd_ = "true";
+      }
+  };
+
+  std::string csv_fname;
+  {
+    TestBudgetExecutor executor("Test Report", 2, 0);
+    executor.addTask(fcs::Worker_ptr(new LabelWorker()), "s1", true);
+    executor.run();
+
+    boost::filesystem::path path(executor.log());
+    csv_fname = path.replace_extension(".csv").string();
+  }
+  std::vector<std::string> lines = fcs::get_lines(csv_fname);
+  ASSERT_EQ(2, lines.size());
+
+  // fields of a csv line, unquoted
+  auto split = [](std::string line) {
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (int i = 0; i < line.size(); i++) {
+      if (quoted && line[i] == '"' && i + 1 < line.size() && 
+          line[i + 1] == '"') {
+        fields.back() += '"';
+        i++;
+      }
+      else if (line[i] == '"') {
+        quoted = !quoted;
+      }
+      else if (line[i] == ',' && !quoted) {
+        fields.push_back("");
+      }
+      else {
+        fields.back() += line[i];
+      }
+    }
+    return fields;
+  };
+
+  const char* columns[] = {"stage", "task", "status", "exit_code", 
+    "cores", "memory_gb", "queue_us", "wall_us", "user_us", "sys_us", 
+    "max_rss_kb", "read_bytes", "write_bytes", "attempts", 
+    "memory_peak_kb", "throttled_us"};
+  std::vector<std::string> header = split(lines[0]);
+  ASSERT_EQ(16, header.size());
+  for (int k = 0; k < header.size(); k++) {
+    ASSERT_EQ(columns[k], header[k]);
+  }
+
+  std::vector<std::string> row = split(lines[1]);
+  ASSERT_EQ(16, row.size());
+  ASSERT_EQ("Sort \"fast\", part s1", row[0]);
+  ASSERT_EQ("0", row[1]);
+  ASSERT_EQ("done", row[2]);
+  ASSERT_EQ("0", row[3]);
+  ASSERT_EQ("1", row[4]);
+  ASSERT_EQ("1", row[13]);
+  ASSERT_EQ("\"Sort \"\"fast\"\", part s1\"", 
+      lines[1].substr(0, lines[1].find(",0,done")));
+}
+
+TEST_F(TestExecutor, TestResume) {
+
+  class EchoWorker : public fcs::Worker {
+    public:
+      EchoWorker(std::string cmd,
+          std::string input, 
+          std::string output): Worker(1, 1, 
+            std::vector<std::string>(), "Echo") 
+      {
+        cmd_ = cmd;
+        if (!input.empty()) inputs_.push_back(input);
+        outputs_.push_back(output);
+      }
+  };
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor.resume." << fcs::getTid();
+  fcs::create_dir(dir.str());
+
+  std::string count = dir.str() + "/count";
+  std::string a = dir.str() + "/a.txt";
+  std::string b = dir.str() + "/b.txt";
+  std::string ledger = fcs::conf_project_dir + "/ledger.json";
+  fcs::remove_path(ledger);
+
+  // every execution appends a line to count
+  auto run_tasks = [&]() {
+    fcs::Executor executor("Test Resume", 2);
+    fcs::Worker_ptr worker_a(new EchoWorker(
+        "echo a >> " + count + "; echo a > " + a, "", a));
+    fcs::Worker_ptr worker_b(new EchoWorker(
+        "echo b >> " + count + "; cat " + a + " > " + b, a, b));
+    executor.addTask(worker_a, "", true);
+    executor.addTask(worker_b, "", true);
+    executor.run();
+  };
+  auto num_runs = [&]() {
+    std::ifstream fin(count);
+    std::string line;
+    int n = 0;
+    while (std::getline(fin, line)) n++;
+    return n;
+  };
+
+  // without --resume nothing is recorded
+  run_tasks();
+  ASSERT_EQ(2, num_runs());
+  ASSERT_FALSE(boost::filesystem::exists(ledger));
+
+  fcs::conf_resume = true;
+  run_tasks();
+  ASSERT_EQ(4, num_runs());
+
+  // nothing changed, both tasks are skipped
+  run_tasks();
+  ASSERT_EQ(4, num_runs());
+
+  // an output that changed is produced again, and so is the 
+  // task reading it
+  std::ofstream fout(a);
+  fout << "changed" << std::endl;
+  fout.close();
+  run_tasks();
+  ASSERT_EQ(6, num_runs());
+
+  // the entries replaced by the last run are dropped on load
+  fcs::TaskLedger compacted(ledger);
+  ASSERT_EQ(2, fcs::get_lines(ledger).size());
+
+  fcs::conf_resume = false;
+  fcs::remove_path(ledger);
+  fcs::remove_path(dir.str());
+}
+
+TEST_F(TestExecutor, TestSpeculation) {
+
+  // splits into two parts whose concatenation is the output
+  class SplitWorker : public fcs::Worker {
+    public:
+      SplitWorker(std::string cmd, std::string output,
+          std::string part_cmd = "echo part"): Worker(1, 1, 
+            std::vector<std::string>(), "Split"),
+        output_(output),
+        part_cmd_(part_cmd)
+      {
+        cmd_ = cmd;
+        outputs_.push_back(output);
+      }
+      bool split(int n, std::vector<fcs::Worker_ptr> &parts,
+          fcs::Worker_ptr &merge) 
+      {
+        std::string cmd = "cat";
+        for (int i = 0; i < 2; i++) {
+          std::string part = output_ + ".part" + std::to_string((long long)i);
+          parts.push_back(fcs::Worker_ptr(new SplitWorker(
+                part_cmd_ + " > " + part, part)));
+          cmd += " " + part;
+        }
+        std::string merged = output_ + ".merged";
+        merge.reset(new SplitWorker(cmd + " > " + merged + "; echo index > " +
+              merged + ".idx", merged));
+        return true;
+      }
+    private:
+      std::string output_;
+      std::string part_cmd_;
+  };
+
+  std::stringstream dir;
+  dir << "/tmp/TestExecutor.speculation." << fcs::getTid();
+  fcs::create_dir(dir.str());
+
+  // off unless asked for
+  ASSERT_EQ(0, fcs::get_config<int>("executor.speculation"));
+  fcs::config_vtable.at("executor.speculation").value() = 200;
+
+  // an index of an earlier output of the straggler
+  std::ofstream(dir.str() + "/out3.tbi") << "stale" << std::endl;
+
+  std::vector<std::string> outputs;
+  uint64_t start_ts = fcs::getTs();
+  {
+    TestBudgetExecutor executor("Test Speculation", 4, 0, 4);
+    for (int i = 0; i < 4; i++) {
+      outputs.push_back(dir.str() + "/out" + std::to_string((long long)i));
+      std::string cmd = (i < 3 ? "sleep 0.1" : "sleep 30");
+      fcs::Worker_ptr worker(new SplitWorker(
+            cmd + "; echo orig > " + outputs[i], outputs[i]));
+      executor.addTask(worker, "", i == 0);
+    }
+    executor.run();
+  }
+  // the straggler is replaced by its split instead of sleeping
+  ASSERT_LT(fcs::getTs() - start_ts, 20);
+
+  std::ifstream fin(outputs[3]);
+  std::stringstream content;
+  content << fin.rdbuf();
+  ASSERT_EQ("part\npart\n", content.str());
+
+  // the indexes follow the output they belong to
+  ASSERT_FALSE(boost::filesystem::exists(outputs[3] + ".tbi"));
+  ASSERT_FALSE(boost::filesystem::exists(outputs[3] + ".merged.idx"));
+  ASSERT_EQ(std::vector<std::string>(1, "index"), 
+      fcs::get_lines(outputs[3] + ".idx"));
+
+  // a failed split leaves the original running, and the report
+  // shows its tasks as failed and cancelled
+  std::string report_fname;
+  {
+    TestBudgetExecutor executor("Test Speculation", 4, 0, 4);
+    for (int i = 0; i < 4; i++) {
+      std::string cmd = (i < 3 ? "sleep 0.1" : "sleep 3");
+      fcs::Worker_ptr worker(new SplitWorker(
+            cmd + "; echo orig > " + outputs[i], outputs[i], "exit 1"));
+      executor.addTask(worker, "", i == 0);
+    }
+    ASSERT_NO_THROW(executor.run());
+    boost::filesystem::path path(executor.log());
+    report_fname = path.replace_extension(".json").string();
+  }
+  fin.close();
+  fin.open(outputs[3]);
+  content.str("");
+  content << fin.rdbuf();
+  ASSERT_EQ("orig\n", content.str());
+
+  std::ifstream report_in(report_fname);
+  Json::Value report;
+  report_in >> report;
+  std::map<std::string, int> statuses;
+  for (int i = 0; i < report["tasks"].size(); i++) {
+    Json::Value &task = report["tasks"][i];
+    if (task["stage"].asString() == "Split Split") {
+      statuses[task["status"].asString()]++;
+    }
+  }
+  // the other part is cancelled unless it failed first
+  ASSERT_LE(1, statuses["failed"]);
+  ASSERT_EQ(3, statuses["failed"] + statuses["cancelled"]);
+
+  fcs::config_vtable.at("executor.speculation").value() = 0;
+  fcs::remove_path(dir.str());
+}
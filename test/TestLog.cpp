@@ -77,3 +77,19 @@ TEST_F(TestLog, TestGATKLog) {
 "##### ERROR ------------------------------------------------------------------------------------------\n");
   ASSERT_STREQ(output.c_str(), target.c_str());
 }
+
+TEST_F(TestLog, TestFailureClass) {
+  fcsgenome::LogUtils logUtils;
+  std::string gatk_log = fcsgenome::get_bin_dir() + "/resource/gatk-error1";
+  ASSERT_FALSE(logUtils.findOutOfMemory(gatk_log));
+  ASSERT_FALSE(logUtils.findTransientError(gatk_log));
+
+  std::string oom_log = "/tmp/fcs-genome-test-oom.log";
+  std::ofstream fout(oom_log);
+  fout << "Exception in thread \"main\" java.lang.OutOfMemoryError: "
+       << "GC overhead limit exceeded\n";
+  fout.close();
+  ASSERT_TRUE(logUtils.findOutOfMemory(oom_log));
+  ASSERT_FALSE(logUtils.findTransientError(oom_log));
+  remove(oom_log.c_str());
+}
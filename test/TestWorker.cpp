@@ -3,6 +3,7 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <unordered_set>
 #include <gtest/gtest.h>
@@ -10,6 +11,7 @@
 #include <stdlib.h>
 
 #include "fcs-genome/BackgroundExecutor.h"
+#include "fcs-genome/ClassArchive.h"
 #include "fcs-genome/config.h"
 #include "fcs-genome/common.h"
 #include "fcs-genome/Executor.h"
@@ -288,6 +290,39 @@ TEST_F(TestWorker, TestBQSRWorker_check) {
   fcs::remove_path(temp_dir);
 }
 
+TEST_F(TestWorker, TestPRWorker_empty_region) {
+  std::string temp_dir = "/tmp/fcs-genome-test-" +  std::to_string((long long)fcs::getTid());
+  fcs::create_dir(temp_dir + "/intv");
+
+  std::string ref    = temp_dir + "/" + "ref.fasta";
+  std::string part   = temp_dir + "/intv/" + "part-000000.list";
+  std::string bqsr   = temp_dir + "/" + "input.recal";
+  std::string input  = temp_dir + "/" + "input.bam";
+  std::string output = temp_dir + "/" + "part-000000.bam";
+  bool flag = true;
+
+  touch(ref);
+  touch(part);
+  touch(bqsr);
+  touch(input);
+  touch(temp_dir + "/" + "input.bai");
+
+  // the part still gets a bam and its region, without gatk
+  fcs::PRWorker worker(ref, std::vector<std::string>(1, part), bqsr,
+      input, output, std::vector<std::string>(), 0, flag, true, true);
+  CHECK_NOEXCEPTION
+  CHECK_SETUP_NOEXCEPTION
+  ASSERT_TRUE(fs::exists(temp_dir + "/" + "part-000000.list"));
+
+  std::string cmd = worker.getCommand();
+  ASSERT_NE(std::string::npos, cmd.find(" view -b -H -o " + output + " " + input));
+  ASSERT_NE(std::string::npos, cmd.find(" index " + output + " " + 
+      temp_dir + "/" + "part-000000.bai"));
+  ASSERT_EQ(std::string::npos, cmd.find("ApplyBQSR"));
+
+  fcs::remove_path(temp_dir);
+}
+
 TEST_F(TestWorker, TestBWAWorker_check) {
   std::string temp_dir = "/tmp/fcs-genome-test-" +  std::to_string((long long)fcs::getTid());
   fcs::create_dir(temp_dir);
@@ -947,3 +982,139 @@ TEST_F(TestWorker, TestSambambaWorker_setup) {
   }
 
 }
+
+TEST_F(TestWorker, TestClassArchive) {
+  ASSERT_EQ(8,  fcs::get_java_major("1.8.0_292"));
+  ASSERT_EQ(11, fcs::get_java_major("11.0.2"));
+  ASSERT_EQ(17, fcs::get_java_major("17"));
+
+  std::string temp_dir = "/tmp/fcs-genome-test-" +  std::to_string((long long)fcs::getTid());
+  fcs::create_dir(temp_dir);
+  fcs::config_vtable.at("gatk.cds_dir").value() = temp_dir + "/cds";
+
+  std::string jar = temp_dir + "/gatk.jar";
+  std::ofstream(jar) << "classes";
+
+  // stubs of java, which record their calls
+  std::string versions[2] = {"1.8.0_292", "17.0.1"};
+  std::string javas[2];
+  for (int i = 0; i < 2; i++) {
+    javas[i] = temp_dir + "/java-" + std::to_string((long long)i);
+    std::ofstream stub(javas[i]);
+    stub << "#!/bin/bash\n"
+         << "echo \"$@\" >> " << temp_dir << "/calls\n"
+         << "for a in \"$@\"; do\n"
+         << "  case \"$a\" in\n"
+         << "    -version) echo 'openjdk version \"" << versions[i] << "\"' >&2;;\n"
+         << "    -XX:DumpLoadedClassList=*) echo java/lang/Object > \"${a#*=}\";;\n"
+         << "    -XX:SharedArchiveFile=*) cp \"${a#*=}.classlist\" \"${a#*=}\";;\n"
+         << "  esac\n"
+         << "done\n";
+    stub.close();
+    chmod(javas[i].c_str(), 0755);
+  }
+
+  // no application class-data sharing before java 11
+  ASSERT_EQ("", fcs::dump_class_archive(javas[0], jar));
+  ASSERT_EQ("", fcs::get_class_archive(javas[0], jar));
+
+  // looking up an archive never dumps it
+  ASSERT_EQ("", fcs::get_class_archive(javas[1], jar));
+  ASSERT_EQ(1, fcs::get_lines(temp_dir + "/calls").size());
+
+  // the archive is named after the checksum of the jar and the
+  // java version, and dumped only once
+  std::string archive = fcs::dump_class_archive(javas[1], jar);
+  ASSERT_EQ(temp_dir + "/cds/gatk-" + fcs::get_file_checksum(jar) +
+      "-java17_0_1.jsa", archive);
+  ASSERT_TRUE(fs::exists(archive));
+  ASSERT_EQ(archive, fcs::dump_class_archive(javas[1], jar));
+  ASSERT_EQ(archive, fcs::get_class_archive(javas[1], jar));
+  ASSERT_EQ(4, fcs::get_lines(temp_dir + "/calls").size());
+  ASSERT_EQ(1, std::distance(fs::directory_iterator(temp_dir + "/cds"),
+      fs::directory_iterator()));
+
+  fcs::config_vtable.at("gatk.cds_dir").value() = std::string("");
+  fcs::remove_path(temp_dir);
+}
+
+// worker exposing the jvm options of its tasks
+class TestJvmWorker : public fcs::Worker {
+ public:
+  TestJvmWorker(int threads, int memory): fcs::Worker(1, threads) {
+    memory_ = memory;
+  }
+  std::string opts(std::string key) { return jvm_opts(key); }
+};
+
+TEST_F(TestWorker, TestJvmOptions) {
+  int ncores = fcs::get_config<int>("executor.ncores");
+  int nprocs = fcs::get_config<int>("gatk.nprocs");
+  std::string java = fcs::get_config<std::string>("java_path");
+  fcs::config_vtable.at("executor.ncores").value() = 64;
+  fcs::config_vtable.at("gatk.nprocs").value() = 32;
+
+  // the jvms are sized only if asked for
+  ASSERT_FALSE(fcs::get_config<bool>("gatk.jvm_tuning"));
+  ASSERT_EQ("", TestJvmWorker(1, 4).opts("rtc"));
+  fcs::config_vtable.at("gatk.jvm_tuning").value() = true;
+
+  // stubs of java printing their version, named apart from the
+  // ones of TestClassArchive since versions are cached by path
+  std::string temp_dir = "/tmp/fcs-genome-test-" +  std::to_string((long long)fcs::getTid());
+  fcs::create_dir(temp_dir);
+  std::string versions[2] = {"1.8.0_181", "17.0.1"};
+  std::string javas[2];
+  for (int i = 0; i < 2; i++) {
+    javas[i] = temp_dir + "/java-" + versions[i];
+    std::ofstream stub(javas[i]);
+    stub << "#!/bin/bash\n"
+         << "echo 'openjdk version \"" << versions[i] << "\"' >&2\n";
+    stub.close();
+    chmod(javas[i].c_str(), 0755);
+  }
+
+  // ActiveProcessorCount only goes to the javas known to have it
+  fcs::config_vtable.at("java_path").value() = temp_dir + "/missing-java";
+  ASSERT_EQ(std::string::npos, 
+      TestJvmWorker(1, 4).opts("rtc").find("-XX:ActiveProcessorCount"));
+  fcs::config_vtable.at("java_path").value() = javas[0];
+  ASSERT_EQ(std::string::npos, 
+      TestJvmWorker(1, 4).opts("rtc").find("-XX:ActiveProcessorCount"));
+  fcs::config_vtable.at("java_path").value() = javas[1];
+
+  // 32 processes on 64 cores get two cores each
+  std::string opts = TestJvmWorker(1, 4).opts("rtc");
+  ASSERT_NE(std::string::npos, opts.find("-XX:ActiveProcessorCount=2 "));
+  ASSERT_NE(std::string::npos, opts.find("-XX:ParallelGCThreads=2 "));
+  ASSERT_NE(std::string::npos, opts.find("-XX:CICompilerCount=2 "));
+  ASSERT_NE(std::string::npos, opts.find("-XX:+UseParallelGC"));
+
+  // unless the task has more threads, the gc follows the heap
+  opts = TestJvmWorker(8, 32).opts("rtc");
+  ASSERT_NE(std::string::npos, opts.find("-XX:ActiveProcessorCount=8 "));
+  ASSERT_NE(std::string::npos, opts.find("-XX:CICompilerCount=4"));
+  ASSERT_NE(std::string::npos, opts.find("-XX:+UseG1GC -XX:ConcGCThreads=2"));
+
+  fcs::config_vtable.at("gatk.nprocs").value() = 64;
+  opts = TestJvmWorker(1, 4).opts("rtc");
+  ASSERT_NE(std::string::npos, opts.find("-XX:ActiveProcessorCount=1 "));
+  ASSERT_NE(std::string::npos, opts.find("-XX:+UseSerialGC"));
+
+  // options of the tool come last, and choose the gc if they have one
+  fcs::config_vtable.insert(std::make_pair("gatk.rtc.jvm_opts",
+      boost::program_options::variable_value(
+        std::string("-XX:+UseG1GC -Xss4m"), false)));
+  opts = TestJvmWorker(1, 4).opts("rtc");
+  ASSERT_EQ(std::string::npos, opts.find("-XX:+UseSerialGC"));
+  ASSERT_EQ(opts.size() - 19, opts.find("-XX:+UseG1GC -Xss4m"));
+
+  fcs::config_vtable.at("gatk.jvm_tuning").value() = false;
+  ASSERT_EQ("-XX:+UseG1GC -Xss4m", TestJvmWorker(1, 4).opts("rtc"));
+
+  fcs::config_vtable.erase("gatk.rtc.jvm_opts");
+  fcs::config_vtable.at("executor.ncores").value() = ncores;
+  fcs::config_vtable.at("gatk.nprocs").value() = nprocs;
+  fcs::config_vtable.at("java_path").value() = java;
+  fcs::remove_path(temp_dir);
+}
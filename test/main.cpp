@@ -1,6 +1,10 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
 
+#include "fcs-genome/common.h"
 #include "fcs-genome/config.h"
 
 class TestBamInputClass;
@@ -15,9 +19,18 @@ int main(int argc, char *argv[]) {
   FLAGS_logtostderr = true;
   ::testing::InitGoogleTest(&argc, argv);
 
+  // keep the logs and the ledger of test runs out of the cwd
+  std::stringstream test_dir;
+  test_dir << "/tmp/fcs-genome-test-" << getpid();
+  setenv("FCS_LOG_DIR", (test_dir.str() + "/log").c_str(), 1);
+  setenv("FCS_PROJECT_DIR", (test_dir.str() + "/.fcs-genome").c_str(), 1);
+
   // initialize configurations
   fcsgenome::init(argv, argc);
 
   // run all tests
-  return RUN_ALL_TESTS();
+  int ret = RUN_ALL_TESTS();
+
+  fcsgenome::remove_path(test_dir.str());
+  return ret;
 }